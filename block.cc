@@ -4,11 +4,22 @@
 #include <sstream>
 #include <vector>
 #include "block.h"
+#include "config.h"
 #include "proofofwork.h"
 #include "util.h"
 
 // 创建新的区块
-Block* new_block(string pre_block_hash, vector<Transaction*> transactions, long height) {
+Block* new_block(const Hash256& pre_block_hash, vector<Transaction*> transactions, long height) {
+    return new_block(pre_block_hash, transactions, height, nullptr);
+}
+
+// 创建新的区块, 挖矿可被取消
+Block* new_block(const Hash256& pre_block_hash, vector<Transaction*> transactions, long height, const std::atomic<bool>* cancel) {
+    return new_block(pre_block_hash, transactions, height, cancel, nullptr);
+}
+
+// 创建新的区块, 返回挖矿统计
+Block* new_block(const Hash256& pre_block_hash, vector<Transaction*> transactions, long height, const std::atomic<bool>* cancel, MiningStats* stats) {
     Block *block = new Block;
     block->timestamp = current_timestamp();
     block->transactions = transactions;
@@ -16,7 +27,15 @@ Block* new_block(string pre_block_hash, vector<Transaction*> transactions, long
     block->height = height;
     // 计算区块哈希
     ProofOfWork pow = ProofOfWork(block);
-    pair<long, string> ans = pow.run();
+    pair<long, Hash256> ans = pow.run(Config::get_instance()->get_mining_threads(), cancel);
+    if (stats != nullptr) {
+        stats->hashes = pow.get_hashes();
+        stats->hash_rate = pow.get_hash_rate();
+    }
+    if (ans.first < 0) {
+        delete block;
+        return nullptr;
+    }
     block->nonce = ans.first;
     block->hash = ans.second;
     return block;
@@ -24,25 +43,25 @@ Block* new_block(string pre_block_hash, vector<Transaction*> transactions, long
 
 // 生成创世区块
 Block* generate_genesis_block(Transaction* coinbase_tx) {
-    return new_block("None", vector<Transaction*>{coinbase_tx}, 0);
+    return new_block(Hash256(), vector<Transaction*>{coinbase_tx}, 0);
 }
 
 // 对象序列化
 string Block::to_json() {
     Json::Value root;
     root["timestamp"] = int64_t(this->timestamp);
-    root["pre_block_hash"] = this->pre_block_hash;
-    root["hash"] = this->hash;
+    root["pre_block_hash"] = this->pre_block_hash.to_string();
+    root["hash"] = this->hash.to_string();
     root["nonce"] = int64_t(this->nonce);
     root["height"] = int64_t(this->height);
     Json::Value transactions;
     for (auto tx : this->transactions) {
         Json::Value tx_root;
-        tx_root["id"] = tx->id;
+        tx_root["id"] = tx->id.to_string();
         Json::Value tx_vin;
         for (auto vin : tx->vin) {
             Json::Value vin_root;
-            vin_root["txid"] = vin.txid;
+            vin_root["txid"] = vin.txid.to_string();
             vin_root["vout"] = vin.vout;
             // 字节数组转 base64
             vin_root["signature"] = encode_base64(vin.signature);
@@ -72,48 +91,361 @@ Block* Block::from_json(string block_str) {
     if (!reader.parse(block_str, root)) {
         return nullptr;
     }
-    Block* block = new Block();
+    unique_ptr<Block> block(new Block());
+    // JSON 文本比解码后的数据大, 以文本长度作为内存池的初始大小
+    block->arena.reset(new BlockArena(block_str.size()));
     block->timestamp = root["timestamp"].asInt64();
-    block->pre_block_hash = root["pre_block_hash"].asString();
-    block->hash = root["hash"].asString();
+    if (!Hash256::from_hex(root["pre_block_hash"].asString(), block->pre_block_hash) ||
+        !Hash256::from_hex(root["hash"].asString(), block->hash)) {
+        return nullptr;
+    }
     block->nonce = root["nonce"].asInt64();
     block->height = root["height"].asInt64();
     Json::Value transactions = root["transactions"];
     if (transactions.isArray()) {
-        for (auto tx : transactions) {
-            Transaction *transaction = new Transaction;
-            transaction->id = tx["id"].asString();
+        for (auto& tx : transactions) {
+            Transaction *transaction = block->new_transaction();
+            if (!Hash256::from_hex(tx["id"].asString(), transaction->id)) {
+                return nullptr;
+            }
             Json::Value vin = tx["vin"];
             if (vin.isArray()) {
-                for (auto v : vin) {
-                    TXInput input;
-                    input.txid = v["txid"].asString();
+                transaction->vin.reserve(vin.size());
+                for (auto& v : vin) {
+                    transaction->vin.emplace_back();
+                    TXInput& input = transaction->vin.back();
+                    if (!Hash256::from_hex(v["txid"].asString(), input.txid)) {
+                        return nullptr;
+                    }
                     input.vout = v["vout"].asInt();
                     // base64 转字节数组
                     decode_base64(v["signature"].asString(), input.signature);
                     decode_base64(v["public_key"].asString(), input.pub_key);
-                    transaction->vin.push_back(input);
                 }
             }
             Json::Value vout = tx["vout"];
             if (vout.isArray()) {
-                for (auto v : vout) {
-                    TXOutput output;
+                transaction->vout.reserve(vout.size());
+                for (auto& v : vout) {
+                    transaction->vout.emplace_back();
+                    TXOutput& output = transaction->vout.back();
                     output.value = v["value"].asInt();
                     decode_base64(v["pub_key_hash"].asString(), output.pub_key_hash);
-                    transaction->vout.push_back(output);
                 }
             }
-            block->transactions.push_back(transaction);
         }
     }
-    return block;
+    return block.release();
+}
+
+// 二进制序列化
+string Block::serialize() {
+    Encoder enc;
+    enc.put_u8(BLOCK_FORMAT_MAGIC);
+    enc.put_u8(BLOCK_FORMAT_VERSION);
+    enc.put_u64(static_cast<uint64_t>(this->timestamp));
+    enc.put_u64(static_cast<uint64_t>(this->nonce));
+    enc.put_u64(static_cast<uint64_t>(this->height));
+    this->hash.encode(enc);
+    this->pre_block_hash.encode(enc);
+    enc.put_varint(this->transactions.size());
+    for (auto tx : this->transactions) {
+        // 每笔交易带长度前缀, 读取时可以跳过不需要的交易
+        Encoder tx_enc;
+        tx->encode(tx_enc);
+        enc.put_string(tx_enc.data());
+    }
+    return enc.data();
+}
+
+// 二进制反序列化
+Block* Block::deserialize(const string& bytes) {
+    return deserialize(bytes.data(), bytes.size());
+}
+
+Block* Block::deserialize(const char* data, size_t size) {
+    if (size == 0 || static_cast<uint8_t>(data[0]) != BLOCK_FORMAT_MAGIC) {
+        return nullptr;
+    }
+    return parse(data, size);
+}
+
+// 区块头编码
+string BlockHeader::serialize() const {
+    Encoder enc;
+    enc.put_u64(static_cast<uint64_t>(this->timestamp));
+    enc.put_u64(static_cast<uint64_t>(this->nonce));
+    enc.put_u64(static_cast<uint64_t>(this->height));
+    this->hash.encode(enc);
+    this->pre_block_hash.encode(enc);
+    return enc.data();
+}
+
+// 从编码中读取一个区块头
+bool BlockHeader::deserialize(Decoder& dec, BlockHeader& header) {
+    uint64_t timestamp, nonce, height;
+    if (!dec.get_u64(timestamp) || !dec.get_u64(nonce) || !dec.get_u64(height)) {
+        return false;
+    }
+    header.timestamp = static_cast<long>(timestamp);
+    header.nonce = static_cast<long>(nonce);
+    header.height = static_cast<long>(height);
+    return Hash256::decode(dec, header.hash) && Hash256::decode(dec, header.pre_block_hash);
+}
+
+// 同步用的编码
+void BlockHeader::encode_with_tx_ids(Encoder& enc) const {
+    enc.put_u64(static_cast<uint64_t>(this->timestamp));
+    enc.put_u64(static_cast<uint64_t>(this->nonce));
+    enc.put_u64(static_cast<uint64_t>(this->height));
+    this->hash.encode(enc);
+    this->pre_block_hash.encode(enc);
+    enc.put_varint(this->tx_ids.size());
+    for (auto& id : this->tx_ids) {
+        id.encode(enc);
+    }
+}
+
+// 读取同步用的编码
+bool BlockHeader::decode_with_tx_ids(Decoder& dec, BlockHeader& header) {
+    uint64_t count;
+    if (!deserialize(dec, header) || !dec.get_varint(count) || count > dec.remaining() / Hash256::SIZE) {
+        return false;
+    }
+    header.tx_ids.resize(count);
+    for (auto& id : header.tx_ids) {
+        if (!Hash256::decode(dec, id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 与另一个区块头的字段一致
+bool BlockHeader::matches(const BlockHeader& other) const {
+    return timestamp == other.timestamp && nonce == other.nonce && height == other.height && hash == other.hash &&
+           pre_block_hash == other.pre_block_hash;
+}
+
+// 区块头
+BlockHeader Block::header() {
+    return BlockHeader{this->timestamp, this->nonce, this->height, this->hash, this->pre_block_hash};
+}
+
+// 反序列化, 兼容二进制和 JSON 两种格式
+Block* Block::parse(const string& bytes) {
+    return parse(bytes.data(), bytes.size());
+}
+
+Block* Block::parse(const char* data, size_t size) {
+    BlockView view;
+    if (!view.parse(data, size)) {
+        return nullptr;
+    }
+    return view.to_block();
+}
+
+BlockArena::BlockArena(size_t initial_size) : buffer(initial_size, &upstream) {}
+
+void* BlockArena::do_allocate(size_t bytes, size_t alignment) {
+    return buffer.allocate(bytes, alignment);
+}
+
+// 单调分配, 单个对象的释放不归还内存
+void BlockArena::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    buffer.deallocate(p, bytes, alignment);
+}
+
+bool BlockArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
 }
 
-// 析构函数
+void* BlockArena::CountingResource::do_allocate(size_t bytes, size_t alignment) {
+    allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void BlockArena::CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    allocated -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool BlockArena::CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+// 创建一笔属于该区块的空交易
+Transaction* Block::new_transaction() {
+    Transaction* tx;
+    if (arena != nullptr) {
+        tx = new (arena->allocate(sizeof(Transaction), alignof(Transaction))) Transaction(arena.get());
+    } else {
+        tx = new Transaction();
+    }
+    transactions.push_back(tx);
+    return tx;
+}
+
+// 析构函数, 内存池中的交易只需析构, 内存随内存池一起释放
 Block::~Block() {
     for (auto tx : transactions) {
-        delete tx;
+        if (arena != nullptr) {
+            tx->~Transaction();
+        } else {
+            delete tx;
+        }
     }
     transactions.clear();
 }
+
+// 解析区块, 兼容二进制和 JSON 两种格式
+bool BlockView::parse(const char* data, size_t size) {
+    this->data = data;
+    this->size = size;
+    this->tx_spans.clear();
+    this->json_block.reset();
+    if (size == 0) {
+        return false;
+    }
+    if (static_cast<uint8_t>(data[0]) == BLOCK_FORMAT_MAGIC) {
+        return parse_binary();
+    }
+    json_block.reset(Block::from_json(string(data, size)));
+    if (json_block == nullptr) {
+        return false;
+    }
+    hdr = json_block->header();
+    tx_count = json_block->transactions.size();
+    return true;
+}
+
+// 解析二进制格式的区块头和交易数量
+bool BlockView::parse_binary() {
+    Decoder dec(data, size);
+    uint8_t magic;
+    if (!dec.get_u8(magic) || magic != BLOCK_FORMAT_MAGIC) {
+        return false;
+    }
+    if (!dec.get_u8(version) || version < 1 || version > BLOCK_FORMAT_VERSION) {
+        return false;
+    }
+    if (version == 1) {
+        // 版本 1 的哈希为带长度前缀的 16 进制字符串
+        uint64_t timestamp, nonce, height;
+        string hash, pre_block_hash;
+        if (!dec.get_u64(timestamp) || !dec.get_u64(nonce) || !dec.get_u64(height) || !dec.get_string(hash) ||
+            !dec.get_string(pre_block_hash) || !Hash256::from_hex(hash, hdr.hash) ||
+            !Hash256::from_hex(pre_block_hash, hdr.pre_block_hash)) {
+            return false;
+        }
+        hdr.timestamp = static_cast<long>(timestamp);
+        hdr.nonce = static_cast<long>(nonce);
+        hdr.height = static_cast<long>(height);
+    } else if (!BlockHeader::deserialize(dec, hdr)) {
+        // 版本 2 起区块头与单独存储的区块头编码相同
+        return false;
+    }
+    uint64_t count;
+    if (!dec.get_varint(count) || count > dec.remaining()) {
+        return false;
+    }
+    tx_count = count;
+    tx_offset = dec.position() - data;
+    return true;
+}
+
+// 建立交易位置表
+bool BlockView::locate_transactions() {
+    if (tx_spans.size() == tx_count) {
+        return true;
+    }
+    Decoder dec(data + tx_offset, size - tx_offset);
+    tx_spans.reserve(tx_count);
+    for (size_t i = 0; i < tx_count; i++) {
+        uint64_t tx_len;
+        if (!dec.get_varint(tx_len) || dec.remaining() < tx_len) {
+            tx_spans.clear();
+            return false;
+        }
+        tx_spans.push_back(make_pair(dec.position() - data, tx_len));
+        dec.skip(tx_len);
+    }
+    return true;
+}
+
+// 区块头
+const BlockHeader& BlockView::header() const {
+    return hdr;
+}
+
+// 交易数量
+size_t BlockView::transaction_count() const {
+    return tx_count;
+}
+
+// 第 pos 笔交易的 ID
+bool BlockView::transaction_id(size_t pos, Hash256& id) {
+    if (json_block != nullptr) {
+        if (pos >= json_block->transactions.size()) {
+            return false;
+        }
+        id = json_block->transactions[pos]->id;
+        return true;
+    }
+    if (pos >= tx_count || !locate_transactions()) {
+        return false;
+    }
+    Decoder dec(data + tx_spans[pos].first, tx_spans[pos].second);
+    return Transaction::decode_id(dec, version, id);
+}
+
+// 解码第 pos 笔交易
+Transaction* BlockView::transaction(size_t pos) {
+    if (json_block != nullptr) {
+        return pos < json_block->transactions.size() ? json_block->transactions[pos]->clone() : nullptr;
+    }
+    if (pos >= tx_count || !locate_transactions()) {
+        return nullptr;
+    }
+    Decoder dec(data + tx_spans[pos].first, tx_spans[pos].second);
+    unique_ptr<Transaction> tx(new Transaction());
+    if (!Transaction::decode(dec, version, *tx)) {
+        return nullptr;
+    }
+    return tx.release();
+}
+
+// 解码为完整的区块
+Block* BlockView::to_block() {
+    if (json_block != nullptr) {
+        data = nullptr;
+        tx_count = 0;
+        return json_block.release();
+    }
+    if (data == nullptr) {
+        return nullptr;
+    }
+    unique_ptr<Block> block(new Block());
+    block->timestamp = hdr.timestamp;
+    block->nonce = hdr.nonce;
+    block->height = hdr.height;
+    block->hash = hdr.hash;
+    block->pre_block_hash = hdr.pre_block_hash;
+    // 解码后的交易比编码略大(容器头部和对齐), 按编码长度的两倍预留内存池
+    block->arena.reset(new BlockArena(size * 2));
+    block->transactions.reserve(tx_count);
+    // 顺序解码全部交易, 不需要交易位置表
+    Decoder dec(data + tx_offset, size - tx_offset);
+    for (size_t i = 0; i < tx_count; i++) {
+        uint64_t tx_len;
+        if (!dec.get_varint(tx_len) || dec.remaining() < tx_len) {
+            return nullptr;
+        }
+        Decoder tx_dec(dec.position(), tx_len);
+        if (!Transaction::decode(tx_dec, version, *block->new_transaction())) {
+            return nullptr;
+        }
+        dec.skip(tx_len);
+    }
+    return block.release();
+}
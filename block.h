@@ -1,15 +1,86 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include "codec.h"
 #include "transaction.h"
 
+// 二进制区块格式的魔数, JSON 格式总是以 '{' 开头, 可以据此区分
+const uint8_t BLOCK_FORMAT_MAGIC = 0xb1;
+
+// 二进制区块格式的版本号, 版本 2 起哈希和交易 ID 按 32 字节原始数据存放, 仍可读取版本 1
+const uint8_t BLOCK_FORMAT_VERSION = 2;
+
+// 区块头编码后的长度: timestamp(8) | nonce(8) | height(8) | hash(32) | pre_block_hash(32)
+const size_t BLOCK_HEADER_SIZE = 88;
+
+// 区块头, 不含交易数据, 与区块体分开存储, 用于先同步区块头
+struct BlockHeader {
+    long   timestamp;
+    long   nonce;
+    long   height;
+    Hash256 hash;
+    Hash256 pre_block_hash; // 创世区块为空哈希
+    vector<Hash256> tx_ids; // 交易 ID, 参与哈希计算. 只在同步区块头时携带, 本地保存的区块头不含
+
+    // 编码为固定 88 字节, 哈希按原始字节存放, 不含交易 ID
+    string serialize() const;
+
+    // 从编码中读取一个区块头
+    static bool deserialize(Decoder& dec, BlockHeader& header);
+
+    // 同步用的编码: 88 字节的区块头 + 交易数 + 交易 ID, 接收方可以据此重新计算哈希
+    void encode_with_tx_ids(Encoder& enc) const;
+
+    // 读取同步用的编码
+    static bool decode_with_tx_ids(Decoder& dec, BlockHeader& header);
+
+    // 与另一个区块头的字段一致(不比较交易 ID)
+    bool matches(const BlockHeader& other) const;
+};
+
+// 解码区块使用的内存池: 单调分配, 整体释放, 并统计向堆申请的内存总量
+class BlockArena : public std::pmr::memory_resource {
+public:
+    explicit BlockArena(size_t initial_size);
+
+    // 内存池实际占用的堆内存(字节), 包括预留但尚未使用的部分
+    size_t footprint() const { return upstream.allocated; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    // 记录申请量的堆内存来源
+    struct CountingResource : public std::pmr::memory_resource {
+        size_t allocated = 0;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    CountingResource upstream; // 必须先于 buffer 构造, 后于 buffer 析构
+    std::pmr::monotonic_buffer_resource buffer;
+};
+
 // 区块
 struct Block {
    long   timestamp; // 时间戳
-   string pre_block_hash; // 前一个区块的 hash
-   string hash; // 当前区块的 hash
+   Hash256 pre_block_hash; // 前一个区块的 hash, 创世区块为空哈希
+   Hash256 hash; // 当前区块的 hash
    vector<Transaction*> transactions; // 交易数据
    long   nonce; // 随机数
    long   height; // 区块高度
+   // 解码得到的区块使用的内存池, 区块中全部交易及其输入输出和字节数组都从这里分配, 随区块一起整体释放.
+   // 挖出的新区块没有内存池, 交易分配在堆上并由区块负责 delete
+   unique_ptr<BlockArena> arena;
+
+    // 创建一笔属于该区块的空交易并追加到交易列表, 有内存池时从内存池分配
+    Transaction* new_transaction();
 
     // 对象序列化
     string to_json();
@@ -17,12 +88,82 @@ struct Block {
     // 对象反序列化
     static Block* from_json(string block_str);
 
+    // 二进制序列化
+    // 格式: magic(1) | version(1) | timestamp(8) | nonce(8) | height(8) | hash(32) | pre_block_hash(32) | tx_count | (tx_len | tx)...
+    string serialize();
+
+    // 二进制反序列化
+    static Block* deserialize(const string& bytes);
+
+    static Block* deserialize(const char* data, size_t size);
+
+    // 反序列化, 兼容二进制和 JSON 两种格式
+    static Block* parse(const string& bytes);
+
+    static Block* parse(const char* data, size_t size);
+
+    // 区块头(不含交易 ID)
+    BlockHeader header();
+
     // 析构函数
     ~Block();
 };
 
+// 区块的只读视图
+// 二进制格式的区块直接在编码上按需解析: 解析时只读取区块头和交易数量, 访问交易时才扫描各笔交易的位置,
+// 并且只解码被访问的交易. 视图不拷贝也不持有编码数据, 使用期间数据必须有效(例如 Blockchain::get_block_view 固定的 PinnableSlice).
+// JSON 格式的旧区块无法按需解析, 整体解析后保存在视图中
+class BlockView {
+public:
+    // 解析区块, 兼容二进制和 JSON 两种格式
+    bool parse(const char* data, size_t size);
+
+    // 区块头
+    const BlockHeader& header() const;
+
+    // 交易数量
+    size_t transaction_count() const;
+
+    // 第 pos 笔交易的 ID, 不解码交易的其余部分
+    bool transaction_id(size_t pos, Hash256& id);
+
+    // 解码第 pos 笔交易, 交易分配在堆上, 由调用方释放
+    Transaction* transaction(size_t pos);
+
+    // 解码为完整的区块. JSON 格式直接交出视图中已解析的区块, 之后不能再通过视图访问交易
+    Block* to_block();
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    uint8_t version = 0;
+    BlockHeader hdr;
+    size_t tx_count = 0;
+    size_t tx_offset = 0; // 第一笔交易在编码中的位置
+    vector<pair<size_t, size_t>> tx_spans; // 每笔交易编码的 (位置, 长度), 第一次访问交易时建立
+    unique_ptr<Block> json_block;
+
+    // 解析二进制格式的区块头和交易数量
+    bool parse_binary();
+
+    // 建立交易位置表, 数据损坏时返回 false
+    bool locate_transactions();
+};
+
 // 创建新的区块
-Block* new_block(string pre_block_hash, vector<Transaction*> transactions, long height);
+Block* new_block(const Hash256& pre_block_hash, vector<Transaction*> transactions, long height);
+
+// 创建新的区块, cancel 被置位时放弃挖矿并返回 nullptr(交易随区块一起释放)
+Block* new_block(const Hash256& pre_block_hash, vector<Transaction*> transactions, long height, const std::atomic<bool>* cancel);
+
+// 一次挖矿的统计
+struct MiningStats {
+    long hashes; // 哈希次数
+    double hash_rate; // 哈希速率(次/秒)
+};
+
+// 创建新的区块, stats 不为空时返回挖矿统计(取消时也会填写)
+Block* new_block(const Hash256& pre_block_hash, vector<Transaction*> transactions, long height, const std::atomic<bool>* cancel, MiningStats* stats);
 
 // 生成创世区块
 Block* generate_genesis_block(Transaction* coinbase_tx);
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include "block.h"
+#include "util.h"
+
+// 堆分配次数, 替换全局 operator new 统计
+static std::atomic<size_t> heap_allocations(0);
+
+void* operator new(size_t size) {
+    heap_allocations++;
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+// 构造一个包含 tx_count 笔交易的区块, 字段长度与真实交易一致
+Block* bench_block(int tx_count) {
+    std::mt19937 gen(42);
+    auto random_bytes = [&](size_t n) {
+        vector<unsigned char> bytes(n);
+        for (auto& b : bytes) {
+            b = static_cast<unsigned char>(gen());
+        }
+        return bytes;
+    };
+    auto random_hash = [&]() {
+        return Hash256::from_raw(random_bytes(32).data());
+    };
+    Block* block = new Block();
+    block->timestamp = current_timestamp();
+    block->pre_block_hash = random_hash();
+    block->hash = random_hash();
+    block->nonce = 12345;
+    block->height = 100;
+    for (int i = 0; i < tx_count; i++) {
+        Transaction* tx = new Transaction();
+        tx->id = random_hash();
+        for (int j = 0; j < 2; j++) {
+            tx->vin.push_back(TXInput{random_hash(), j, random_bytes(72), random_bytes(65)});
+        }
+        for (int j = 0; j < 2; j++) {
+            tx->vout.push_back(TXOutput(10 + j, random_bytes(20)));
+        }
+        block->transactions.push_back(tx);
+    }
+    return block;
+}
+
+// 按格式统计编解码吞吐量
+template <typename Encode, typename Decode>
+void run_block_bench(const string& name, int iterations, Encode encode, Decode decode) {
+    using clock = std::chrono::steady_clock;
+    string bytes = encode();
+    auto start = clock::now();
+    for (int i = 0; i < iterations; i++) {
+        bytes = encode();
+    }
+    double encode_secs = std::chrono::duration<double>(clock::now() - start).count();
+    start = clock::now();
+    for (int i = 0; i < iterations; i++) {
+        unique_ptr<Block> block(decode(bytes));
+        ASSERT_NE(block, nullptr);
+    }
+    double decode_secs = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << name << ": size = " << bytes.size() << " bytes"
+              << ", encode = " << iterations / encode_secs << " blocks/s"
+              << ", decode = " << iterations / decode_secs << " blocks/s" << std::endl;
+}
+
+// blockchain_bench --gtest_filter=BlockBench.encode_decode
+TEST(BlockBench, encode_decode) {
+    const int iterations = 200;
+    unique_ptr<Block> block(bench_block(100));
+    run_block_bench("json", iterations, [&]() { return block->to_json(); }, Block::from_json);
+    run_block_bench("binary", iterations, [&]() { return block->serialize(); },
+                    [](const string& bytes) { return Block::deserialize(bytes); });
+}
+
+// 统计解码一个区块的堆分配次数, 区块释放也计入耗时
+template <typename Decode>
+void run_allocation_bench(const string& name, int iterations, const string& bytes, size_t tx_count, Decode decode) {
+    using clock = std::chrono::steady_clock;
+    size_t allocations = 0;
+    auto start = clock::now();
+    for (int i = 0; i < iterations; i++) {
+        size_t before = heap_allocations;
+        Block* block = decode(bytes);
+        allocations += heap_allocations - before;
+        ASSERT_NE(block, nullptr);
+        delete block;
+    }
+    double secs = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << name << ": " << allocations / iterations << " allocations/block"
+              << ", " << (double)allocations / iterations / tx_count << " allocations/tx"
+              << ", decode + free = " << iterations / secs << " blocks/s" << std::endl;
+}
+
+// blockchain_bench --gtest_filter=BlockBench.decode_allocations
+TEST(BlockBench, decode_allocations) {
+    const int iterations = 200;
+    const size_t tx_count = 100;
+    unique_ptr<Block> block(bench_block(tx_count));
+    run_allocation_bench("json", iterations, block->to_json(), tx_count, Block::from_json);
+    run_allocation_bench("binary", iterations, block->serialize(), tx_count,
+                         [](const string& bytes) { return Block::deserialize(bytes); });
+}
+
+// blockchain_bench --gtest_filter=BlockBench.view_lookup
+TEST(BlockBench, view_lookup) {
+    using clock = std::chrono::steady_clock;
+    const int iterations = 2000;
+    const size_t tx_count = 100;
+    unique_ptr<Block> block(bench_block(tx_count));
+    string bytes = block->serialize();
+    Hash256 txid = block->transactions[tx_count / 2]->id;
+    // 完整解码区块后拷贝其中一笔交易
+    auto start = clock::now();
+    for (int i = 0; i < iterations; i++) {
+        unique_ptr<Block> decoded(Block::deserialize(bytes));
+        unique_ptr<Transaction> tx(decoded->transactions[tx_count / 2]->clone());
+        ASSERT_EQ(tx->id, txid);
+    }
+    double block_secs = std::chrono::duration<double>(clock::now() - start).count();
+    // 通过视图只解码这一笔交易
+    start = clock::now();
+    for (int i = 0; i < iterations; i++) {
+        BlockView view;
+        ASSERT_TRUE(view.parse(bytes.data(), bytes.size()));
+        unique_ptr<Transaction> tx(view.transaction(tx_count / 2));
+        ASSERT_EQ(tx->id, txid);
+    }
+    double view_secs = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << "block: " << iterations / block_secs << " lookups/s, view: " << iterations / view_secs << " lookups/s" << std::endl;
+}
@@ -0,0 +1,74 @@
+#include "block_cache.h"
+
+BlockCache::BlockCache(size_t max_usage)
+    : max_usage(max_usage), total_usage(0), hit_count(0), miss_count(0), evict_count(0) {}
+
+// 查询区块
+shared_ptr<Block> BlockCache::get(const Hash256& block_hash) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(block_hash);
+    if (it == index.end()) {
+        miss_count++;
+        return nullptr;
+    }
+    hit_count++;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->first;
+}
+
+// 加入区块
+void BlockCache::insert(const shared_ptr<Block>& block) {
+    size_t usage = block_usage(block.get());
+    if (usage > max_usage) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(block->hash);
+    if (it != index.end()) {
+        // 两个线程同时读取同一个区块时只保留先写入的
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    entries.push_front(make_pair(block, usage));
+    index[block->hash] = entries.begin();
+    total_usage += usage;
+    while (total_usage > max_usage) {
+        total_usage -= entries.back().second;
+        index.erase(entries.back().first->hash);
+        entries.pop_back();
+        evict_count++;
+    }
+}
+
+// 缓存统计
+BlockCacheStats BlockCache::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return BlockCacheStats{hit_count, miss_count, evict_count, entries.size(), total_usage, max_usage};
+}
+
+// 估算缓存中一个区块的内存占用
+size_t block_usage(Block* block) {
+    // 链表节点和哈希表节点的额外开销
+    const size_t list_node = 16;
+    const size_t hash_node = 24;
+    size_t usage = sizeof(Block) + block->transactions.capacity() * sizeof(Transaction*);
+    if (block->arena != nullptr) {
+        // 解码得到的区块, 交易全部在内存池中, 按内存池实际申请的内存计算
+        usage += sizeof(BlockArena) + block->arena->footprint();
+    } else {
+        for (auto tx : block->transactions) {
+            usage += sizeof(Transaction);
+            usage += tx->vin.capacity() * sizeof(TXInput);
+            for (auto& vin : tx->vin) {
+                usage += vin.signature.capacity() + vin.pub_key.capacity();
+            }
+            usage += tx->vout.capacity() * sizeof(TXOutput);
+            for (auto& vout : tx->vout) {
+                usage += vout.pub_key_hash.capacity();
+            }
+        }
+    }
+    usage += list_node + sizeof(shared_ptr<Block>) + sizeof(size_t);
+    usage += hash_node + sizeof(Hash256) + sizeof(void*);
+    return usage;
+}
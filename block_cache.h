@@ -0,0 +1,60 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "block.h"
+
+using namespace std;
+
+// 区块缓存统计
+struct BlockCacheStats {
+    uint64_t hits; // 命中次数
+    uint64_t misses; // 未命中次数
+    uint64_t evicted; // 因容量不足被淘汰的区块数
+    size_t count; // 缓存的区块数
+    size_t usage; // 估算的内存占用(字节)
+    size_t max_usage; // 内存占用上限
+};
+
+// 默认的区块缓存内存上限
+const size_t DEFAULT_BLOCK_CACHE_SIZE = 32 * 1024 * 1024;
+
+// 解码后区块的 LRU 缓存
+// 键为区块哈希. 区块内容由哈希确定, 写入后不会改变, 缓存不需要失效, 只按内存上限淘汰最久未使用的区块.
+// 缓存中的区块以 shared_ptr 共享给多个线程, 淘汰时不影响正在使用它的线程, 调用方不能修改共享的区块.
+class BlockCache {
+public:
+    BlockCache(size_t max_usage);
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    // 查询区块, 不存在时返回 nullptr
+    shared_ptr<Block> get(const Hash256& block_hash);
+
+    // 加入区块, 已经存在时保留原有的区块. 单个区块超过内存上限时不缓存
+    void insert(const shared_ptr<Block>& block);
+
+    // 是否启用缓存(内存上限不为 0)
+    bool enabled() const { return max_usage > 0; }
+
+    // 缓存统计
+    BlockCacheStats stats();
+
+private:
+    typedef list<pair<shared_ptr<Block>, size_t>> Entries; // (区块, 内存占用)
+
+    size_t max_usage;
+    std::mutex mutex; // 保护以下全部字段
+    Entries entries; // 按最近使用排列, 最近使用的在前
+    unordered_map<Hash256, Entries::iterator> index;
+    size_t total_usage;
+    uint64_t hit_count;
+    uint64_t miss_count;
+    uint64_t evict_count;
+};
+
+// 估算缓存中一个区块的内存占用
+size_t block_usage(Block* block);
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "block_cache.h"
+
+// 构造一个不含交易的区块
+static shared_ptr<Block> make_block(const string& label) {
+    shared_ptr<Block> block(new Block());
+    block->hash = Hash256::sha256(label);
+    return block;
+}
+
+TEST(BlockCacheTests, lru_eviction) {
+    size_t usage = block_usage(make_block("a").get());
+    // 容量只够两个区块
+    BlockCache cache(usage * 2);
+    cache.insert(make_block("a"));
+    cache.insert(make_block("b"));
+    // 访问 a 后, 最久未使用的是 b
+    EXPECT_NE(cache.get(Hash256::sha256(string("a"))), nullptr);
+    cache.insert(make_block("c"));
+    EXPECT_NE(cache.get(Hash256::sha256(string("a"))), nullptr);
+    EXPECT_EQ(cache.get(Hash256::sha256(string("b"))), nullptr);
+    EXPECT_NE(cache.get(Hash256::sha256(string("c"))), nullptr);
+
+    BlockCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.count, 2);
+    EXPECT_EQ(stats.usage, usage * 2);
+    EXPECT_EQ(stats.hits, 3);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.evicted, 1);
+}
+
+TEST(BlockCacheTests, shared_after_eviction) {
+    BlockCache cache(block_usage(make_block("a").get()));
+    cache.insert(make_block("a"));
+    shared_ptr<Block> block = cache.get(Hash256::sha256(string("a")));
+    // 淘汰后正在使用的区块仍然有效
+    cache.insert(make_block("b"));
+    EXPECT_EQ(cache.get(Hash256::sha256(string("a"))), nullptr);
+    EXPECT_EQ(block->hash, Hash256::sha256(string("a")));
+    // 内存上限为 0 时不缓存
+    BlockCache disabled(0);
+    EXPECT_FALSE(disabled.enabled());
+    disabled.insert(make_block("a"));
+    EXPECT_EQ(disabled.stats().count, 0);
+}
+
+TEST(BlockCacheTests, arena_usage) {
+    shared_ptr<Block> block = make_block("a");
+    for (int i = 0; i < 10; i++) {
+        Transaction* tx = block->new_transaction();
+        tx->vin.push_back(TXInput{Hash256::sha256(to_string(i)), 0, vector<unsigned char>(72, 1), vector<unsigned char>(65, 2)});
+        tx->vout.push_back(TXOutput(i, vector<unsigned char>(20, 3)));
+        tx->id = tx->hash();
+    }
+    string bytes = block->serialize();
+    shared_ptr<Block> decoded(Block::deserialize(bytes));
+    ASSERT_NE(decoded, nullptr);
+    // 解码得到的区块按内存池预留的内存计算, 不少于编码长度的两倍
+    ASSERT_NE(decoded->arena, nullptr);
+    EXPECT_GE(decoded->arena->footprint(), bytes.size() * 2);
+    EXPECT_GE(block_usage(decoded.get()), decoded->arena->footprint());
+    EXPECT_GT(block_usage(decoded.get()), block_usage(block.get()));
+}
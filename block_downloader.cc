@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <iostream>
+#include "block_downloader.h"
+
+BlockDownloader::BlockDownloader(int window, RequestFn request, HasBlockFn has_block)
+    : window(window < 1 ? 1 : window), request(request), has_block(has_block), next_peer(0) {}
+
+BlockDownloader::~BlockDownloader() {
+    for (auto& kv : orphans) {
+        delete kv.second;
+    }
+}
+
+// 添加待下载的区块哈希
+void BlockDownloader::add(const vector<Hash256>& hashes) {
+    for (auto& hash : hashes) {
+        if (queued_hashes.count(hash) || requests.count(hash) || orphans.count(hash) || has_block(hash)) {
+            continue;
+        }
+        queue.push_back(hash);
+        queued_hashes.insert(hash);
+    }
+}
+
+// 收到区块
+vector<Block*> BlockDownloader::on_block(Block* block) {
+    vector<Block*> ready;
+    bool requested = requests.erase(block->hash) > 0;
+    // 未经请求直接发来的区块也可能在队列中
+    if (queued_hashes.erase(block->hash)) {
+        queue.erase(std::find(queue.begin(), queue.end(), block->hash));
+    }
+    if (orphans.count(block->hash) || has_block(block->hash)) {
+        delete block;
+        return ready;
+    }
+    // 父区块尚未接入, 先缓存
+    if (!block->pre_block_hash.is_null() && !has_block(block->pre_block_hash)) {
+        if (!requested) {
+            // 未经请求的区块不占用窗口, 缓存数量单独限制
+            if (unsolicited.size() >= (size_t)window) {
+                delete block;
+                return ready;
+            }
+            unsolicited.insert(block->hash);
+        }
+        orphans[block->hash] = block;
+        orphans_by_parent.insert(make_pair(block->pre_block_hash, block->hash));
+        return ready;
+    }
+    // 放行该区块以及缓存中以它为祖先的区块
+    ready.push_back(block);
+    release_descendants(ready);
+    return ready;
+}
+
+// 区块接入链后, 放行缓存中以它为祖先的区块
+vector<Block*> BlockDownloader::on_connected(const Hash256& hash) {
+    vector<Block*> ready;
+    auto range = orphans_by_parent.equal_range(hash);
+    vector<Hash256> children;
+    for (auto it = range.first; it != range.second; it++) {
+        children.push_back(it->second);
+    }
+    for (auto& child : children) {
+        ready.push_back(take_orphan(child));
+    }
+    release_descendants(ready);
+    return ready;
+}
+
+// 放行缓存中以 ready 里的区块为祖先的区块, 逐层放行保证父区块在前
+void BlockDownloader::release_descendants(vector<Block*>& ready) {
+    for (size_t pos = 0; pos < ready.size(); pos++) {
+        drops.erase(ready[pos]->hash);
+        auto range = orphans_by_parent.equal_range(ready[pos]->hash);
+        vector<Hash256> children;
+        for (auto it = range.first; it != range.second; it++) {
+            children.push_back(it->second);
+        }
+        for (auto& child : children) {
+            ready.push_back(take_orphan(child));
+        }
+    }
+}
+
+// 从缓存和各个索引中取出区块
+Block* BlockDownloader::take_orphan(const Hash256& hash) {
+    auto orphan = orphans.find(hash);
+    Block* block = orphan->second;
+    orphans.erase(orphan);
+    unsolicited.erase(hash);
+    auto range = orphans_by_parent.equal_range(block->pre_block_hash);
+    for (auto it = range.first; it != range.second; it++) {
+        if (it->second == hash) {
+            orphans_by_parent.erase(it);
+            break;
+        }
+    }
+    return block;
+}
+
+// 丢弃父区块既不在队列中, 也不在请求或缓存中的区块. 父区块可能已经放弃下载, 或者由其他途径接入了链
+// (例如本地挖出的区块), 把父区块和被丢弃的区块重新排队; 多次丢弃后放弃
+void BlockDownloader::drop_orphans() {
+    vector<Hash256> dropped;
+    for (auto& kv : orphans) {
+        const Hash256& parent = kv.second->pre_block_hash;
+        if (!queued_hashes.count(parent) && !requests.count(parent) && !orphans.count(parent)) {
+            dropped.push_back(kv.first);
+        }
+    }
+    if (dropped.empty()) {
+        return;
+    }
+    std::cout << "Drop " << dropped.size() << " blocks with missing parents" << std::endl;
+    for (auto& hash : dropped) {
+        unique_ptr<Block> block(take_orphan(hash));
+        if (++drops[hash] >= DOWNLOAD_MAX_ATTEMPTS) {
+            std::cout << "Give up downloading block " << hash << std::endl;
+            drops.erase(hash);
+            continue;
+        }
+        add({block->pre_block_hash, hash});
+    }
+}
+
+// 向 peers 发送请求, 直到窗口填满
+void BlockDownloader::schedule(const vector<string>& peers) {
+    if (peers.empty()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    // 窗口被缓存的区块占满时仍保留一个请求, 保证缺失的父区块能被请求
+    while (!queue.empty() && (requests.empty() || requests.size() + orphans.size() - unsolicited.size() < (size_t)window)) {
+        Hash256 hash = queue.front();
+        queue.pop_front();
+        queued_hashes.erase(hash);
+        send_request(hash, peers, 1, now);
+    }
+}
+
+// 超时的请求换一个节点重试
+void BlockDownloader::tick(std::chrono::steady_clock::time_point now, const vector<string>& peers) {
+    vector<pair<Hash256, int>> expired;
+    for (auto& kv : requests) {
+        if (now - kv.second.sent_at >= DOWNLOAD_TIMEOUT) {
+            expired.push_back(make_pair(kv.first, kv.second.attempts));
+        }
+    }
+    for (auto& item : expired) {
+        requests.erase(item.first);
+        if (item.second >= DOWNLOAD_MAX_ATTEMPTS || peers.empty()) {
+            std::cout << "Give up downloading block " << item.first << std::endl;
+            continue;
+        }
+        send_request(item.first, peers, item.second + 1, now);
+    }
+    // 没有未完成的请求时, 父区块缺失的缓存区块不会再被放行
+    if (requests.empty()) {
+        drop_orphans();
+    }
+    schedule(peers);
+}
+
+// 未完成的请求数
+size_t BlockDownloader::in_flight() {
+    return requests.size();
+}
+
+// 已收到但父区块尚未接入的区块数
+size_t BlockDownloader::buffered() {
+    return orphans.size();
+}
+
+// 排队等待请求的区块数
+size_t BlockDownloader::queued() {
+    return queue.size();
+}
+
+// 向下一个节点发送请求
+void BlockDownloader::send_request(const Hash256& hash, const vector<string>& peers, int attempts,
+                                   std::chrono::steady_clock::time_point now) {
+    const string& peer = peers[next_peer++ % peers.size()];
+    requests[hash] = Request{peer, now, attempts};
+    request(peer, hash);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include "block.h"
+
+// 请求超时时间, 超时后换一个节点重试
+const std::chrono::milliseconds DOWNLOAD_TIMEOUT(5000);
+
+// 单个区块的最大请求次数, 超过后放弃
+const int DOWNLOAD_MAX_ATTEMPTS = 5;
+
+// 区块下载调度器
+// 同时保持最多 window 个未完成的区块请求, 请求轮流分配给各个节点. 乱序到达的区块先缓存, 并按父区块哈希建立索引,
+// 父区块接入后再依次放行(同一父区块的多个分叉区块都会放行), 因此返回给调用方的区块中父区块总在子区块之前.
+// 请求得到的缓存区块也占用窗口; 未经请求到达的缓存区块不占用窗口, 单独限制为最多 window 个.
+// 没有未完成的请求时, 父区块既不在队列中也不在请求或缓存中的区块被丢弃, 连同父区块重新排队下载.
+// 调度器不是线程安全的, 由调用方加锁.
+class BlockDownloader {
+public:
+    // 发送区块请求: (节点地址, 区块哈希)
+    typedef function<void(const string&, const Hash256&)> RequestFn;
+
+    // 查询本地是否已有区块
+    typedef function<bool(const Hash256&)> HasBlockFn;
+
+    BlockDownloader(int window, RequestFn request, HasBlockFn has_block);
+
+    ~BlockDownloader();
+
+    // 添加待下载的区块哈希, 按给定顺序请求, 已有或已在下载中的区块会被跳过
+    void add(const vector<Hash256>& hashes);
+
+    // 收到区块(取得所有权), 返回可以按顺序接入链的区块, 所有权转移给调用方
+    vector<Block*> on_block(Block* block);
+
+    // 区块接入链后调用, 返回在它接入之前到达、以它为祖先的缓存区块, 所有权转移给调用方
+    vector<Block*> on_connected(const Hash256& hash);
+
+    // 向 peers 发送请求, 直到窗口填满
+    void schedule(const vector<string>& peers);
+
+    // 超时的请求换一个节点重试, 多次失败后放弃
+    void tick(std::chrono::steady_clock::time_point now, const vector<string>& peers);
+
+    // 未完成的请求数
+    size_t in_flight();
+
+    // 已收到但父区块尚未接入的区块数
+    size_t buffered();
+
+    // 排队等待请求的区块数
+    size_t queued();
+
+private:
+    // 未完成的请求
+    struct Request {
+        string peer;
+        std::chrono::steady_clock::time_point sent_at;
+        int attempts;
+    };
+
+    int window;
+    RequestFn request;
+    HasBlockFn has_block;
+    deque<Hash256> queue; // 等待请求的区块哈希
+    set<Hash256> queued_hashes;
+    map<Hash256, Request> requests; // 区块哈希 -> 未完成的请求
+    map<Hash256, Block*> orphans; // 区块哈希 -> 父区块尚未接入的区块
+    multimap<Hash256, Hash256> orphans_by_parent; // 父区块哈希 -> 缓存中的子区块哈希
+    set<Hash256> unsolicited; // 缓存中未经请求到达的区块, 不占用窗口
+    map<Hash256, int> drops; // 区块因父区块缺失被丢弃的次数
+    size_t next_peer; // 轮流分配节点
+
+    // 放行缓存中以 ready 里的区块为祖先的区块, 追加到 ready 末尾
+    void release_descendants(vector<Block*>& ready);
+
+    // 从缓存中取出区块, 所有权转移给调用方
+    Block* take_orphan(const Hash256& hash);
+
+    // 丢弃父区块不会再到达的缓存区块, 并把它们和父区块重新排队
+    void drop_orphans();
+
+    // 向下一个节点发送请求
+    void send_request(const Hash256& hash, const vector<string>& peers, int attempts,
+                      std::chrono::steady_clock::time_point now);
+};
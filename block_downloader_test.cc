@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include "block_downloader.h"
+
+// 测试用的区块哈希
+static Hash256 h(const string& label) {
+    return Hash256::sha256(label);
+}
+
+// 构造只有哈希和父区块哈希的区块
+static Block* make_block(const string& hash, const string& pre_block_hash) {
+    Block* block = new Block;
+    block->hash = h(hash);
+    block->pre_block_hash = h(pre_block_hash);
+    return block;
+}
+
+TEST(BlockDownloaderTests, window_and_order) {
+    set<Hash256> chain{h("h0")};
+    vector<pair<string, Hash256>> sent;
+    BlockDownloader downloader(
+        3,
+        [&sent](const string& peer, const Hash256& hash) { sent.push_back(make_pair(peer, hash)); },
+        [&chain](const Hash256& hash) { return chain.count(hash) > 0; });
+
+    downloader.add({h("h0"), h("h1"), h("h2"), h("h3"), h("h4")});
+    downloader.schedule({"a", "b"});
+    // 已有的区块被跳过, 最多 3 个请求, 轮流分配给两个节点
+    ASSERT_EQ(sent.size(), 3);
+    EXPECT_EQ(sent[0], make_pair(string("a"), h("h1")));
+    EXPECT_EQ(sent[1], make_pair(string("b"), h("h2")));
+    EXPECT_EQ(sent[2], make_pair(string("a"), h("h3")));
+    EXPECT_EQ(downloader.queued(), 1);
+
+    // 乱序到达的区块被缓存, 并且继续占用窗口
+    EXPECT_TRUE(downloader.on_block(make_block("h3", "h2")).empty());
+    EXPECT_TRUE(downloader.on_block(make_block("h2", "h1")).empty());
+    downloader.schedule({"a", "b"});
+    EXPECT_EQ(sent.size(), 3);
+    EXPECT_EQ(downloader.buffered(), 2);
+
+    // 父区块到达后按高度顺序放行
+    vector<Block*> ready = downloader.on_block(make_block("h1", "h0"));
+    ASSERT_EQ(ready.size(), 3);
+    EXPECT_EQ(ready[0]->hash, h("h1"));
+    EXPECT_EQ(ready[1]->hash, h("h2"));
+    EXPECT_EQ(ready[2]->hash, h("h3"));
+    for (auto block : ready) {
+        chain.insert(block->hash);
+        delete block;
+    }
+    downloader.schedule({"a", "b"});
+    ASSERT_EQ(sent.size(), 4);
+    EXPECT_EQ(sent[3].second, h("h4"));
+
+    // 超时后换一个节点重试
+    downloader.tick(std::chrono::steady_clock::now() + DOWNLOAD_TIMEOUT, {"a", "b"});
+    ASSERT_EQ(sent.size(), 5);
+    EXPECT_EQ(sent[4].second, h("h4"));
+    EXPECT_NE(sent[4].first, sent[3].first);
+    EXPECT_EQ(downloader.in_flight(), 1);
+}
+
+TEST(BlockDownloaderTests, sibling_orphans) {
+    set<Hash256> chain{h("h0")};
+    BlockDownloader downloader(
+        4,
+        [](const string&, const Hash256&) {},
+        [&chain](const Hash256& hash) { return chain.count(hash) > 0; });
+
+    // 同一父区块的两个分叉区块都先于父区块到达, 都要保留
+    EXPECT_TRUE(downloader.on_block(make_block("h2a", "h1")).empty());
+    EXPECT_TRUE(downloader.on_block(make_block("h2b", "h1")).empty());
+    EXPECT_TRUE(downloader.on_block(make_block("h3b", "h2b")).empty());
+    EXPECT_EQ(downloader.buffered(), 3);
+
+    vector<Block*> ready = downloader.on_block(make_block("h1", "h0"));
+    ASSERT_EQ(ready.size(), 4);
+    EXPECT_EQ(ready[0]->hash, h("h1"));
+    set<Hash256> siblings{ready[1]->hash, ready[2]->hash};
+    EXPECT_EQ(siblings, (set<Hash256>{h("h2a"), h("h2b")}));
+    EXPECT_EQ(ready[3]->hash, h("h3b"));
+    EXPECT_EQ(downloader.buffered(), 0);
+
+    // h1 放行后尚未接入链时到达的子区块先缓存, h1 接入后放行
+    EXPECT_TRUE(downloader.on_block(make_block("h2c", "h1")).empty());
+    EXPECT_TRUE(downloader.on_block(make_block("h3c", "h2c")).empty());
+    chain.insert(h("h1"));
+    vector<Block*> children = downloader.on_connected(h("h1"));
+    ASSERT_EQ(children.size(), 2);
+    EXPECT_EQ(children[0]->hash, h("h2c"));
+    EXPECT_EQ(children[1]->hash, h("h3c"));
+    EXPECT_EQ(downloader.buffered(), 0);
+    EXPECT_TRUE(downloader.on_connected(h("h2a")).empty());
+    ready.insert(ready.end(), children.begin(), children.end());
+    for (auto block : ready) {
+        delete block;
+    }
+}
+
+TEST(BlockDownloaderTests, drop_orphans) {
+    set<Hash256> chain{h("h0")};
+    vector<Hash256> sent;
+    BlockDownloader downloader(
+        2,
+        [&sent](const string&, const Hash256& hash) { sent.push_back(hash); },
+        [&chain](const Hash256& hash) { return chain.count(hash) > 0; });
+
+    // 未经请求到达的区块不占用窗口, 队列中的区块照常请求
+    EXPECT_TRUE(downloader.on_block(make_block("h3", "h2")).empty());
+    EXPECT_TRUE(downloader.on_block(make_block("x1", "x0")).empty());
+    downloader.add({h("h1"), h("h2")});
+    downloader.schedule({"a"});
+    ASSERT_EQ(sent, (vector<Hash256>{h("h1"), h("h2")}));
+
+    // 父区块已在请求中的区块保留, 不会被丢弃
+    downloader.tick(std::chrono::steady_clock::now(), {"a"});
+    EXPECT_EQ(downloader.buffered(), 2);
+
+    // h2 的请求放弃后没有未完成的请求, h2 仍在请求中时缓存的 h3 和父区块缺失的 x1 被丢弃,
+    // 连同父区块重新排队
+    vector<Block*> ready = downloader.on_block(make_block("h1", "h0"));
+    ASSERT_EQ(ready.size(), 1);
+    chain.insert(h("h1"));
+    delete ready[0];
+    auto now = std::chrono::steady_clock::now();
+    for (int attempt = 1; attempt < DOWNLOAD_MAX_ATTEMPTS; attempt++) {
+        now += DOWNLOAD_TIMEOUT;
+        downloader.tick(now, {"a"});
+        EXPECT_EQ(downloader.buffered(), 2);
+    }
+    sent.clear();
+    downloader.tick(now + DOWNLOAD_TIMEOUT, {"a"});
+    EXPECT_EQ(downloader.buffered(), 0);
+    EXPECT_EQ(downloader.in_flight(), 2);
+    EXPECT_EQ(downloader.queued(), 2);
+    ASSERT_EQ(sent.size(), 2);
+    // 父区块排在被丢弃的区块之前
+    map<Hash256, Hash256> children{{h("h2"), h("h3")}, {h("x0"), h("x1")}};
+    ASSERT_TRUE(children.count(sent[0]));
+    EXPECT_EQ(sent[1], children[sent[0]]);
+
+    // 重新下载的父区块到达后放行
+    EXPECT_TRUE(downloader.on_block(make_block("h3", "h2")).empty());
+    ready = downloader.on_block(make_block("h2", "h1"));
+    ASSERT_EQ(ready.size(), 2);
+    EXPECT_EQ(ready[0]->hash, h("h2"));
+    EXPECT_EQ(ready[1]->hash, h("h3"));
+    for (auto block : ready) {
+        delete block;
+    }
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "block.h"
+#include "proofofwork.h"
+#include "wallet.h"
+
+TEST(BlockTests, serialize_block) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    auto coinbase_tx = Transaction::new_coinbase_tx(wallet->get_address());
+    unique_ptr<Block> block(new_block(Hash256(), vector<Transaction*>{coinbase_tx}, 0));
+    // 二进制格式和 JSON 格式都能被解析
+    unique_ptr<Block> from_bytes(Block::parse(block->serialize()));
+    unique_ptr<Block> from_json(Block::parse(block->to_json()));
+    for (auto decoded : {from_bytes.get(), from_json.get()}) {
+        ASSERT_NE(decoded, nullptr);
+        EXPECT_EQ(block->hash, decoded->hash);
+        EXPECT_EQ(block->pre_block_hash, decoded->pre_block_hash);
+        EXPECT_EQ(block->timestamp, decoded->timestamp);
+        EXPECT_EQ(block->nonce, decoded->nonce);
+        EXPECT_EQ(block->height, decoded->height);
+        ASSERT_EQ(decoded->transactions.size(), 1);
+        EXPECT_EQ(coinbase_tx->serialize_transaction(), decoded->transactions[0]->serialize_transaction());
+    }
+    // 截断的数据解析失败
+    string bytes = block->serialize();
+    EXPECT_EQ(Block::parse(bytes.substr(0, bytes.size() - 1)), nullptr);
+}
+
+TEST(BlockTests, decode_into_arena) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    auto coinbase_tx = Transaction::new_coinbase_tx(wallet->get_address());
+    unique_ptr<Block> block(new_block(Hash256(), vector<Transaction*>{coinbase_tx}, 0));
+    EXPECT_EQ(block->arena, nullptr);
+    unique_ptr<Block> decoded(Block::deserialize(block->serialize()));
+    ASSERT_NE(decoded, nullptr);
+    // 解码得到的交易和字节数组都分配在区块的内存池上
+    ASSERT_NE(decoded->arena, nullptr);
+    Transaction* tx = decoded->transactions[0];
+    EXPECT_EQ(tx->vin.get_allocator().resource(), decoded->arena.get());
+    EXPECT_EQ(tx->vin[0].signature.get_allocator().resource(), decoded->arena.get());
+    EXPECT_EQ(tx->vout[0].pub_key_hash.get_allocator().resource(), decoded->arena.get());
+    // 克隆的交易在堆上, 区块释放后仍然可用
+    unique_ptr<Transaction> copy(tx->clone());
+    EXPECT_EQ(copy->vin[0].signature.get_allocator().resource(), std::pmr::get_default_resource());
+    decoded.reset();
+    EXPECT_EQ(coinbase_tx->serialize_transaction(), copy->serialize_transaction());
+}
+
+TEST(BlockTests, block_view) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    auto coinbase_tx = Transaction::new_coinbase_tx(wallet->get_address());
+    auto second_tx = Transaction::new_coinbase_tx(wallet->get_address(), 5);
+    unique_ptr<Block> block(new_block(Hash256(), vector<Transaction*>{coinbase_tx, second_tx}, 0));
+    // 视图在二进制格式和 JSON 格式上提供相同的结果
+    string bytes = block->serialize();
+    string json = block->to_json();
+    for (auto encoded : {&bytes, &json}) {
+        BlockView view;
+        ASSERT_TRUE(view.parse(encoded->data(), encoded->size()));
+        EXPECT_EQ(block->hash, view.header().hash);
+        EXPECT_EQ(block->height, view.header().height);
+        ASSERT_EQ(view.transaction_count(), 2);
+        Hash256 id;
+        ASSERT_TRUE(view.transaction_id(1, id));
+        EXPECT_EQ(second_tx->id, id);
+        EXPECT_FALSE(view.transaction_id(2, id));
+        unique_ptr<Transaction> tx(view.transaction(1));
+        ASSERT_NE(tx, nullptr);
+        EXPECT_EQ(second_tx->serialize_transaction(), tx->serialize_transaction());
+        unique_ptr<Block> decoded(view.to_block());
+        ASSERT_NE(decoded, nullptr);
+        EXPECT_EQ(decoded->transactions.size(), 2);
+    }
+    // 交易数据截断时区块头仍可读取, 交易访问失败
+    BlockView view;
+    ASSERT_TRUE(view.parse(bytes.data(), bytes.size() - 1));
+    EXPECT_EQ(block->hash, view.header().hash);
+    EXPECT_EQ(view.transaction(0), nullptr);
+    EXPECT_EQ(view.to_block(), nullptr);
+}
+
+TEST(BlockTests, decode_version1) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    auto coinbase_tx = Transaction::new_coinbase_tx(wallet->get_address());
+    unique_ptr<Block> block(new_block(Hash256(), vector<Transaction*>{coinbase_tx}, 0));
+    // 版本 1 的哈希和交易 ID 都是带长度前缀的 16 进制字符串
+    Encoder enc;
+    enc.put_u8(BLOCK_FORMAT_MAGIC);
+    enc.put_u8(1);
+    enc.put_u64(static_cast<uint64_t>(block->timestamp));
+    enc.put_u64(static_cast<uint64_t>(block->nonce));
+    enc.put_u64(static_cast<uint64_t>(block->height));
+    enc.put_string(block->hash.to_hex());
+    enc.put_string("None");
+    enc.put_varint(1);
+    Encoder tx_enc;
+    tx_enc.put_string(coinbase_tx->id.to_hex());
+    tx_enc.put_varint(1);
+    tx_enc.put_string("None");
+    tx_enc.put_u32(0);
+    tx_enc.put_bytes(coinbase_tx->vin[0].signature);
+    tx_enc.put_bytes(coinbase_tx->vin[0].pub_key);
+    tx_enc.put_varint(1);
+    tx_enc.put_u32(static_cast<uint32_t>(coinbase_tx->vout[0].value));
+    tx_enc.put_bytes(coinbase_tx->vout[0].pub_key_hash);
+    enc.put_string(tx_enc.data());
+
+    unique_ptr<Block> decoded(Block::parse(enc.data()));
+    ASSERT_NE(decoded, nullptr);
+    EXPECT_EQ(decoded->hash, block->hash);
+    EXPECT_TRUE(decoded->pre_block_hash.is_null());
+    ASSERT_EQ(decoded->transactions.size(), 1);
+    EXPECT_EQ(decoded->transactions[0]->id, coinbase_tx->id);
+    EXPECT_TRUE(ProofOfWork(decoded.get()).validate());
+}
+
+TEST(BlockTests, cancel_mining) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    // 取消标志已置位, 挖矿立即放弃
+    std::atomic<bool> cancel(true);
+    Block* block = new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0, &cancel);
+    EXPECT_EQ(block, nullptr);
+}
+
+TEST(BlockTests, serialize_header) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Block> block(new_block(genesis->hash, vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 1));
+    for (auto b : {genesis.get(), block.get()}) {
+        string bytes = b->header().serialize();
+        ASSERT_EQ(bytes.size(), BLOCK_HEADER_SIZE);
+        Decoder dec(bytes);
+        BlockHeader header;
+        ASSERT_TRUE(BlockHeader::deserialize(dec, header));
+        EXPECT_EQ(header.hash, b->hash);
+        EXPECT_EQ(header.pre_block_hash, b->pre_block_hash);
+        EXPECT_EQ(header.timestamp, b->timestamp);
+        EXPECT_EQ(header.nonce, b->nonce);
+        EXPECT_EQ(header.height, b->height);
+        EXPECT_TRUE(hash_meets_target(header.hash));
+    }
+    // 工作量证明校验: 篡改随机数后失败
+    EXPECT_TRUE(ProofOfWork(block.get()).validate());
+    block->nonce++;
+    EXPECT_FALSE(ProofOfWork(block.get()).validate());
+}
@@ -1,5 +1,9 @@
+#include <json/json.h>
 #include "blockchain.h"
 #include "block.h"
+#include "config.h"
+#include "proofofwork.h"
+#include "signature_verifier.h"
 #include "util.h"
 #include "wallet.h"
 
@@ -11,12 +15,39 @@ using ROCKSDB_NAMESPACE::WriteBatch;
 using ROCKSDB_NAMESPACE::WriteOptions;
 
 const string kDBPath = "./data/blocks";
+// 旧版本的 tip 键, 仅用于升级
 const string tipBlockHashKey = "tip_block_hash";
+// tip 元数据键, 保存最新区块的哈希、高度和累计工作量
+const string tipMetaKey = "tip_meta";
+// 高度索引键前缀, height -> 区块哈希
+const string heightIndexPrefix = "height_index:";
+// 交易索引键前缀, txid -> (区块哈希, 交易位置)
+const string txIndexPrefix = "tx_index:";
+// 区块头键前缀, 区块哈希 -> 88 字节区块头
+const string headerPrefix = "header:";
+// 区块数据版本键, 版本 2 起区块和索引都以 32 字节原始哈希为键
+const string blocksVersionKey = "blocks_version";
+const string BLOCKS_VERSION = "2";
+
+// 交易索引键
+string tx_index_key(const Hash256& txid);
+
+// 将区块中的交易写入索引
+void index_transactions(WriteBatch& batch, Block* block);
+
+// 高度索引键
+string height_key(long height);
+
+// 区块头键
+string header_key(const Hash256& block_hash);
 
 // 构造函数
-Blockchain::Blockchain(DB* db, string tip) {
+Blockchain::Blockchain(DB* db, const Hash256& tip) {
     this->tip = tip;
     this->db = db;
+    this->tip_height = -1;
+    this->tip_work = 0;
+    this->block_cache.reset(new BlockCache(Config::get_instance()->get_block_cache_size()));
 }
 
 // 创建新的区块链
@@ -37,84 +68,195 @@ Blockchain* Blockchain::new_blockchain() {
         exit(1);
     }
 
-    string tip;
-    db->Get(ReadOptions(), tipBlockHashKey, &tip);
-    if (tip == "") {
-        // 本地没有联网, 手动同步创世块的钱包
-        unique_ptr<Wallet> genesis_wallet(Wallet::new_wallet());
-        // 创建创世区块
-        auto coinbase_tx = Transaction::new_coinbase_tx(genesis_wallet->get_address());
-        unique_ptr<Block> block(generate_genesis_block(coinbase_tx));
-        string block_hash = block->hash;
-        // 序列化 
-        string block_str = block->to_json();
-
-        WriteBatch batch;
-        batch.Put(block_hash, block_str);
-        batch.Put(tipBlockHashKey, block_hash);
-        status = db->Write(WriteOptions(), &batch);
-        if (!status.ok()) {
-            std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
-            exit(1);
+    Blockchain* bc = new Blockchain(db, Hash256());
+    string version;
+    db->Get(ReadOptions(), blocksVersionKey, &version);
+    if (version == BLOCKS_VERSION) {
+        if (bc->load_tip_meta()) {
+            return bc;
+        }
+    } else if (bc->upgrade()) {
+        return bc;
+    }
+    // 本地没有联网, 手动同步创世块的钱包
+    unique_ptr<Wallet> genesis_wallet(Wallet::new_wallet());
+    // 创建创世区块
+    auto coinbase_tx = Transaction::new_coinbase_tx(genesis_wallet->get_address());
+    unique_ptr<Block> block(generate_genesis_block(coinbase_tx));
+    // 序列化 
+    string block_str = block->serialize();
+
+    WriteBatch batch;
+    batch.Put(block->hash.raw(), block_str);
+    batch.Put(header_key(block->hash), block->header().serialize());
+    index_transactions(batch, block.get());
+    bc->set_tip(batch, block.get());
+    batch.Put(blocksVersionKey, BLOCKS_VERSION);
+    status = db->Write(WriteOptions(), &batch);
+    if (!status.ok()) {
+        std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
+        exit(1);
+    }
+    return bc;
+}
+
+// 从元数据中加载 tip
+bool Blockchain::load_tip_meta() {
+    string meta;
+    Status status = db->Get(ReadOptions(), tipMetaKey, &meta);
+    if (!status.ok()) {
+        return false;
+    }
+    Json::Reader reader;
+    Json::Value root;
+    if (!reader.parse(meta, root) || !Hash256::from_hex(root["hash"].asString(), this->tip)) {
+        return false;
+    }
+    this->tip_height = root["height"].asInt64();
+    this->tip_work = root["work"].asInt64();
+    return true;
+}
+
+// 更新 tip, 同时写入元数据和高度索引
+// 新的 tip 在另一条分支上时, 沿父区块向前改写高度索引, 直到遇到已在索引中的祖先; 高于新 tip 的索引删除
+void Blockchain::set_tip(WriteBatch& batch, Block* block) {
+    long old_height = this->tip_height;
+    this->tip = block->hash;
+    this->tip_height = block->height;
+    // 难度固定, 累计工作量与区块数量成正比
+    this->tip_work = (block->height + 1) * block_work();
+    Json::Value root;
+    root["hash"] = this->tip.to_hex();
+    root["height"] = int64_t(this->tip_height);
+    root["work"] = int64_t(this->tip_work);
+    Json::FastWriter writer;
+    batch.Put(tipMetaKey, writer.write(root));
+    batch.Put(height_key(block->height), block->hash.raw());
+    Hash256 hash = block->pre_block_hash;
+    for (long height = block->height - 1; height >= 0 && !hash.is_null(); height--) {
+        if (get_block_hash(height) == hash) {
+            break;
+        }
+        batch.Put(height_key(height), hash.raw());
+        BlockHeader header;
+        if (!get_header(hash, header)) {
+            break;
         }
-        tip = block_hash;
+        hash = header.pre_block_hash;
+    }
+    for (long height = block->height + 1; height <= old_height; height++) {
+        batch.Delete(height_key(height));
     }
-    return new Blockchain(db, tip);
+}
+
+// 升级旧版本的区块数据
+bool Blockchain::upgrade() {
+    // 旧版本的 tip 保存在元数据中, 更早的版本只有 tip_block_hash
+    string tip_hex;
+    if (load_tip_meta()) {
+        tip_hex = this->tip.to_hex();
+    } else {
+        db->Get(ReadOptions(), tipBlockHashKey, &tip_hex);
+    }
+    Hash256 tip;
+    if (!Hash256::from_hex(tip_hex, tip) || tip.is_null()) {
+        return false;
+    }
+    WriteBatch batch;
+    unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
+    int blocks = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        string key = it->key().ToString();
+        Hash256 hash;
+        if (key.size() == 64 && Hash256::from_hex(key, hash)) {
+            // 区块内容不变, 读取时兼容旧格式
+            batch.Put(hash.raw(), it->value());
+            batch.Delete(it->key());
+            blocks++;
+        } else if (it->key().starts_with(headerPrefix)) {
+            // 旧的区块头以 16 进制哈希为键, 由 reindex 重新写入
+            batch.Delete(it->key());
+        }
+    }
+    Status status = db->Write(WriteOptions(), &batch);
+    if (!status.ok()) {
+        std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
+        exit(1);
+    }
+    this->tip = tip;
+    reindex();
+    status = db->Put(WriteOptions(), blocksVersionKey, BLOCKS_VERSION);
+    if (!status.ok()) {
+        std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
+        exit(1);
+    }
+    std::cout << "Upgraded " << blocks << " blocks to version " << BLOCKS_VERSION << " keys" << std::endl;
+    return true;
 }
 
 // 挖矿新区块
 Block* Blockchain::mine_block(vector<Transaction*> transactions) {
-    for (auto tx : transactions) {
-        if (tx->verify(this) == false ) {
-            std::cerr << "ERROR: Invalid transaction" << std::endl;
-            exit(1);
-        }
+    // 并行验证全部输入的签名
+    VerifyResult result = SignatureVerifier::get_instance()->verify(transactions, this);
+    if (!result.ok) {
+        std::cerr << "ERROR: Invalid transaction " << result.failed_txid << std::endl;
+        exit(1);
     }
+    std::cout << "Verified " << result.inputs << " inputs (" << result.cached << " cached) in " << result.micros / 1000.0 << " ms" << std::endl;
     long last_height = this->get_last_height();
     Block* block = new_block(this->tip, transactions, last_height + 1);
-    string block_hash = block->hash; 
+    Hash256 block_hash = block->hash;
     // 序列化
-    string block_str = block->to_json();
+    string block_str = block->serialize();
 
     WriteBatch batch;
-    batch.Put(block_hash, block_str);
-    batch.Put(tipBlockHashKey, block_hash);
+    batch.Put(block_hash.raw(), block_str);
+    batch.Put(header_key(block_hash), block->header().serialize());
+    index_transactions(batch, block);
+    set_tip(batch, block);
     Status s = db->Write(WriteOptions(), &batch);
     if (!s.ok()) {
         std::cerr << "Failed to write database: " << s.ToString() << std::endl; 
         exit(1);
     }
-    this->tip = block_hash;
     return block;
 }
 
 // 添加区块
 void Blockchain::add_block(Block* block) {
-    string block_hash = block->hash;
+    Hash256 block_hash = block->hash;
+    string block_bytes = block->serialize();
     WriteBatch batch;
-    batch.Put(block_hash, block->to_json());
+    batch.Put(block_hash.raw(), block_bytes);
+    batch.Put(header_key(block_hash), block->header().serialize());
+    index_transactions(batch, block);
+    unconnected_headers.erase(block_hash);
     // 更新 tip
-    long last_height = get_last_height();
-    if (block->height > last_height) {
-        batch.Put(tipBlockHashKey, block_hash);
+    if (block->height > tip_height) {
+        set_tip(batch, block);
+    } else {
+        // 区块倒序下载时, 补齐缺失的高度索引. 只有索引中的下一个区块接在它之后时它才在主链上
+        string indexed_hash;
+        Status s = db->Get(ReadOptions(), height_key(block->height), &indexed_hash);
+        BlockHeader child;
+        if (s.IsNotFound() && get_header(get_block_hash(block->height + 1), child) && child.pre_block_hash == block_hash) {
+            batch.Put(height_key(block->height), block_hash.raw());
+        }
     }
     Status s = db->Write(WriteOptions(), &batch);
     if (!s.ok()) {
         std::cerr << "Failed to write database: " << s.ToString() << std::endl; 
         exit(1);
     }
-    if (block->height > last_height) {
-        this->tip = block_hash;
-    }
 }
 
 // 找到足够的未花费输出
-pair<int, map<string, vector<int>>> Blockchain::find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount) {
+pair<int, map<Hash256, vector<int>>> Blockchain::find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount) {
     int accumulated = 0;
-    map<string, vector<int>> unspent_outputs;
+    map<Hash256, vector<int>> unspent_outputs;
     vector<Transaction*> unspent_txs = this->find_unspent_transactions(pub_key_hash);
     for (auto tx : unspent_txs) {
-        string txid = tx->id;
+        Hash256 txid = tx->id;
         for (int out_idx = 0; out_idx < tx->vout.size(); out_idx++) {
             auto txout = tx->vout[out_idx];
             if (txout.is_locked_with_key(pub_key_hash) && accumulated < amount) {
@@ -137,19 +279,21 @@ pair<int, map<string, vector<int>>> Blockchain::find_spendable_outputs(vector<un
 // 3.一个输入必须引用一个输出。
 vector<Transaction*> Blockchain::find_unspent_transactions(vector<unsigned char> pub_key_hash) {
     vector<Transaction*> unspent_txs;
-    map<string, vector<int>> spent_txos; 
+    map<Hash256, vector<int>> spent_txos; 
     // 指针自动释放
     unique_ptr<BlockchainIterator> iter(this->iterator());
 
     while (true) {
-        unique_ptr<Block> block(iter->next());
+        shared_ptr<Block> block = iter->next();
         if (block == nullptr) {
             break;
         }
-        for (auto tx : block->transactions) {
+        // 区块内的交易可以花费排在它前面的交易的输出, 倒序处理, 使花费先于被花费的输出记录
+        for (auto it = block->transactions.rbegin(); it != block->transactions.rend(); it++) {
+            Transaction* tx = *it;
             // 未花费输出
-            string tx_id = tx->id;
-            vector<TXOutput> txouts = tx->vout;
+            Hash256 tx_id = tx->id;
+            auto& txouts = tx->vout;
             for (int idx = 0; idx < txouts.size(); idx++) {
                 auto txout = txouts[idx]; 
                 // 过滤掉已经花费的输出
@@ -174,7 +318,7 @@ vector<Transaction*> Blockchain::find_unspent_transactions(vector<unsigned char>
             // 在输入中找到未花费的输出
             for (auto txin : tx->vin) {
                 if (txin.uses_key(pub_key_hash)) {
-                    string txid = txin.txid;
+                    Hash256 txid = txin.txid;
                     spent_txos[txid].push_back(txin.vout);
                 }
             }
@@ -183,19 +327,21 @@ vector<Transaction*> Blockchain::find_unspent_transactions(vector<unsigned char>
     return unspent_txs;
 }
 
-// 查找所有未花费的交易输出 k -> txid, v -> vector<TXOutput>
-map<string, vector<TXOutput>> Blockchain::find_utxo() {
-    map<string, vector<TXOutput>> utxo;
-    map<string, vector<int>> spent_txos;
+// 查找所有未花费的交易输出 k -> (txid, vout), v -> TXOutput
+map<OutPoint, TXOutput> Blockchain::find_utxo() {
+    map<OutPoint, TXOutput> utxo;
+    map<Hash256, vector<int>> spent_txos;
     unique_ptr<BlockchainIterator> iter(this->iterator());
     while (true) {
-        unique_ptr<Block> block(iter->next());
+        shared_ptr<Block> block = iter->next();
         if (block == nullptr) {
             break;
         }
-        for (auto tx : block->transactions) {
-            string tx_id = tx->id;
-            vector<TXOutput> txouts = tx->vout;
+        // 与 find_unspent_transactions 相同, 区块内倒序处理
+        for (auto it = block->transactions.rbegin(); it != block->transactions.rend(); it++) {
+            Transaction* tx = *it;
+            Hash256 tx_id = tx->id;
+            auto& txouts = tx->vout;
             for (int idx = 0; idx < txouts.size(); idx++) {
                 auto txout = txouts[idx];
                 // 过滤掉已经花费的输出
@@ -207,7 +353,7 @@ map<string, vector<TXOutput>> Blockchain::find_utxo() {
                         }
                     }
                 }
-                utxo[tx_id].push_back(txout);
+                utxo[OutPoint{tx_id, idx}] = txout;
             endloop:
                 continue;
             }
@@ -216,7 +362,7 @@ map<string, vector<TXOutput>> Blockchain::find_utxo() {
             }
             // 在输入中找到已花费输出
             for (auto txin : tx->vin) {
-                string txid = txin.txid;
+                Hash256 txid = txin.txid;
                 spent_txos[txid].push_back(txin.vout);
             }
         }
@@ -241,21 +387,69 @@ vector<TXOutput> Blockchain::find_utxo(vector<unsigned char> pub_key_hash) {
 }
 
 // 从区块链中查找交易
-Transaction* Blockchain::find_transaction(string txid) {
+Transaction* Blockchain::find_transaction(const Hash256& txid) {
+    // 通过交易索引定位区块
+    string location;
+    Status status = db->Get(ReadOptions(), tx_index_key(txid), &location);
+    if (!status.ok()) {
+        return nullptr;
+    }
+    Decoder dec(location);
+    Hash256 block_hash;
+    uint64_t pos;
+    if (!Hash256::decode(dec, block_hash) || !dec.get_varint(pos)) {
+        return nullptr;
+    }
+    shared_ptr<Block> cached = block_cache->get(block_hash);
+    if (cached != nullptr) {
+        if (pos >= cached->transactions.size() || cached->transactions[pos]->id != txid) {
+            return nullptr;
+        }
+        return cached->transactions[pos]->clone();
+    }
+    // 只解码索引指向的那一笔交易
+    PinnableSlice pinned;
+    BlockView view;
+    Hash256 id;
+    if (!get_block_view(block_hash, pinned, view) || !view.transaction_id(pos, id) || id != txid) {
+        return nullptr;
+    }
+    return view.transaction(pos);
+}
+
+// 重建区块索引
+void Blockchain::reindex() {
+    unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
+    // 清空交易索引和高度索引
+    WriteBatch batch;
+    for (it->Seek(txIndexPrefix); it->Valid() && it->key().starts_with(txIndexPrefix); it->Next()) {
+        batch.Delete(it->key());
+    }
+    for (it->Seek(heightIndexPrefix); it->Valid() && it->key().starts_with(heightIndexPrefix); it->Next()) {
+        batch.Delete(it->key());
+    }
+    // 从最新区块遍历至创世区块
     unique_ptr<BlockchainIterator> iter(this->iterator());
+    bool is_tip = true;
     while (true) {
-        unique_ptr<Block> block(iter->next());
+        shared_ptr<Block> block = iter->next();
         if (block == nullptr) {
             break;
         }
-        for (auto tx : block->transactions) {
-            if (tx->id == txid) {
-                // 拷贝交易
-                return tx->clone();
-            }
+        index_transactions(batch, block.get());
+        batch.Put(header_key(block->hash), block->header().serialize());
+        if (is_tip) {
+            set_tip(batch, block.get());
+            is_tip = false;
+        } else {
+            batch.Put(height_key(block->height), block->hash.raw());
         }
     }
-    return nullptr;
+    Status status = db->Write(WriteOptions(), &batch);
+    if (!status.ok()) {
+        std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
+        exit(1);
+    }
 }
 
 // 清空数据
@@ -268,47 +462,283 @@ void Blockchain::clear_data() {
 }
 
 // 根据区块哈希查找区块
-Block* Blockchain::get_block(string block_hash) {
-    if (block_hash == "") {
+shared_ptr<Block> Blockchain::get_block(const Hash256& block_hash) {
+    if (block_hash.is_null()) {
         return nullptr;
     }
-    string block_bytes;
-    Status status = db->Get(ReadOptions(), block_hash, &block_bytes);
+    shared_ptr<Block> block = block_cache->get(block_hash);
+    if (block != nullptr) {
+        return block;
+    }
+    PinnableSlice pinned;
+    Status status = db->Get(ReadOptions(), db->DefaultColumnFamily(), block_hash.raw(), &pinned);
     if (!status.ok()) {
         return nullptr; 
     }
-    return Block::from_json(block_bytes); 
+    block.reset(Block::parse(pinned.data(), pinned.size()));
+    if (block != nullptr && block_cache->enabled()) {
+        block_cache->insert(block);
+    }
+    return block;
+}
+
+// 根据区块哈希读取区块的只读视图
+bool Blockchain::get_block_view(const Hash256& block_hash, PinnableSlice& pinned, BlockView& view) {
+    if (block_hash.is_null()) {
+        return false;
+    }
+    pinned.Reset();
+    Status status = db->Get(ReadOptions(), db->DefaultColumnFamily(), block_hash.raw(), &pinned);
+    if (!status.ok()) {
+        return false;
+    }
+    return view.parse(pinned.data(), pinned.size());
 }
 
-// 查询链中的区块列表
-vector<string> Blockchain::get_block_hashes() {
-    vector<string> blocks;
-    unique_ptr<BlockchainIterator> iter(this->iterator());
-    while (true) {
-        unique_ptr<Block> block(iter->next());
-        if (block == nullptr) {
+// 根据区块哈希查找区块头, 没有单独存储区块头的旧数据从区块中读取
+bool Blockchain::get_header(const Hash256& block_hash, BlockHeader& header) {
+    string bytes;
+    Status status = db->Get(ReadOptions(), header_key(block_hash), &bytes);
+    if (status.ok()) {
+        Decoder dec(bytes);
+        return BlockHeader::deserialize(dec, header);
+    }
+    PinnableSlice pinned;
+    BlockView view;
+    if (!get_block_view(block_hash, pinned, view)) {
+        return false;
+    }
+    header = view.header();
+    return true;
+}
+
+// 查询主链上从高度 from 开始的至多 max_count 个区块头, 带交易 ID
+vector<BlockHeader> Blockchain::get_headers(long from, size_t max_count) {
+    vector<BlockHeader> headers;
+    PinnableSlice pinned;
+    BlockView view;
+    for (long height = std::max(from, 0L); height <= tip_height && headers.size() < max_count; height++) {
+        // 主链上的区块都有区块体, 交易 ID 从区块体中读取
+        if (!get_block_view(get_block_hash(height), pinned, view)) {
+            break;
+        }
+        BlockHeader header = view.header();
+        // 高度索引只在切换分支时整段改写, 仍然检查每个区块头接在前一个之后
+        if (!headers.empty() && header.pre_block_hash != headers.back().hash) {
             break;
         }
-        blocks.push_back(block->hash);
+        header.tx_ids.resize(view.transaction_count());
+        for (size_t pos = 0; pos < header.tx_ids.size(); pos++) {
+            view.transaction_id(pos, header.tx_ids[pos]);
+        }
+        headers.push_back(std::move(header));
     }
-    return blocks; 
+    return headers;
 }
 
-// 获取最新区块的高度
-long Blockchain::get_last_height() {
-    string block_bytes;
-    Status status = db->Get(ReadOptions(), this->tip, &block_bytes);
+// 区块定位器: 从链尾开始, 间隔按 2 的幂增长的区块哈希, 最后是创世区块
+vector<Hash256> Blockchain::get_locator() {
+    vector<Hash256> locator;
+    long step = 1;
+    for (long height = tip_height; height > 0; height -= step) {
+        locator.push_back(get_block_hash(height));
+        if (locator.size() >= 10) {
+            step *= 2;
+        }
+    }
+    if (tip_height >= 0) {
+        locator.push_back(get_block_hash(0));
+    }
+    return locator;
+}
+
+// 定位器中第一个位于本地主链上的区块高度, 都不在主链上时返回 -1
+long Blockchain::find_fork_height(const vector<Hash256>& locator) {
+    for (auto& hash : locator) {
+        BlockHeader header;
+        if (get_header(hash, header) && header.height <= tip_height && get_block_hash(header.height) == hash) {
+            return header.height;
+        }
+    }
+    return -1;
+}
+
+// 校验并保存一段连续的区块头
+bool Blockchain::add_headers(const vector<BlockHeader>& headers) {
+    if (unconnected_headers.size() + headers.size() > MAX_UNCONNECTED_HEADERS) {
+        return false;
+    }
+    WriteBatch batch;
+    vector<Hash256> added;
+    for (size_t i = 0; i < headers.size(); i++) {
+        const BlockHeader& header = headers[i];
+        // 由区块头的字段重新计算哈希, 伪造的区块头需要同样的工作量
+        if (!validate_header(header)) {
+            return false;
+        }
+        // 必须接在前一个区块头之后, 第一个区块头接在本地已知的区块头之后
+        if (i > 0) {
+            if (header.pre_block_hash != headers[i - 1].hash || header.height != headers[i - 1].height + 1) {
+                return false;
+            }
+        } else if (header.pre_block_hash.is_null()) {
+            if (header.height != 0) {
+                return false;
+            }
+        } else {
+            BlockHeader parent;
+            if (!get_header(header.pre_block_hash, parent) || header.height != parent.height + 1) {
+                return false;
+            }
+        }
+        // 已有区块体的区块头不需要重复保存
+        if (!has_block(header.hash)) {
+            batch.Put(header_key(header.hash), header.serialize());
+            added.push_back(header.hash);
+        }
+    }
+    Status status = db->Write(WriteOptions(), &batch);
+    if (!status.ok()) {
+        std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
+        exit(1);
+    }
+    unconnected_headers.insert(added.begin(), added.end());
+    return true;
+}
+
+// 尚未收到区块体的区块头数
+size_t Blockchain::unconnected_header_count() {
+    return unconnected_headers.size();
+}
+
+// 删除尚未收到区块体的区块头, 返回删除的数量
+size_t Blockchain::prune_headers() {
+    WriteBatch batch;
+    for (auto& hash : unconnected_headers) {
+        batch.Delete(header_key(hash));
+    }
+    Status status = db->Write(WriteOptions(), &batch);
     if (!status.ok()) {
-        std::cerr << "Failed to get last block: " << status.ToString() << std::endl; 
+        std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
         exit(1);
     }
-    unique_ptr<Block> last_block(Block::from_json(block_bytes));
-    return last_block->height;
+    size_t pruned = unconnected_headers.size();
+    unconnected_headers.clear();
+    return pruned;
+}
+
+// 校验区块与已保存的区块头一致, 并且高度接在父区块之后
+bool Blockchain::check_header(Block* block) {
+    BlockHeader stored;
+    if (get_header(block->hash, stored) && !stored.matches(block->header())) {
+        return false;
+    }
+    if (block->pre_block_hash.is_null()) {
+        return block->height == 0;
+    }
+    BlockHeader parent;
+    return get_header(block->pre_block_hash, parent) && block->height == parent.height + 1;
+}
+
+// 本地是否已有区块
+bool Blockchain::has_block(const Hash256& block_hash) {
+    if (block_hash.is_null()) {
+        return false;
+    }
+    PinnableSlice pinned;
+    return db->Get(ReadOptions(), db->DefaultColumnFamily(), block_hash.raw(), &pinned).ok();
+}
+
+// 将 JSON 格式的区块迁移为二进制格式
+int Blockchain::migrate() {
+    int migrated = 0;
+    WriteBatch batch;
+    unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        // 区块以哈希为键, 值以 '{' 开头的是 JSON 格式
+        rocksdb::Slice value = it->value();
+        if (it->key().size() != Hash256::SIZE || value.empty() || value[0] != '{') {
+            continue;
+        }
+        unique_ptr<Block> block(Block::from_json(value.ToString()));
+        if (block == nullptr || block->hash.raw() != it->key().ToString()) {
+            continue;
+        }
+        batch.Put(it->key(), block->serialize());
+        migrated++;
+    }
+    Status status = db->Write(WriteOptions(), &batch);
+    if (!status.ok()) {
+        std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
+        exit(1);
+    }
+    return migrated;
+}
+
+// 根据区块高度查找区块
+shared_ptr<Block> Blockchain::get_block_by_height(long height) {
+    return get_block(get_block_hash(height));
+}
+
+// 根据区块高度查找主链上的区块哈希
+Hash256 Blockchain::get_block_hash(long height) {
+    string block_hash;
+    Status status = db->Get(ReadOptions(), height_key(height), &block_hash);
+    if (!status.ok() || block_hash.size() != Hash256::SIZE) {
+        return Hash256();
+    }
+    return Hash256::from_raw(block_hash.data());
+}
+
+// 查询链中的区块列表(从最新区块到创世区块)
+vector<Hash256> Blockchain::get_block_hashes() {
+    vector<Hash256> blocks = get_block_hashes(0, tip_height);
+    std::reverse(blocks.begin(), blocks.end());
+    return blocks; 
+}
+
+// 查询高度区间 [from, to] 内的区块哈希(按高度升序)
+vector<Hash256> Blockchain::get_block_hashes(long from, long to) {
+    vector<Hash256> blocks;
+    if (from > to) {
+        return blocks;
+    }
+    string end_key = height_key(to);
+    unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
+    for (it->Seek(height_key(from)); it->Valid() && it->key().starts_with(heightIndexPrefix); it->Next()) {
+        if (it->key().compare(end_key) > 0) {
+            break;
+        }
+        if (it->value().size() == Hash256::SIZE) {
+            blocks.push_back(Hash256::from_raw(it->value().data()));
+        }
+    }
+    return blocks;
+}
+
+// 获取最新区块的高度
+long Blockchain::get_last_height() {
+    return tip_height;
+}
+
+// 获取最新区块的哈希
+Hash256 Blockchain::get_tip_hash() {
+    return tip;
+}
+
+// 获取主链的累计工作量
+long Blockchain::get_tip_work() {
+    return tip_work;
 }
 
 // 区块链迭代器
 BlockchainIterator* Blockchain::iterator() {
-    return new BlockchainIterator(this->db, this->tip);
+    return new BlockchainIterator(this->db, this->block_cache.get(), this->tip);
+}
+
+// 区块缓存统计
+BlockCacheStats Blockchain::block_cache_stats() {
+    return block_cache->stats();
 }
 
 // 析构函数
@@ -322,24 +752,73 @@ Blockchain::~Blockchain() {
 }
 
 // 迭代器
-BlockchainIterator::BlockchainIterator(DB* db, string tip) {
+BlockchainIterator::BlockchainIterator(DB* db, BlockCache* cache, const Hash256& tip) {
     this->db = db;
+    this->cache = cache;
     this->current_block_hash = tip;
 }
 
 // 下一个区块
-Block* BlockchainIterator::next() {
-    if (current_block_hash == "") {
+shared_ptr<Block> BlockchainIterator::next() {
+    if (current_block_hash.is_null()) {
         return nullptr;
     }
-    string block_str;
-    Status status = db->Get(ReadOptions(), current_block_hash, &block_str);
-    if (!status.ok()) {
-        return nullptr;
+    shared_ptr<Block> block = cache->get(current_block_hash);
+    if (block == nullptr) {
+        PinnableSlice pinned;
+        Status status = db->Get(ReadOptions(), db->DefaultColumnFamily(), current_block_hash.raw(), &pinned);
+        if (!status.ok()) {
+            return nullptr;
+        }
+        // 反序列化
+        block.reset(Block::parse(pinned.data(), pinned.size()));
+        if (block == nullptr) {
+            return nullptr;
+        }
     }
-    // 反序列化
-    Block *block = Block::from_json(block_str);
     current_block_hash = block->pre_block_hash;
     return block;
 }
 
+// 下一个区块的只读视图
+bool BlockchainIterator::next(PinnableSlice& pinned, BlockView& view) {
+    if (current_block_hash.is_null()) {
+        return false;
+    }
+    pinned.Reset();
+    Status status = db->Get(ReadOptions(), db->DefaultColumnFamily(), current_block_hash.raw(), &pinned);
+    if (!status.ok() || !view.parse(pinned.data(), pinned.size())) {
+        return false;
+    }
+    current_block_hash = view.header().pre_block_hash;
+    return true;
+}
+
+// 交易索引键
+string tx_index_key(const Hash256& txid) {
+    return txIndexPrefix + txid.raw();
+}
+
+// 将区块中的交易写入索引, value 为 区块哈希(32) | 交易位置(varint)
+void index_transactions(WriteBatch& batch, Block* block) {
+    for (size_t pos = 0; pos < block->transactions.size(); pos++) {
+        Encoder enc;
+        block->hash.encode(enc);
+        enc.put_varint(pos);
+        batch.Put(tx_index_key(block->transactions[pos]->id), enc.data());
+    }
+}
+
+// 高度索引键, 高度按大端序编码以保证键的顺序与高度一致
+string height_key(long height) {
+    string key = heightIndexPrefix;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        key.push_back(static_cast<char>((static_cast<uint64_t>(height) >> shift) & 0xff));
+    }
+    return key;
+}
+
+// 区块头键
+string header_key(const Hash256& block_hash) {
+    return headerPrefix + block_hash.raw();
+}
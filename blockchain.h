@@ -1,26 +1,38 @@
 #pragma once
 
+#include <set>
 #include <rocksdb/db.h>
 #include "transaction.h"
 #include "block.h"
+#include "block_cache.h"
 
 using ROCKSDB_NAMESPACE::DB;
+using ROCKSDB_NAMESPACE::PinnableSlice;
+using ROCKSDB_NAMESPACE::WriteBatch;
+
+// 尚未收到区块体的区块头数上限, 限制区块头同步领先区块下载的距离, 以及伪造区块头占用的空间
+const size_t MAX_UNCONNECTED_HEADERS = 2000;
 
 // 迭代器
+// 从最新区块向前遍历整条链, 只查询区块缓存而不填充, 以免一次遍历把靠近链尾的热点区块全部淘汰
 class BlockchainIterator {
 public:
-    BlockchainIterator(DB* db, string tip);
-    Block* next();
+    BlockchainIterator(DB* db, BlockCache* cache, const Hash256& tip);
+    shared_ptr<Block> next();
+
+    // 下一个区块的只读视图, 区块数据固定在 pinned 中, 到达创世区块之前或读取失败时返回 false
+    bool next(PinnableSlice& pinned, BlockView& view);
 private:
     DB* db;
-    string current_block_hash;
+    BlockCache* cache;
+    Hash256 current_block_hash;
 };
 
 // 区块链
 class Blockchain {
 public:
     // 构造函数
-    Blockchain(DB* db, string tip);
+    Blockchain(DB* db, const Hash256& tip);
 
     // 析构函数
     ~Blockchain();
@@ -38,34 +50,106 @@ public:
     void add_block(Block* block);
 
     // 找到足够的未花费输出
-    pair<int, map<string, vector<int>>> find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount);
+    pair<int, map<Hash256, vector<int>>> find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount);
 
     // 找到未花费支出的交易
     vector<Transaction*> find_unspent_transactions(vector<unsigned char> pub_key_hash);
 
-    // 查找所有未花费的交易输出 k -> txid, v -> vector<TXOutput>
-    map<string, vector<TXOutput>> find_utxo();
+    // 查找所有未花费的交易输出 k -> (txid, vout), v -> TXOutput
+    map<OutPoint, TXOutput> find_utxo();
 
     // 找到未花费支出的交易输出
     vector<TXOutput> find_utxo(vector<unsigned char> pub_key_hash);
 
     // 从区块链中查找交易
-    Transaction* find_transaction(string txid);
+    Transaction* find_transaction(const Hash256& txid);
+
+    // 重建区块索引
+    void reindex();
+
+    // 将 JSON 格式的区块迁移为二进制格式, 返回迁移的区块数量
+    int migrate();
+
+    // 根据区块哈希查找区块, 先查询区块缓存, 未命中时从数据库读取并加入缓存.
+    // 返回的区块可能被其他线程共享, 调用方不能修改
+    shared_ptr<Block> get_block(const Hash256& block_hash);
+
+    // 根据区块哈希读取区块的只读视图, 只解析区块头, 交易按需解码.
+    // 区块数据固定在 pinned 中, 不拷贝, 使用视图期间 pinned 必须有效
+    bool get_block_view(const Hash256& block_hash, PinnableSlice& pinned, BlockView& view);
+
+    // 本地是否已有区块(只读取数据库, 不解析区块)
+    bool has_block(const Hash256& block_hash);
+
+    // 根据区块哈希查找区块头
+    bool get_header(const Hash256& block_hash, BlockHeader& header);
+
+    // 查询主链上从高度 from 开始的至多 max_count 个区块头(按高度升序)
+    vector<BlockHeader> get_headers(long from, size_t max_count);
+
+    // 区块定位器, 用于让对方找到双方主链的分叉点
+    vector<Hash256> get_locator();
+
+    // 定位器中第一个位于本地主链上的区块高度, 都不在主链上时返回 -1
+    long find_fork_height(const vector<Hash256>& locator);
+
+    // 校验并保存一段连续的区块头: 由字段重新计算哈希(需要携带交易 ID), 检查链接关系和高度.
+    // 校验失败, 或尚未收到区块体的区块头将超过 MAX_UNCONNECTED_HEADERS 时不保存任何区块头
+    bool add_headers(const vector<BlockHeader>& headers);
 
-    // 根据区块哈希查找区块
-    Block* get_block(string block_hash);
+    // 尚未收到区块体的区块头数
+    size_t unconnected_header_count();
 
-    // 查询链中的区块列表
-    vector<string> get_block_hashes();
+    // 删除尚未收到区块体的区块头(下载放弃后不会再接入), 返回删除的数量
+    size_t prune_headers();
+
+    // 校验区块与已保存的区块头一致(哈希, 父区块, 高度, 时间戳和随机数), 并且高度接在父区块之后.
+    // 区块哈希由调用方用 ProofOfWork::validate 校验
+    bool check_header(Block* block);
+
+    // 根据区块高度查找区块
+    shared_ptr<Block> get_block_by_height(long height);
+
+    // 根据区块高度查找主链上的区块哈希, 不存在时返回空哈希
+    Hash256 get_block_hash(long height);
+
+    // 查询链中的区块列表(从最新区块到创世区块)
+    vector<Hash256> get_block_hashes();
+
+    // 查询高度区间 [from, to] 内的区块哈希(按高度升序)
+    vector<Hash256> get_block_hashes(long from, long to);
 
     // 获取最新区块的高度
     long get_last_height();
 
+    // 获取最新区块的哈希
+    Hash256 get_tip_hash();
+
+    // 获取主链的累计工作量
+    long get_tip_work();
+
     // 区块链迭代器
     BlockchainIterator* iterator();
 
+    // 区块缓存统计
+    BlockCacheStats block_cache_stats();
+
 private:
     DB* db;
-    string tip; 
+    unique_ptr<BlockCache> block_cache; // 解码后的区块, 内存上限取自配置
+    Hash256 tip;
+    long tip_height; // 最新区块高度
+    long tip_work; // 累计工作量
+    set<Hash256> unconnected_headers; // 本次运行中保存的, 尚未收到区块体的区块头
+
+    // 从元数据中加载 tip
+    bool load_tip_meta();
+
+    // 升级旧版本的区块数据: 以 16 进制哈希为键的区块改用 32 字节原始哈希为键, 并重建索引.
+    // 没有旧数据时返回 false
+    bool upgrade();
+
+    // 更新 tip, 同时写入元数据, 并把高度索引改写为新 tip 所在的分支
+    void set_tip(WriteBatch& batch, Block* block);
 };
 
@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include "blockchain.h"
+#include "proofofwork.h"
+#include "signature_verifier.h"
+#include "util.h"
+#include "wallet.h"
+
+// 在单独的数据库中创建只有创世区块的区块链
+static Blockchain* open_blockchain(const string& name, Block* genesis) {
+    string path = "./data/test_" + name;
+    rocksdb::DestroyDB(path, rocksdb::Options());
+    EXPECT_TRUE(create_directory(path));
+    DB* db;
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    EXPECT_TRUE(DB::Open(options, path, &db).ok());
+    Blockchain* bc = new Blockchain(db, Hash256());
+    bc->add_block(genesis);
+    return bc;
+}
+
+// 挖一个接在 parent 之后的区块
+static Block* mine_after(Block* parent, Wallet* wallet) {
+    return new_block(parent->hash, vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, parent->height + 1);
+}
+
+TEST(BlockchainTests, add_headers) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> source(open_blockchain("headers_source", genesis.get()));
+    unique_ptr<Blockchain> bc(open_blockchain("headers", genesis.get()));
+    vector<unique_ptr<Block>> blocks;
+    Block* parent = genesis.get();
+    for (int i = 0; i < 3; i++) {
+        blocks.emplace_back(mine_after(parent, wallet.get()));
+        parent = blocks.back().get();
+        source->add_block(parent);
+    }
+
+    // 区块头带交易 ID, 可以由字段重新计算哈希
+    vector<BlockHeader> headers = source->get_headers(1, 10);
+    ASSERT_EQ(headers.size(), 3);
+    for (size_t i = 0; i < headers.size(); i++) {
+        EXPECT_EQ(headers[i].hash, blocks[i]->hash);
+        ASSERT_EQ(headers[i].tx_ids.size(), 1);
+        EXPECT_EQ(headers[i].tx_ids[0], blocks[i]->transactions[0]->id);
+        EXPECT_TRUE(validate_header(headers[i]));
+    }
+
+    // 篡改任一参与哈希计算的字段, 或者高度接不上父区块, 整批区块头都被拒绝
+    vector<vector<BlockHeader>> forged(5, headers);
+    forged[0][1].timestamp++;
+    forged[1][1].nonce++;
+    forged[2][1].tx_ids.clear();
+    forged[3][1].pre_block_hash = genesis->hash;
+    forged[4][1].height = 5;
+    for (auto& batch : forged) {
+        EXPECT_FALSE(bc->add_headers(batch));
+    }
+    BlockHeader header;
+    EXPECT_FALSE(bc->get_header(headers[0].hash, header));
+    EXPECT_EQ(bc->unconnected_header_count(), 0);
+
+    ASSERT_TRUE(bc->add_headers(headers));
+    EXPECT_EQ(bc->unconnected_header_count(), 3);
+    ASSERT_TRUE(bc->get_header(headers[2].hash, header));
+    EXPECT_EQ(header.height, 3);
+
+    // 区块体必须与保存的区块头一致
+    EXPECT_TRUE(bc->check_header(blocks[0].get()));
+    blocks[0]->height = 2;
+    EXPECT_FALSE(bc->check_header(blocks[0].get()));
+    blocks[0]->height = 1;
+    bc->add_block(blocks[0].get());
+    EXPECT_EQ(bc->unconnected_header_count(), 2);
+
+    // 删除仍然没有区块体的区块头
+    EXPECT_EQ(bc->prune_headers(), 2);
+    EXPECT_TRUE(bc->get_header(headers[0].hash, header));
+    EXPECT_FALSE(bc->get_header(headers[1].hash, header));
+    EXPECT_FALSE(bc->check_header(blocks[2].get()));
+}
+
+TEST(BlockchainTests, locator_and_fork) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> bc(open_blockchain("locator", genesis.get()));
+    vector<unique_ptr<Block>> blocks;
+    Block* parent = genesis.get();
+    for (int i = 0; i < 14; i++) {
+        blocks.emplace_back(mine_after(parent, wallet.get()));
+        parent = blocks.back().get();
+        bc->add_block(parent);
+    }
+
+    // 前 10 个是链尾开始的连续区块, 之后间隔翻倍, 最后是创世区块
+    vector<Hash256> locator = bc->get_locator();
+    vector<long> heights;
+    for (auto& hash : locator) {
+        BlockHeader header;
+        ASSERT_TRUE(bc->get_header(hash, header));
+        heights.push_back(header.height);
+    }
+    EXPECT_EQ(heights, (vector<long>{14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 3, 0}));
+    EXPECT_EQ(bc->find_fork_height(locator), 14);
+
+    // 分叉区块不在主链上, 跳过它找到主链上的区块; 未知的区块同样跳过
+    unique_ptr<Block> fork(mine_after(blocks[3].get(), wallet.get()));
+    bc->add_block(fork.get());
+    EXPECT_EQ(bc->get_last_height(), 14);
+    EXPECT_EQ(bc->find_fork_height({Hash256::sha256(string("unknown")), fork->hash, blocks[2]->hash}), 3);
+    EXPECT_EQ(bc->find_fork_height({fork->hash}), -1);
+    EXPECT_EQ(bc->find_fork_height({}), -1);
+}
+
+TEST(BlockchainTests, reorg_height_index) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> bc(open_blockchain("reorg", genesis.get()));
+    // 主链 a1 <- a2 <- a3, 分叉 a1 <- b2 <- b3 <- b4
+    vector<unique_ptr<Block>> a, b;
+    a.emplace_back(mine_after(genesis.get(), wallet.get()));
+    a.emplace_back(mine_after(a[0].get(), wallet.get()));
+    a.emplace_back(mine_after(a[1].get(), wallet.get()));
+    b.emplace_back(mine_after(a[0].get(), wallet.get()));
+    b.emplace_back(mine_after(b[0].get(), wallet.get()));
+    b.emplace_back(mine_after(b[1].get(), wallet.get()));
+    for (auto& block : a) {
+        bc->add_block(block.get());
+    }
+    bc->add_block(b[0].get());
+    bc->add_block(b[1].get());
+    // 分叉没有超过主链时高度索引不变
+    EXPECT_EQ(bc->get_tip_hash(), a[2]->hash);
+    EXPECT_EQ(bc->get_block_hash(2), a[1]->hash);
+
+    // 分叉变长后, 每个高度都指向分叉上的区块
+    bc->add_block(b[2].get());
+    EXPECT_EQ(bc->get_tip_hash(), b[2]->hash);
+    EXPECT_EQ(bc->get_block_hashes(0, 4), (vector<Hash256>{genesis->hash, a[0]->hash, b[0]->hash, b[1]->hash, b[2]->hash}));
+    EXPECT_EQ(bc->get_block_by_height(3)->hash, b[1]->hash);
+
+    // 原来的主链再次变长, 切换回来
+    a.emplace_back(mine_after(a[2].get(), wallet.get()));
+    a.emplace_back(mine_after(a[3].get(), wallet.get()));
+    bc->add_block(a[3].get());
+    EXPECT_EQ(bc->get_tip_hash(), b[2]->hash);
+    bc->add_block(a[4].get());
+    EXPECT_EQ(bc->get_tip_hash(), a[4]->hash);
+    EXPECT_EQ(bc->get_block_hashes(0, 5), (vector<Hash256>{genesis->hash, a[0]->hash, a[1]->hash, a[2]->hash, a[3]->hash, a[4]->hash}));
+}
+
+TEST(BlockchainTests, headers_after_reorg) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> bc(open_blockchain("headers_reorg", genesis.get()));
+    // 主链 a1 <- a2 <- a3 <- a4, 分叉 a2 <- b3 <- b4 <- b5 切换为主链
+    vector<unique_ptr<Block>> a, b;
+    Block* parent = genesis.get();
+    for (int i = 0; i < 4; i++) {
+        a.emplace_back(mine_after(parent, wallet.get()));
+        parent = a.back().get();
+        bc->add_block(parent);
+    }
+    vector<Hash256> old_locator = bc->get_locator();
+    parent = a[1].get();
+    for (int i = 0; i < 3; i++) {
+        b.emplace_back(mine_after(parent, wallet.get()));
+        parent = b.back().get();
+        bc->add_block(parent);
+    }
+    ASSERT_EQ(bc->get_tip_hash(), b[2]->hash);
+
+    // 区块头和定位器只包含新主链上的区块
+    vector<BlockHeader> headers = bc->get_headers(1, 10);
+    vector<Hash256> expected{a[0]->hash, a[1]->hash, b[0]->hash, b[1]->hash, b[2]->hash};
+    ASSERT_EQ(headers.size(), expected.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        EXPECT_EQ(headers[i].hash, expected[i]);
+    }
+    EXPECT_EQ(bc->get_locator(), (vector<Hash256>{b[2]->hash, b[1]->hash, b[0]->hash, a[1]->hash, a[0]->hash, genesis->hash}));
+
+    // 对方可以接受这些区块头; 旧分支的定位器回到分叉点
+    unique_ptr<Blockchain> peer(open_blockchain("headers_reorg_peer", genesis.get()));
+    EXPECT_TRUE(peer->add_headers(headers));
+    EXPECT_EQ(bc->find_fork_height(old_locator), 2);
+}
+
+TEST(BlockchainTests, in_block_spends) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> bc(open_blockchain("in_block_spends", genesis.get()));
+
+    // 交易池中的子交易和父交易进入同一个区块, 子交易排在父交易之后
+    Transaction* parent = new Transaction();
+    parent->vin.push_back(TXInput{genesis->transactions[0]->id, 0, {}, wallet->get_public_key()});
+    parent->vout.push_back(TXOutput(4, wallet->get_address()));
+    parent->vout.push_back(TXOutput(6, wallet->get_address()));
+    parent->id = parent->hash();
+    Transaction* child = new Transaction();
+    child->vin.push_back(TXInput{parent->id, 1, {}, wallet->get_public_key()});
+    child->vout.push_back(TXOutput(6, wallet->get_address()));
+    child->id = child->hash();
+    for (auto tx : {parent, child}) {
+        auto message = tx->signature_message();
+        for (auto& vin : tx->vin) {
+            auto signature = ecdsa_p256_sha256_sign_digest(wallet->ec_key, message);
+            vin.signature.assign(signature.begin(), signature.end());
+        }
+    }
+
+    // 父交易尚未上链时, 单独验证子交易失败而不是退出进程
+    SignatureVerifier verifier(0, nullptr, nullptr);
+    EXPECT_FALSE(verifier.verify({child}, bc.get()).ok);
+    EXPECT_TRUE(verifier.verify({parent, child}, bc.get()).ok);
+
+    unique_ptr<Block> block(new_block(genesis->hash, vector<Transaction*>{parent, child}, 1));
+    bc->add_block(block.get());
+    map<OutPoint, TXOutput> utxo = bc->find_utxo();
+    EXPECT_EQ(utxo.size(), 2);
+    EXPECT_EQ(utxo.count(OutPoint{genesis->transactions[0]->id, 0}), 0);
+    EXPECT_EQ(utxo.count(OutPoint{parent->id, 0}), 1);
+    EXPECT_EQ(utxo.count(OutPoint{parent->id, 1}), 0);
+    EXPECT_EQ(utxo.count(OutPoint{child->id, 0}), 1);
+}
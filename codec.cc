@@ -0,0 +1,161 @@
+#include "codec.h"
+
+// 写入单字节
+void Encoder::put_u8(uint8_t v) {
+    buf.push_back(static_cast<char>(v));
+}
+
+// 写入 4 字节整数
+void Encoder::put_u32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        buf.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+}
+
+// 写入 8 字节整数
+void Encoder::put_u64(uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        buf.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+}
+
+// 写入变长整数(LEB128), 每字节低 7 位为数据, 最高位表示是否还有后续字节
+void Encoder::put_varint(uint64_t v) {
+    while (v >= 0x80) {
+        buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+}
+
+// 写入带长度前缀的字节数组
+void Encoder::put_bytes(ByteSpan bytes) {
+    put_varint(bytes.size());
+    buf.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+// 写入带长度前缀的字符串
+void Encoder::put_string(const string& str) {
+    put_varint(str.size());
+    buf.append(str);
+}
+
+// 写入原始字节
+void Encoder::put_raw(const void* data, size_t size) {
+    buf.append(static_cast<const char*>(data), size);
+}
+
+// 编码结果
+string& Encoder::data() {
+    return buf;
+}
+
+Decoder::Decoder(const char* data, size_t size) {
+    this->ptr = data;
+    this->end = data + size;
+}
+
+Decoder::Decoder(const string& data) : Decoder(data.data(), data.size()) {}
+
+// 读取单字节
+bool Decoder::get_u8(uint8_t& v) {
+    if (remaining() < 1) {
+        return false;
+    }
+    v = static_cast<uint8_t>(*ptr++);
+    return true;
+}
+
+// 读取 4 字节整数
+bool Decoder::get_u32(uint32_t& v) {
+    if (remaining() < 4) {
+        return false;
+    }
+    v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= static_cast<uint32_t>(static_cast<uint8_t>(ptr[i])) << (8 * i);
+    }
+    ptr += 4;
+    return true;
+}
+
+// 读取 8 字节整数
+bool Decoder::get_u64(uint64_t& v) {
+    if (remaining() < 8) {
+        return false;
+    }
+    v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= static_cast<uint64_t>(static_cast<uint8_t>(ptr[i])) << (8 * i);
+    }
+    ptr += 8;
+    return true;
+}
+
+// 读取变长整数(LEB128)
+bool Decoder::get_varint(uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (ptr >= end) {
+            return false;
+        }
+        uint8_t byte = static_cast<uint8_t>(*ptr++);
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 读取带长度前缀的字节数组
+bool Decoder::get_bytes(vector<unsigned char>& bytes) {
+    uint64_t size;
+    if (!get_varint(size) || remaining() < size) {
+        return false;
+    }
+    bytes.assign(ptr, ptr + size);
+    ptr += size;
+    return true;
+}
+
+// 读取带长度前缀的字节数组, 使用 bytes 自身的内存来源
+bool Decoder::get_bytes(Bytes& bytes) {
+    uint64_t size;
+    if (!get_varint(size) || remaining() < size) {
+        return false;
+    }
+    bytes.assign(ptr, ptr + size);
+    ptr += size;
+    return true;
+}
+
+// 读取带长度前缀的字符串
+bool Decoder::get_string(string& str) {
+    uint64_t size;
+    if (!get_varint(size) || remaining() < size) {
+        return false;
+    }
+    str.assign(ptr, size);
+    ptr += size;
+    return true;
+}
+
+// 跳过若干字节
+bool Decoder::skip(size_t size) {
+    if (remaining() < size) {
+        return false;
+    }
+    ptr += size;
+    return true;
+}
+
+// 当前读取位置
+const char* Decoder::position() {
+    return ptr;
+}
+
+// 剩余字节数
+size_t Decoder::remaining() {
+    return end - ptr;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 交易中的字节数组, 可以指定内存来源(解码区块时使用区块的 arena), 默认使用堆内存
+typedef std::pmr::vector<unsigned char> Bytes;
+
+// 字节数组的只读视图, 可由 vector 和 Bytes 隐式构造, 传参时不拷贝数据
+class ByteSpan {
+public:
+    ByteSpan() : ptr(nullptr), len(0) {}
+    ByteSpan(const unsigned char* data, size_t size) : ptr(data), len(size) {}
+    ByteSpan(const vector<unsigned char>& bytes) : ptr(bytes.data()), len(bytes.size()) {}
+    ByteSpan(const Bytes& bytes) : ptr(bytes.data()), len(bytes.size()) {}
+
+    const unsigned char* data() const { return ptr; }
+    size_t size() const { return len; }
+    const unsigned char* begin() const { return ptr; }
+    const unsigned char* end() const { return ptr + len; }
+
+private:
+    const unsigned char* ptr;
+    size_t len;
+};
+
+// 二进制编码器, 整数按小端序写入, 变长数据带长度前缀
+class Encoder {
+public:
+    // 写入单字节
+    void put_u8(uint8_t v);
+
+    // 写入 4 字节整数
+    void put_u32(uint32_t v);
+
+    // 写入 8 字节整数
+    void put_u64(uint64_t v);
+
+    // 写入变长整数(LEB128)
+    void put_varint(uint64_t v);
+
+    // 写入带长度前缀的字节数组
+    void put_bytes(ByteSpan bytes);
+
+    // 写入带长度前缀的字符串
+    void put_string(const string& str);
+
+    // 写入原始字节
+    void put_raw(const void* data, size_t size);
+
+    // 编码结果
+    string& data();
+
+private:
+    string buf;
+};
+
+// 二进制解码器, 越界或格式错误时返回 false
+class Decoder {
+public:
+    Decoder(const char* data, size_t size);
+
+    Decoder(const string& data);
+
+    // 读取单字节
+    bool get_u8(uint8_t& v);
+
+    // 读取 4 字节整数
+    bool get_u32(uint32_t& v);
+
+    // 读取 8 字节整数
+    bool get_u64(uint64_t& v);
+
+    // 读取变长整数(LEB128)
+    bool get_varint(uint64_t& v);
+
+    // 读取带长度前缀的字节数组
+    bool get_bytes(vector<unsigned char>& bytes);
+
+    // 读取带长度前缀的字节数组, 使用 bytes 自身的内存来源
+    bool get_bytes(Bytes& bytes);
+
+    // 读取带长度前缀的字符串
+    bool get_string(string& str);
+
+    // 跳过若干字节
+    bool skip(size_t size);
+
+    // 当前读取位置
+    const char* position();
+
+    // 剩余字节数
+    size_t remaining();
+
+private:
+    const char* ptr;
+    const char* end;
+};
@@ -0,0 +1,111 @@
+#include "coins_cache.h"
+
+CoinsCache::CoinsCache(FetchFn fetch)
+    : fetch(fetch), dirty_count(0), total_usage(0), hit_count(0), miss_count(0) {}
+
+// 查找输出, 缓存中没有时从数据库读取
+unordered_map<OutPoint, CoinsCache::Entry, OutPointHash>::iterator CoinsCache::fetch_entry(const OutPoint& outpoint) {
+    auto it = entries.find(outpoint);
+    if (it != entries.end()) {
+        hit_count++;
+        return it;
+    }
+    miss_count++;
+    TXOutput txout;
+    if (!fetch(outpoint, txout)) {
+        return entries.end();
+    }
+    total_usage += entry_usage(txout);
+    return entries.emplace(outpoint, Entry{txout, false, false, false}).first;
+}
+
+// 查询未花费的输出
+bool CoinsCache::get(const OutPoint& outpoint, TXOutput& txout) {
+    auto it = fetch_entry(outpoint);
+    if (it == entries.end() || it->second.spent) {
+        return false;
+    }
+    txout = it->second.txout;
+    return true;
+}
+
+// 新增输出
+void CoinsCache::add(const OutPoint& outpoint, const TXOutput& txout, bool fresh) {
+    auto it = entries.find(outpoint);
+    if (it == entries.end()) {
+        total_usage += entry_usage(txout);
+        entries.emplace(outpoint, Entry{txout, false, true, fresh});
+        dirty_count++;
+        return;
+    }
+    // 已花费尚未写回的输出被恢复(断开区块), 数据库中是否存在保持原来的判断
+    Entry& entry = it->second;
+    total_usage -= entry_usage(entry.txout);
+    total_usage += entry_usage(txout);
+    entry.txout = txout;
+    entry.spent = false;
+    if (!entry.dirty) {
+        entry.dirty = true;
+        dirty_count++;
+    }
+}
+
+// 花费输出
+bool CoinsCache::spend(const OutPoint& outpoint, TXOutput& txout) {
+    auto it = fetch_entry(outpoint);
+    if (it == entries.end() || it->second.spent) {
+        return false;
+    }
+    Entry& entry = it->second;
+    txout = entry.txout;
+    if (entry.fresh) {
+        // 数据库中没有, 直接删除
+        if (entry.dirty) {
+            dirty_count--;
+        }
+        total_usage -= entry_usage(entry.txout);
+        entries.erase(it);
+        return true;
+    }
+    // 保留输出内容, 写回时需要公钥哈希删除地址索引
+    entry.spent = true;
+    if (!entry.dirty) {
+        entry.dirty = true;
+        dirty_count++;
+    }
+    return true;
+}
+
+// 写回修改过的输出, 然后清空缓存
+void CoinsCache::flush(WriteFn write) {
+    for (auto& kv : entries) {
+        if (kv.second.dirty) {
+            write(kv.first, kv.second.txout, kv.second.spent);
+        }
+    }
+    clear();
+}
+
+// 丢弃缓存中的全部内容
+void CoinsCache::clear() {
+    entries.clear();
+    dirty_count = 0;
+    total_usage = 0;
+}
+
+// 估算的内存占用
+size_t CoinsCache::usage() {
+    return total_usage;
+}
+
+// 缓存统计
+CoinsCacheStats CoinsCache::stats() {
+    return CoinsCacheStats{hit_count, miss_count, entries.size(), dirty_count, total_usage};
+}
+
+// 估算一个输出的内存占用
+size_t CoinsCache::entry_usage(const TXOutput& txout) {
+    // 哈希表节点的额外开销
+    const size_t hash_node = 24;
+    return hash_node + sizeof(OutPoint) + sizeof(Entry) + txout.pub_key_hash.size();
+}
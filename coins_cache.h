@@ -0,0 +1,80 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include "transaction.h"
+
+using namespace std;
+
+// 未花费输出缓存统计
+struct CoinsCacheStats {
+    uint64_t hits; // 命中次数
+    uint64_t misses; // 未命中, 需要读取数据库的次数
+    size_t count; // 缓存的输出数(含已花费尚未写回的)
+    size_t dirty; // 修改过尚未写回的输出数
+    size_t usage; // 估算的内存占用(字节)
+};
+
+// 默认的未花费输出缓存内存上限
+const size_t DEFAULT_COINS_CACHE_SIZE = 64 * 1024 * 1024;
+
+// 未花费输出的写回缓存, 位于 chainstate 数据库之前
+// 连接和断开区块时新增和花费的输出只修改缓存, 写回时一次性交给调用方写入数据库.
+// 缓存中新增、尚未写回数据库的输出(fresh)被花费时直接删除, 数据库完全不需要知道它存在过.
+// 不是线程安全的, 由 UTXOSet 的调用方加锁
+class CoinsCache {
+public:
+    // 从数据库读取输出, 不存在时返回 false
+    typedef std::function<bool(const OutPoint&, TXOutput&)> FetchFn;
+
+    // 写回一个修改过的输出, spent 为 true 时从数据库删除
+    typedef std::function<void(const OutPoint&, const TXOutput&, bool spent)> WriteFn;
+
+    CoinsCache(FetchFn fetch);
+
+    CoinsCache(const CoinsCache&) = delete;
+    CoinsCache& operator=(const CoinsCache&) = delete;
+
+    // 查询未花费的输出, 不存在或已花费时返回 false
+    bool get(const OutPoint& outpoint, TXOutput& txout);
+
+    // 新增输出. fresh 表示输出一定不在数据库中(新交易的输出), 之后在写回前被花费时不需要写数据库
+    void add(const OutPoint& outpoint, const TXOutput& txout, bool fresh);
+
+    // 花费输出, txout 返回被花费的输出, 不存在或已花费时返回 false
+    bool spend(const OutPoint& outpoint, TXOutput& txout);
+
+    // 把修改过的输出交给 write 写回, 然后清空缓存
+    void flush(WriteFn write);
+
+    // 丢弃缓存中的全部内容, 包括尚未写回的修改
+    void clear();
+
+    // 估算的内存占用
+    size_t usage();
+
+    // 缓存统计
+    CoinsCacheStats stats();
+
+private:
+    // 缓存中的输出
+    struct Entry {
+        TXOutput txout;
+        bool spent; // 已花费, 写回时从数据库删除
+        bool dirty; // 与数据库不一致, 需要写回
+        bool fresh; // 数据库中没有该输出
+    };
+
+    FetchFn fetch;
+    unordered_map<OutPoint, Entry, OutPointHash> entries;
+    size_t dirty_count;
+    size_t total_usage;
+    uint64_t hit_count;
+    uint64_t miss_count;
+
+    // 查找输出, 缓存中没有时从数据库读取并加入缓存, 都没有时返回 end()
+    unordered_map<OutPoint, Entry, OutPointHash>::iterator fetch_entry(const OutPoint& outpoint);
+
+    // 估算一个输出的内存占用
+    static size_t entry_usage(const TXOutput& txout);
+};
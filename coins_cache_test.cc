@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include "coins_cache.h"
+
+// 以 map 模拟数据库, 记录读取次数
+struct FakeCoinsDB {
+    map<OutPoint, TXOutput> outputs;
+    int reads = 0;
+
+    CoinsCache::FetchFn fetch() {
+        return [this](const OutPoint& outpoint, TXOutput& txout) {
+            reads++;
+            auto it = outputs.find(outpoint);
+            if (it == outputs.end()) {
+                return false;
+            }
+            txout = it->second;
+            return true;
+        };
+    }
+};
+
+static TXOutput make_txout(int value) {
+    vector<unsigned char> pub_key_hash(20, (unsigned char) value);
+    return TXOutput(value, pub_key_hash);
+}
+
+TEST(CoinsCacheTests, fresh_spend_skips_db) {
+    FakeCoinsDB db;
+    CoinsCache cache(db.fetch());
+    OutPoint outpoint{Hash256::sha256(string("tx")), 0};
+    cache.add(outpoint, make_txout(10), true);
+
+    TXOutput txout;
+    EXPECT_TRUE(cache.get(outpoint, txout));
+    EXPECT_EQ(txout.value, 10);
+    EXPECT_TRUE(cache.spend(outpoint, txout));
+    // 写回前花费的新输出从缓存中删除, 数据库既不读也不写
+    EXPECT_FALSE(cache.spend(outpoint, txout));
+    EXPECT_EQ(db.reads, 1);
+    EXPECT_EQ(cache.stats().count, 0);
+    EXPECT_EQ(cache.stats().dirty, 0);
+    EXPECT_EQ(cache.usage(), 0);
+
+    int writes = 0;
+    cache.flush([&writes](const OutPoint&, const TXOutput&, bool) { writes++; });
+    EXPECT_EQ(writes, 0);
+}
+
+TEST(CoinsCacheTests, flush_writes_dirty) {
+    FakeCoinsDB db;
+    OutPoint a{Hash256::sha256(string("a")), 0};
+    OutPoint b{Hash256::sha256(string("b")), 1};
+    OutPoint c{Hash256::sha256(string("c")), 0};
+    db.outputs[a] = make_txout(1);
+    db.outputs[b] = make_txout(2);
+    CoinsCache cache(db.fetch());
+
+    // a 只读取, b 被花费, c 新增
+    TXOutput txout;
+    EXPECT_TRUE(cache.get(a, txout));
+    EXPECT_TRUE(cache.get(a, txout));
+    EXPECT_TRUE(cache.spend(b, txout));
+    EXPECT_EQ(txout.value, 2);
+    EXPECT_FALSE(cache.get(b, txout));
+    cache.add(c, make_txout(3), true);
+
+    CoinsCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.count, 3);
+    EXPECT_EQ(stats.dirty, 2);
+    EXPECT_EQ(stats.hits, 2);
+    EXPECT_EQ(stats.misses, 2);
+
+    // 只写回修改过的输出, 被花费的输出带着公钥哈希交给调用方
+    cache.flush([&db, &a](const OutPoint& outpoint, const TXOutput& txout, bool spent) {
+        EXPECT_FALSE(outpoint == a);
+        if (spent) {
+            EXPECT_EQ(txout.pub_key_hash.size(), 20);
+            db.outputs.erase(outpoint);
+        } else {
+            db.outputs[outpoint] = txout;
+        }
+    });
+    EXPECT_EQ(cache.stats().count, 0);
+    EXPECT_EQ(cache.usage(), 0);
+    EXPECT_EQ(db.outputs.size(), 2);
+    EXPECT_EQ(db.outputs.count(b), 0);
+    EXPECT_EQ(db.outputs[c].value, 3);
+}
@@ -1,8 +1,33 @@
 #include <cstdlib>
+#include <thread>
+#include "block_cache.h"
+#include "coins_cache.h"
 #include "config.h"
+#include "memory_pool.h"
+#include "signature_cache.h"
 
 const string NODE_ADDRESS_KEY = "NODE_ADDRESS";
 const string MINING_ADDRESS_KEY = "MINING_ADDRESS"; 
+const string MINING_THREADS_KEY = "MINING_THREADS";
+const string WORKER_THREADS_KEY = "WORKER_THREADS";
+const string VERIFY_THREADS_KEY = "VERIFY_THREADS";
+const string NODE_TRANSPORT_KEY = "NODE_TRANSPORT";
+const string DOWNLOAD_WINDOW_KEY = "DOWNLOAD_WINDOW";
+
+const string BLOCK_MAX_BYTES_KEY = "BLOCK_MAX_BYTES";
+const string BLOCK_MAX_TXS_KEY = "BLOCK_MAX_TXS";
+const string MEMPOOL_MAX_USAGE_KEY = "MEMPOOL_MAX_USAGE";
+const string MEMPOOL_EXPIRY_KEY = "MEMPOOL_EXPIRY";
+const string SIGNATURE_CACHE_SIZE_KEY = "SIGNATURE_CACHE_SIZE";
+const string BLOCK_CACHE_SIZE_KEY = "BLOCK_CACHE_SIZE";
+const string COINS_CACHE_SIZE_KEY = "COINS_CACHE_SIZE";
+
+// 默认的区块下载窗口
+const int DEFAULT_DOWNLOAD_WINDOW = 16;
+
+// 默认的区块模板上限
+const size_t DEFAULT_BLOCK_MAX_BYTES = 1000000;
+const size_t DEFAULT_BLOCK_MAX_TXS = 2000;
 
 // 获取配置
 Config* Config::get_instance() {
@@ -34,3 +59,169 @@ bool Config::is_miner() {
     return inner.find(MINING_ADDRESS_KEY) != inner.end();
 }
 
+// 设置挖矿线程数
+void Config::set_mining_threads(int threads) {
+    inner[MINING_THREADS_KEY] = to_string(threads);
+}
+
+// 获取挖矿线程数, 默认为 CPU 核数
+int Config::get_mining_threads() {
+    if (inner.find(MINING_THREADS_KEY) != inner.end()) {
+        return std::stoi(inner[MINING_THREADS_KEY]);
+    }
+    int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+// 设置签名验证线程数
+void Config::set_verify_threads(int threads) {
+    inner[VERIFY_THREADS_KEY] = to_string(threads);
+}
+
+// 获取签名验证线程数
+int Config::get_verify_threads() {
+    if (inner.find(VERIFY_THREADS_KEY) != inner.end()) {
+        return std::stoi(inner[VERIFY_THREADS_KEY]);
+    }
+    int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+// 设置处理消息的工作线程数
+void Config::set_worker_threads(int threads) {
+    inner[WORKER_THREADS_KEY] = to_string(threads);
+}
+
+// 获取处理消息的工作线程数, 默认为 CPU 核数
+int Config::get_worker_threads() {
+    if (inner.find(WORKER_THREADS_KEY) != inner.end()) {
+        return std::stoi(inner[WORKER_THREADS_KEY]);
+    }
+    int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+// 设置传输协议
+void Config::set_transport(const string& transport) {
+    inner[NODE_TRANSPORT_KEY] = transport;
+}
+
+// 获取传输协议
+string Config::get_transport() {
+    if (inner.find(NODE_TRANSPORT_KEY) != inner.end()) {
+        return inner[NODE_TRANSPORT_KEY];
+    }
+    if (char* env_val = getenv(NODE_TRANSPORT_KEY.c_str()); env_val != nullptr) {
+        return env_val;
+    }
+    return "udp";
+}
+
+// 是否使用 TCP 传输
+bool Config::use_tcp() {
+    return get_transport() == "tcp";
+}
+
+// 设置同步时同时进行的区块请求数
+void Config::set_download_window(int window) {
+    inner[DOWNLOAD_WINDOW_KEY] = to_string(window);
+}
+
+// 获取同步时同时进行的区块请求数
+int Config::get_download_window() {
+    if (inner.find(DOWNLOAD_WINDOW_KEY) != inner.end()) {
+        return std::stoi(inner[DOWNLOAD_WINDOW_KEY]);
+    }
+    return DEFAULT_DOWNLOAD_WINDOW;
+}
+
+// 设置区块模板的最大字节数
+void Config::set_block_max_bytes(size_t max_bytes) {
+    inner[BLOCK_MAX_BYTES_KEY] = to_string(max_bytes);
+}
+
+// 获取区块模板的最大字节数
+size_t Config::get_block_max_bytes() {
+    if (inner.find(BLOCK_MAX_BYTES_KEY) != inner.end()) {
+        return std::stoul(inner[BLOCK_MAX_BYTES_KEY]);
+    }
+    return DEFAULT_BLOCK_MAX_BYTES;
+}
+
+// 设置区块模板的最大交易数
+void Config::set_block_max_txs(size_t max_txs) {
+    inner[BLOCK_MAX_TXS_KEY] = to_string(max_txs);
+}
+
+// 获取区块模板的最大交易数
+size_t Config::get_block_max_txs() {
+    if (inner.find(BLOCK_MAX_TXS_KEY) != inner.end()) {
+        return std::stoul(inner[BLOCK_MAX_TXS_KEY]);
+    }
+    return DEFAULT_BLOCK_MAX_TXS;
+}
+
+// 设置交易池的内存上限(字节)
+void Config::set_mempool_max_usage(size_t max_usage) {
+    inner[MEMPOOL_MAX_USAGE_KEY] = to_string(max_usage);
+}
+
+// 获取交易池的内存上限(字节)
+size_t Config::get_mempool_max_usage() {
+    if (inner.find(MEMPOOL_MAX_USAGE_KEY) != inner.end()) {
+        return std::stoul(inner[MEMPOOL_MAX_USAGE_KEY]);
+    }
+    return DEFAULT_MEMPOOL_MAX_USAGE;
+}
+
+// 设置交易的过期时间
+void Config::set_mempool_expiry(std::chrono::seconds expiry) {
+    inner[MEMPOOL_EXPIRY_KEY] = to_string(expiry.count());
+}
+
+// 获取交易的过期时间
+std::chrono::seconds Config::get_mempool_expiry() {
+    if (inner.find(MEMPOOL_EXPIRY_KEY) != inner.end()) {
+        return std::chrono::seconds(std::stol(inner[MEMPOOL_EXPIRY_KEY]));
+    }
+    return DEFAULT_MEMPOOL_EXPIRY;
+}
+
+// 设置签名缓存容量(条)
+void Config::set_signature_cache_size(size_t size) {
+    inner[SIGNATURE_CACHE_SIZE_KEY] = to_string(size);
+}
+
+// 获取签名缓存容量(条)
+size_t Config::get_signature_cache_size() {
+    if (inner.find(SIGNATURE_CACHE_SIZE_KEY) != inner.end()) {
+        return std::stoul(inner[SIGNATURE_CACHE_SIZE_KEY]);
+    }
+    return DEFAULT_SIGNATURE_CACHE_SIZE;
+}
+
+// 设置区块缓存的内存上限(字节)
+void Config::set_block_cache_size(size_t size) {
+    inner[BLOCK_CACHE_SIZE_KEY] = to_string(size);
+}
+
+// 获取区块缓存的内存上限(字节)
+size_t Config::get_block_cache_size() {
+    if (inner.find(BLOCK_CACHE_SIZE_KEY) != inner.end()) {
+        return std::stoul(inner[BLOCK_CACHE_SIZE_KEY]);
+    }
+    return DEFAULT_BLOCK_CACHE_SIZE;
+}
+
+// 设置未花费输出缓存的内存上限(字节)
+void Config::set_coins_cache_size(size_t size) {
+    inner[COINS_CACHE_SIZE_KEY] = to_string(size);
+}
+
+// 获取未花费输出缓存的内存上限(字节)
+size_t Config::get_coins_cache_size() {
+    if (inner.find(COINS_CACHE_SIZE_KEY) != inner.end()) {
+        return std::stoul(inner[COINS_CACHE_SIZE_KEY]);
+    }
+    return DEFAULT_COINS_CACHE_SIZE;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <map>
 #include "util.h"
 
@@ -27,6 +28,81 @@ public:
     // 是否是矿工
     bool is_miner(); 
 
+    // 设置挖矿线程数
+    void set_mining_threads(int threads);
+
+    // 获取挖矿线程数, 默认为 CPU 核数
+    int get_mining_threads();
+
+    // 设置签名验证线程数
+    void set_verify_threads(int threads);
+
+    // 获取签名验证线程数(含调用线程), 默认为 CPU 核数
+    int get_verify_threads();
+
+    // 设置处理消息的工作线程数
+    void set_worker_threads(int threads);
+
+    // 获取处理消息的工作线程数, 默认为 CPU 核数
+    int get_worker_threads();
+
+    // 设置传输协议(udp 或 tcp)
+    void set_transport(const string& transport);
+
+    // 获取传输协议, 默认读取环境变量 NODE_TRANSPORT, 未设置时为 udp
+    string get_transport();
+
+    // 是否使用 TCP 传输
+    bool use_tcp();
+
+    // 设置同步时同时进行的区块请求数
+    void set_download_window(int window);
+
+    // 获取同步时同时进行的区块请求数, 默认为 16
+    int get_download_window();
+
+    // 设置区块模板的最大字节数
+    void set_block_max_bytes(size_t max_bytes);
+
+    // 获取区块模板的最大字节数, 默认为 1 MB
+    size_t get_block_max_bytes();
+
+    // 设置区块模板的最大交易数
+    void set_block_max_txs(size_t max_txs);
+
+    // 获取区块模板的最大交易数, 默认为 2000
+    size_t get_block_max_txs();
+
+    // 设置交易池的内存上限(字节)
+    void set_mempool_max_usage(size_t max_usage);
+
+    // 获取交易池的内存上限(字节), 默认为 300 MB
+    size_t get_mempool_max_usage();
+
+    // 设置交易的过期时间
+    void set_mempool_expiry(std::chrono::seconds expiry);
+
+    // 获取交易的过期时间, 默认为 14 天
+    std::chrono::seconds get_mempool_expiry();
+
+    // 设置签名缓存容量(条), 0 表示不缓存
+    void set_signature_cache_size(size_t size);
+
+    // 获取签名缓存容量(条), 默认为 100000
+    size_t get_signature_cache_size();
+
+    // 设置区块缓存的内存上限(字节), 0 表示不缓存
+    void set_block_cache_size(size_t size);
+
+    // 获取区块缓存的内存上限(字节), 默认为 32 MB
+    size_t get_block_cache_size();
+
+    // 设置未花费输出缓存的内存上限(字节), 超过时写回数据库, 0 表示每个区块都写回
+    void set_coins_cache_size(size_t size);
+
+    // 获取未花费输出缓存的内存上限(字节), 默认为 64 MB
+    size_t get_coins_cache_size();
+
 private:
     Config() = default;
     map<string, string> inner;
@@ -0,0 +1,107 @@
+#include <openssl/sha.h>
+#include "hash256.h"
+
+// 计算 sha256 摘要
+Hash256 Hash256::sha256(const vector<unsigned char>& data) {
+    Hash256 hash;
+    SHA256(data.data(), data.size(), hash.bytes);
+    return hash;
+}
+
+// 计算字符串的 sha256 摘要
+Hash256 Hash256::sha256(const string& data) {
+    Hash256 hash;
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), hash.bytes);
+    return hash;
+}
+
+// 从 32 字节原始数据构造
+Hash256 Hash256::from_raw(const void* data) {
+    Hash256 hash;
+    memcpy(hash.bytes, data, SIZE);
+    return hash;
+}
+
+// 16 进制字符的值, 非法字符返回 -1
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// 解析 16 进制字符串
+bool Hash256::from_hex(const string& hex, Hash256& hash) {
+    if (hex == "None") {
+        hash = Hash256();
+        return true;
+    }
+    if (hex.size() != SIZE * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < SIZE; i++) {
+        int hi = hex_value(hex[2 * i]);
+        int lo = hex_value(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        hash.bytes[i] = static_cast<unsigned char>(hi << 4 | lo);
+    }
+    return true;
+}
+
+// 是否为空哈希
+bool Hash256::is_null() const {
+    for (size_t i = 0; i < SIZE; i++) {
+        if (bytes[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 16 进制字符串
+string Hash256::to_hex() const {
+    static const char digits[] = "0123456789abcdef";
+    string hex(SIZE * 2, '0');
+    for (size_t i = 0; i < SIZE; i++) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+    }
+    return hex;
+}
+
+// 文本形式
+string Hash256::to_string() const {
+    return is_null() ? "None" : to_hex();
+}
+
+// 原始字节
+string Hash256::raw() const {
+    return string(reinterpret_cast<const char*>(bytes), SIZE);
+}
+
+// 二进制编码, 固定 32 字节, 不带长度前缀
+void Hash256::encode(Encoder& enc) const {
+    enc.put_raw(bytes, SIZE);
+}
+
+// 二进制解码
+bool Hash256::decode(Decoder& dec, Hash256& hash) {
+    if (dec.remaining() < SIZE) {
+        return false;
+    }
+    memcpy(hash.bytes, dec.position(), SIZE);
+    return dec.skip(SIZE);
+}
+
+// 日志输出为文本形式
+ostream& operator<<(ostream& os, const Hash256& hash) {
+    return os << hash.to_string();
+}
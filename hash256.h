@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "codec.h"
+
+using namespace std;
+
+// 32 字节哈希(交易 ID / 区块哈希), 按原始字节存放, 可以直接拷贝和比较.
+// 全零表示空哈希: coinbase 输入引用的交易和创世区块的前一个区块, 文本形式为 "None".
+// 16 进制只出现在命令行、日志和 JSON 等对外的边界上
+struct Hash256 {
+    static const size_t SIZE = 32;
+
+    unsigned char bytes[SIZE] = {};
+
+    // 计算 sha256 摘要
+    static Hash256 sha256(const vector<unsigned char>& data);
+
+    // 计算字符串的 sha256 摘要
+    static Hash256 sha256(const string& data);
+
+    // 从 32 字节原始数据构造
+    static Hash256 from_raw(const void* data);
+
+    // 解析 64 位 16 进制字符串, "None" 解析为空哈希, 格式错误时返回 false
+    static bool from_hex(const string& hex, Hash256& hash);
+
+    // 是否为空哈希
+    bool is_null() const;
+
+    // 16 进制字符串
+    string to_hex() const;
+
+    // 文本形式, 空哈希为 "None", 否则为 16 进制
+    string to_string() const;
+
+    // 原始字节, 用作数据库键
+    string raw() const;
+
+    // 二进制编码
+    void encode(Encoder& enc) const;
+
+    // 二进制解码
+    static bool decode(Decoder& dec, Hash256& hash);
+
+    bool operator==(const Hash256& other) const { return memcmp(bytes, other.bytes, SIZE) == 0; }
+
+    bool operator!=(const Hash256& other) const { return !(*this == other); }
+
+    bool operator<(const Hash256& other) const { return memcmp(bytes, other.bytes, SIZE) < 0; }
+};
+
+// 日志输出为文本形式
+ostream& operator<<(ostream& os, const Hash256& hash);
+
+namespace std {
+// 区块哈希满足工作量证明, 开头的字节都是 0, 所以把 4 个 8 字节的字异或在一起
+template <>
+struct hash<Hash256> {
+    size_t operator()(const Hash256& hash) const {
+        uint64_t words[Hash256::SIZE / 8];
+        memcpy(words, hash.bytes, sizeof(words));
+        return words[0] ^ words[1] ^ words[2] ^ words[3];
+    }
+};
+}
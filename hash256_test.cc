@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include <unordered_set>
+#include "hash256.h"
+
+TEST(Hash256Tests, hex_and_ordering) {
+    Hash256 hash = Hash256::sha256(string("abc"));
+    EXPECT_EQ(hash.to_hex(), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    Hash256 parsed;
+    ASSERT_TRUE(Hash256::from_hex(hash.to_hex(), parsed));
+    EXPECT_EQ(parsed, hash);
+    EXPECT_EQ(Hash256::from_raw(hash.raw().data()), hash);
+
+    // "None" 与空哈希互相转换
+    EXPECT_TRUE(Hash256().is_null());
+    EXPECT_EQ(Hash256().to_string(), "None");
+    ASSERT_TRUE(Hash256::from_hex("None", parsed));
+    EXPECT_TRUE(parsed.is_null());
+
+    // 长度错误或非法字符
+    EXPECT_FALSE(Hash256::from_hex("abc", parsed));
+    EXPECT_FALSE(Hash256::from_hex(string(63, '0') + "g", parsed));
+
+    // 按字节比较, 可以作为有序容器和哈希表的键
+    Hash256 low, high;
+    high.bytes[0] = 1;
+    EXPECT_TRUE(low < high);
+    EXPECT_FALSE(high < low);
+    unordered_set<Hash256> hashes{low, high, hash, hash};
+    EXPECT_EQ(hashes.size(), 3);
+
+    // 开头 8 个字节都是 0 的哈希(例如区块哈希)仍然分散到不同的桶
+    Hash256 a, b;
+    a.bytes[31] = 1;
+    b.bytes[31] = 2;
+    EXPECT_NE(std::hash<Hash256>()(a), std::hash<Hash256>()(b));
+    EXPECT_NE(std::hash<Hash256>()(a), std::hash<Hash256>()(low));
+}
@@ -24,6 +24,8 @@ enum class Command {
     printchain,
     clearchain,
     reindexutxo,
+    reindexchain,
+    migratechain,
     startnode,
     help,
 };
@@ -31,6 +33,19 @@ enum class Command {
 int main(int argc, char *argv[]) {
     Command selected = Command::help;
     vector<string> input;
+    int mining_threads = 0;
+    int worker_threads = 0;
+    int verify_threads = 0;
+    long signature_cache_size = -1;
+    string transport;
+    int download_window = 0;
+    int fee = 0;
+    long block_max_bytes = 0;
+    long block_max_txs = 0;
+    long mempool_mb = 0;
+    long mempool_expiry_hours = 0;
+    long block_cache_mb = -1;
+    long coins_cache_mb = -1;
     
     auto createblockchain = command("createblockchain").set(selected, Command::createblockchain);
     auto createwallet = command("createwallet").set(selected, Command::createwallet);
@@ -44,14 +59,29 @@ int main(int argc, char *argv[]) {
         value("from", input),
         value("to", input),
         value("amount", input),
+        option("-fee") & value("fee", fee),
         option("-mine").set(MINE_TRUE)
     );
     auto printchain = command("printchain").set(selected, Command::printchain);
     auto clearchain = command("clearchain").set(selected, Command::clearchain);
     auto reindexutxo = command("reindexutxo").set(selected, Command::reindexutxo);
+    auto reindexchain = command("reindexchain").set(selected, Command::reindexchain);
+    auto migratechain = command("migratechain").set(selected, Command::migratechain);
     auto startnode = (
         command("startnode").set(selected, Command::startnode),
-        option("miner") & value("address", input)
+        option("miner") & value("address", input),
+        option("-threads") & value("threads", mining_threads),
+        option("-workers") & value("workers", worker_threads),
+        option("-verifiers") & value("threads", verify_threads),
+        option("-sigcache") & value("entries", signature_cache_size),
+        option("-transport") & value("udp|tcp", transport),
+        option("-window") & value("blocks", download_window),
+        option("-blockbytes") & value("bytes", block_max_bytes),
+        option("-blocktxs") & value("txs", block_max_txs),
+        option("-mempool") & value("MB", mempool_mb),
+        option("-mempoolexpiry") & value("hours", mempool_expiry_hours),
+        option("-blockcache") & value("MB", block_cache_mb),
+        option("-coinscache") & value("MB", coins_cache_mb)
     );
     auto help = command("help").set(selected, Command::help);
     auto cli = (
@@ -63,6 +93,8 @@ int main(int argc, char *argv[]) {
         printchain | 
         clearchain |
         reindexutxo |
+        reindexchain |
+        migratechain |
         startnode |
         help
     );
@@ -73,8 +105,8 @@ int main(int argc, char *argv[]) {
             case Command::createblockchain:
                 {
                     auto bc = Blockchain::new_blockchain();
-                    auto utxo_set = UTXOSet::new_utxo_set(bc);
-                    utxo_set->reindex();
+                    // 创建 UTXO 集时会与区块链同步
+                    delete UTXOSet::new_utxo_set(bc);
                     std::cout << "Done!" << std::endl;
                     break;
                 }
@@ -130,17 +162,22 @@ int main(int argc, char *argv[]) {
                         std::cout << "ERROR: Amount must be greater than 0" << std::endl;
                         break;
                     }
+                    if (fee < 0) {
+                        std::cout << "ERROR: Fee must not be negative" << std::endl;
+                        break;
+                    }
                     Blockchain *bc = Blockchain::new_blockchain();
                     UTXOSet* utxo_set = UTXOSet::new_utxo_set(bc);
                     // 创建 UTXO 交易
-                    auto tx = Transaction::new_utxo_transaction(from, to, amount, utxo_set);
+                    auto tx = Transaction::new_utxo_transaction(from, to, amount, fee, utxo_set);
                     if (MINE_TRUE) {
                         // 挖矿奖励
-                        auto coinbase_tx = Transaction::new_coinbase_tx(from);
+                        auto coinbase_tx = Transaction::new_coinbase_tx(from, fee);
                         // 挖新区块
                         auto block = bc->mine_block(vector<Transaction*> {tx, coinbase_tx});
                         // 更新 UTXO 集
                         utxo_set->update(block);
+                        utxo_set->flush();
                     } else {
                         // 发送交易到中心节点
                         send_tx(CENTERAL_NODE, tx);
@@ -152,13 +189,17 @@ int main(int argc, char *argv[]) {
                 {
                     Blockchain *bc = Blockchain::new_blockchain();
                     BlockchainIterator *iter = bc->iterator();
-                    while (true) {
-                        Block *block = iter->next();
-                        if (block == nullptr) {
-                            break;
-                        }
-                        std::cout << "Prev_hash: " << block->pre_block_hash << ", hash: " << block->hash << ", height: " << block->height << std::endl;
-                        for (auto tx : block->transactions) {
+                    // 逐个区块、逐笔交易解码, 不需要完整构造区块
+                    PinnableSlice pinned;
+                    BlockView view;
+                    while (iter->next(pinned, view)) {
+                        const BlockHeader& header = view.header();
+                        std::cout << "Prev_hash: " << header.pre_block_hash << ", hash: " << header.hash << ", height: " << header.height << std::endl;
+                        for (size_t pos = 0; pos < view.transaction_count(); pos++) {
+                            unique_ptr<Transaction> tx(view.transaction(pos));
+                            if (tx == nullptr) {
+                                break;
+                            }
                             for (auto vin : tx->vin) {
                                 string address = pub_key_hash_to_address(hash_pub_key(vin.pub_key));
                                 cout << "Transaction input txid = " << vin.txid << ", vout = " << vin.vout << ", from = " << address << endl;  
@@ -168,7 +209,7 @@ int main(int argc, char *argv[]) {
                                 cout << "Transaction output txid = " << tx->id << ", value = " << vout.value << ", to = " << address << endl;
                             }
                         }
-                        std::cout << "Timestamp: " << block->timestamp << std::endl;
+                        std::cout << "Timestamp: " << header.timestamp << std::endl;
                     }
                     break;
                 }
@@ -186,6 +227,20 @@ int main(int argc, char *argv[]) {
                     cout << "Done! There are " << utxo_set->count_transactions() << " transactions in the UTXO set." << endl;
                     break;
                 }
+            case Command::reindexchain:
+                {
+                    Blockchain *bc = Blockchain::new_blockchain();
+                    bc->reindex();
+                    cout << "Done!" << endl;
+                    break;
+                }
+            case Command::migratechain:
+                {
+                    Blockchain *bc = Blockchain::new_blockchain();
+                    int migrated = bc->migrate();
+                    cout << "Done! Migrated " << migrated << " blocks to the binary format." << endl;
+                    break;
+                }
             case Command::startnode:
                 {
                     if (input.size() == 1) {
@@ -197,10 +252,53 @@ int main(int argc, char *argv[]) {
                         std::cout << "Mining is on. Address to receive rewards: " << miner_address << std::endl;
                         auto config = Config::get_instance(); 
                         config->set_mining_address(miner_address);
+                        if (mining_threads > 0) {
+                            config->set_mining_threads(mining_threads);
+                        }
+                        if (block_max_bytes > 0) {
+                            config->set_block_max_bytes(block_max_bytes);
+                        }
+                        if (block_max_txs > 0) {
+                            config->set_block_max_txs(block_max_txs);
+                        }
+                        std::cout << "Mining threads: " << config->get_mining_threads() << std::endl;
+                    }
+                    if (worker_threads > 0) {
+                        Config::get_instance()->set_worker_threads(worker_threads);
+                    }
+                    if (verify_threads > 0) {
+                        Config::get_instance()->set_verify_threads(verify_threads);
+                    }
+                    if (signature_cache_size >= 0) {
+                        Config::get_instance()->set_signature_cache_size(signature_cache_size);
+                    }
+                    if (!transport.empty()) {
+                        if (transport != "udp" && transport != "tcp") {
+                            std::cout << "ERROR: Transport must be udp or tcp" << std::endl;
+                            break;
+                        }
+                        Config::get_instance()->set_transport(transport);
+                    }
+                    if (download_window > 0) {
+                        Config::get_instance()->set_download_window(download_window);
+                    }
+                    if (mempool_mb > 0) {
+                        Config::get_instance()->set_mempool_max_usage(mempool_mb * 1024 * 1024);
+                    }
+                    if (mempool_expiry_hours > 0) {
+                        Config::get_instance()->set_mempool_expiry(std::chrono::hours(mempool_expiry_hours));
+                    }
+                    if (block_cache_mb >= 0) {
+                        Config::get_instance()->set_block_cache_size(block_cache_mb * 1024 * 1024);
+                    }
+                    if (coins_cache_mb >= 0) {
+                        Config::get_instance()->set_coins_cache_size(coins_cache_mb * 1024 * 1024);
                     }
                     Blockchain *bc = Blockchain::new_blockchain();
                     string node_addr = Config::get_instance()->get_node_address();
-                    Server::new_server(node_addr, bc)->run();
+                    Server* server = Server::new_server(node_addr, bc);
+                    server->run();
+                    delete server;
                     break;
                 }
             case Command::help:
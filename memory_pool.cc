@@ -1,31 +1,207 @@
+#include <functional>
 #include "memory_pool.h"
 
+MemoryPool::MemoryPool() : MemoryPool(DEFAULT_MEMPOOL_MAX_USAGE, DEFAULT_MEMPOOL_EXPIRY) {}
+
+MemoryPool::MemoryPool(size_t max_usage, std::chrono::seconds expiry)
+    : next_sequence(0), max_usage(max_usage), expiry(expiry), total_usage(0), total_bytes(0),
+      evicted(0), expired(0), replaced(0) {}
+
 // 创建交易池
 MemoryPool* MemoryPool::new_memory_pool() {
     return new MemoryPool();
 }
 
+// 创建交易池, 指定内存上限和交易过期时间
+MemoryPool* MemoryPool::new_memory_pool(size_t max_usage, std::chrono::seconds expiry) {
+    return new MemoryPool(max_usage, expiry);
+}
+
 // 检查交易
-bool MemoryPool::containes(const string& txid) {
+bool MemoryPool::containes(const Hash256& txid) {
     return txs.find(txid) != txs.end();
 }
 
-// 添加交易
-void MemoryPool::add(Transaction* tx) {
-    txs[tx->id] = tx;
+// 添加交易(手续费为 0)
+bool MemoryPool::add(Transaction* tx) {
+    return add(tx, 0);
+}
+
+// 添加交易, 重复的交易替换旧对象
+bool MemoryPool::add(Transaction* tx, long fee) {
+    size_t size = transaction_size(tx);
+    size_t tx_usage = transaction_usage(tx);
+    if (tx_usage > max_usage) {
+        return false;
+    }
+    // 与池中其他交易花费同一输出的冲突交易
+    set<Hash256> conflicts;
+    for (auto& vin : tx->vin) {
+        if (vin.txid.is_null()) {
+            continue;
+        }
+        auto it = spent_by.find(OutPoint{vin.txid, vin.vout});
+        if (it != spent_by.end() && it->second != tx->id) {
+            conflicts.insert(it->second);
+        }
+    }
+    // 手续费率必须高于每一笔冲突交易, 手续费必须高于被替换交易(含后代)的总和
+    set<Hash256> to_replace;
+    for (auto& txid : conflicts) {
+        const MempoolEntry& entry = txs[txid];
+        if ((__int128)fee * entry.size <= (__int128)entry.fee * size) {
+            return false;
+        }
+        collect_descendants(txid, to_replace);
+    }
+    long replaced_fees = 0;
+    size_t freed = 0;
+    for (auto& txid : to_replace) {
+        replaced_fees += txs[txid].fee;
+        freed += txs[txid].usage;
+    }
+    if (!to_replace.empty() && fee <= replaced_fees) {
+        return false;
+    }
+    auto same = txs.find(tx->id);
+    if (same != txs.end()) {
+        freed += same->second.usage;
+    }
+    // 容量不足时从驱逐分数最低的交易开始驱逐(连同后代), 被驱逐的分数必须低于新交易的手续费率
+    set<Hash256> to_evict;
+    for (auto it = by_eviction_score.rbegin(); it != by_eviction_score.rend() && total_usage + tx_usage > max_usage + freed; ++it) {
+        if (it->txid == tx->id || to_replace.count(it->txid) || to_evict.count(it->txid)) {
+            continue;
+        }
+        if ((__int128)it->fee * size >= (__int128)fee * it->size) {
+            return false;
+        }
+        set<Hash256> group;
+        collect_descendants(it->txid, group);
+        for (auto& txid : group) {
+            if (txid != tx->id && !to_replace.count(txid) && to_evict.insert(txid).second) {
+                freed += txs[txid].usage;
+            }
+        }
+    }
+    // 不能花费即将移除的交易的输出
+    for (auto& vin : tx->vin) {
+        if (to_replace.count(vin.txid) || to_evict.count(vin.txid)) {
+            return false;
+        }
+    }
+    for (auto& txid : to_replace) {
+        remove(txid);
+    }
+    for (auto& txid : to_evict) {
+        remove(txid);
+    }
+    replaced += to_replace.size();
+    evicted += to_evict.size();
+    auto it = txs.find(tx->id);
+    if (it != txs.end()) {
+        unlink(it->second);
+        if (it->second.tx != tx) {
+            delete it->second.tx;
+        }
+        txs.erase(it);
+    }
+    MempoolEntry entry{tx, fee, size, next_sequence++, tx_usage, fee, size, std::chrono::steady_clock::now()};
+    by_fee_rate.insert(fee_rate_key(entry));
+    by_eviction_score.insert(eviction_key(entry));
+    by_sequence[entry.sequence] = tx->id;
+    for (auto& vin : tx->vin) {
+        if (!vin.txid.is_null()) {
+            spent_by[OutPoint{vin.txid, vin.vout}] = tx->id;
+        }
+    }
+    total_usage += tx_usage;
+    total_bytes += size;
+    txs[tx->id] = entry;
+    // 池中可能已有花费它的子交易(重复的交易), 连同祖先一起重新计算
+    set<Hash256> affected{tx->id};
+    collect_ancestors(tx->id, affected);
+    update_descendant_totals(affected);
+    return true;
+}
+
+// 池中花费 outpoint 的交易 ID
+Hash256 MemoryPool::spender(const OutPoint& outpoint) {
+    auto it = spent_by.find(outpoint);
+    if (it == spent_by.end()) {
+        return Hash256();
+    }
+    return it->second;
 }
 
-// 获取交易
-Transaction* MemoryPool::get(const string& txid) {
-    return txs[txid];
+// 获取交易, 不存在时返回 nullptr
+Transaction* MemoryPool::get(const Hash256& txid) {
+    auto it = txs.find(txid);
+    if (it == txs.end()) {
+        return nullptr;
+    }
+    return it->second.tx;
+}
+
+// 获取交易条目
+const MempoolEntry* MemoryPool::get_entry(const Hash256& txid) {
+    auto it = txs.find(txid);
+    if (it == txs.end()) {
+        return nullptr;
+    }
+    return &it->second;
 }
 
 // 删除交易
-void MemoryPool::remove(const string& txid) {
-    if (txs.find(txid) == txs.end()) {
+void MemoryPool::remove(const Hash256& txid) {
+    auto it = txs.find(txid);
+    if (it == txs.end()) {
         return;
     }
-    txs.erase(txid);
+    set<Hash256> ancestors;
+    collect_ancestors(txid, ancestors);
+    unlink(it->second);
+    delete it->second.tx;
+    txs.erase(it);
+    update_descendant_totals(ancestors);
+}
+
+// 区块上链后删除其中的交易, 并驱逐冲突交易
+size_t MemoryPool::remove_confirmed(const vector<Transaction*>& confirmed) {
+    set<Hash256> evicted;
+    for (auto tx : confirmed) {
+        remove(tx->id);
+        // 池中仍在花费同一输出的交易已经不可能上链
+        for (auto& vin : tx->vin) {
+            if (vin.txid.is_null()) {
+                continue;
+            }
+            auto it = spent_by.find(OutPoint{vin.txid, vin.vout});
+            if (it != spent_by.end()) {
+                collect_descendants(it->second, evicted);
+            }
+        }
+    }
+    for (auto& txid : evicted) {
+        remove(txid);
+    }
+    return evicted.size();
+}
+
+// 移除过期的交易及其后代
+size_t MemoryPool::expire(std::chrono::steady_clock::time_point now) {
+    set<Hash256> to_expire;
+    for (auto& kv : by_sequence) {
+        if (now - txs[kv.second].time < expiry) {
+            break;
+        }
+        collect_descendants(kv.second, to_expire);
+    }
+    for (auto& txid : to_expire) {
+        remove(txid);
+    }
+    expired += to_expire.size();
+    return to_expire.size();
 }
 
 // 池中交易数量
@@ -33,12 +209,203 @@ size_t MemoryPool::len() {
     return txs.size();
 }
 
+// 估算的内存占用
+size_t MemoryPool::usage() {
+    return total_usage;
+}
+
+// 交易池统计
+MempoolStats MemoryPool::stats() {
+    return MempoolStats{txs.size(), total_bytes, total_usage, max_usage, evicted, expired, replaced};
+}
+
 // 获取池中所有交易
 vector<Transaction*> MemoryPool::get_all() {
     vector<Transaction*> txs;
     for (auto& kv : this->txs) {
-        txs.push_back(kv.second);
+        txs.push_back(kv.second.tx);
     }
     return txs;
 }
 
+// 生成区块模板
+vector<Transaction*> MemoryPool::build_template(size_t max_bytes, size_t max_count, long& total_fees) {
+    vector<Transaction*> selected;
+    set<Hash256> chosen;
+    size_t bytes = 0;
+    total_fees = 0;
+    // 父交易尚未选中的交易, 父交易 ID -> 等待的子交易
+    map<Hash256, vector<const MempoolEntry*>> waiting;
+
+    std::function<void(const MempoolEntry*)> try_add = [&](const MempoolEntry* entry) {
+        if (selected.size() >= max_count || bytes + entry->size > max_bytes) {
+            return;
+        }
+        for (auto& vin : entry->tx->vin) {
+            if (txs.count(vin.txid) && !chosen.count(vin.txid)) {
+                waiting[vin.txid].push_back(entry);
+                return;
+            }
+        }
+        selected.push_back(entry->tx);
+        chosen.insert(entry->tx->id);
+        bytes += entry->size;
+        total_fees += entry->fee;
+        // 父交易选中后, 重新尝试等待它的子交易
+        auto it = waiting.find(entry->tx->id);
+        if (it != waiting.end()) {
+            vector<const MempoolEntry*> children = std::move(it->second);
+            waiting.erase(it);
+            for (auto child : children) {
+                if (!chosen.count(child->tx->id)) {
+                    try_add(child);
+                }
+            }
+        }
+    };
+
+    for (auto& key : by_fee_rate) {
+        if (selected.size() >= max_count) {
+            break;
+        }
+        if (!chosen.count(key.txid)) {
+            try_add(&txs[key.txid]);
+        }
+    }
+    return selected;
+}
+
+// 按手续费率从高到低排列, 手续费率相同时先加入的在前
+// 比较 fee1 / size1 > fee2 / size2 时交叉相乘, 避免浮点误差
+bool MemoryPool::FeeRateKey::operator<(const FeeRateKey& other) const {
+    __int128 lhs = (__int128)fee * other.size;
+    __int128 rhs = (__int128)other.fee * size;
+    if (lhs != rhs) {
+        return lhs > rhs;
+    }
+    if (sequence != other.sequence) {
+        return sequence < other.sequence;
+    }
+    return txid < other.txid;
+}
+
+// 条目在手续费率索引中的键
+MemoryPool::FeeRateKey MemoryPool::fee_rate_key(const MempoolEntry& entry) {
+    return FeeRateKey{entry.fee, entry.size, entry.sequence, entry.tx->id};
+}
+
+// 条目在驱逐索引中的键, 取自身手续费率和含后代的手续费率中较高的一个
+MemoryPool::FeeRateKey MemoryPool::eviction_key(const MempoolEntry& entry) {
+    if ((__int128)entry.descendant_fee * entry.size > (__int128)entry.fee * entry.descendant_size) {
+        return FeeRateKey{entry.descendant_fee, entry.descendant_size, entry.sequence, entry.tx->id};
+    }
+    return fee_rate_key(entry);
+}
+
+// 从各个索引中删除条目
+void MemoryPool::unlink(const MempoolEntry& entry) {
+    by_fee_rate.erase(fee_rate_key(entry));
+    by_eviction_score.erase(eviction_key(entry));
+    by_sequence.erase(entry.sequence);
+    total_usage -= entry.usage;
+    total_bytes -= entry.size;
+    for (auto& vin : entry.tx->vin) {
+        auto it = spent_by.find(OutPoint{vin.txid, vin.vout});
+        if (it != spent_by.end() && it->second == entry.tx->id) {
+            spent_by.erase(it);
+        }
+    }
+}
+
+// 收集 txid 及其在池中的所有后代, 后代通过 outpoint 索引查找
+void MemoryPool::collect_descendants(const Hash256& txid, set<Hash256>& out) {
+    vector<Hash256> stack{txid};
+    while (!stack.empty()) {
+        Hash256 id = stack.back();
+        stack.pop_back();
+        auto it = txs.find(id);
+        if (it == txs.end() || !out.insert(id).second) {
+            continue;
+        }
+        for (int i = 0; i < (int)it->second.tx->vout.size(); i++) {
+            auto child = spent_by.find(OutPoint{id, i});
+            if (child != spent_by.end()) {
+                stack.push_back(child->second);
+            }
+        }
+    }
+}
+
+// 收集 txid 在池中的所有祖先, 祖先通过交易输入查找
+void MemoryPool::collect_ancestors(const Hash256& txid, set<Hash256>& out) {
+    vector<Hash256> stack{txid};
+    while (!stack.empty()) {
+        auto it = txs.find(stack.back());
+        stack.pop_back();
+        if (it == txs.end()) {
+            continue;
+        }
+        for (auto& vin : it->second.tx->vin) {
+            if (txs.count(vin.txid) && out.insert(vin.txid).second) {
+                stack.push_back(vin.txid);
+            }
+        }
+    }
+}
+
+// 重新计算交易的后代手续费和大小, 不在池中的交易忽略
+void MemoryPool::update_descendant_totals(const set<Hash256>& txids) {
+    for (auto& txid : txids) {
+        auto it = txs.find(txid);
+        if (it == txs.end()) {
+            continue;
+        }
+        MempoolEntry& entry = it->second;
+        set<Hash256> descendants;
+        collect_descendants(txid, descendants);
+        by_eviction_score.erase(eviction_key(entry));
+        entry.descendant_fee = 0;
+        entry.descendant_size = 0;
+        for (auto& id : descendants) {
+            entry.descendant_fee += txs[id].fee;
+            entry.descendant_size += txs[id].size;
+        }
+        by_eviction_score.insert(eviction_key(entry));
+    }
+}
+
+MemoryPool::~MemoryPool() {
+    for (auto& kv : txs) {
+        delete kv.second.tx;
+    }
+}
+
+// 交易的二进制编码大小
+size_t transaction_size(Transaction* tx) {
+    Encoder enc;
+    tx->encode(enc);
+    return enc.data().size();
+}
+
+// 估算交易在交易池中的内存占用
+size_t transaction_usage(Transaction* tx) {
+    // 红黑树和哈希表节点的额外开销
+    const size_t tree_node = 32;
+    const size_t hash_node = 24;
+    size_t usage = sizeof(Transaction);
+    usage += tx->vin.capacity() * sizeof(TXInput);
+    for (auto& vin : tx->vin) {
+        usage += vin.signature.capacity() + vin.pub_key.capacity();
+        // outpoint 索引的节点
+        usage += hash_node + sizeof(OutPoint) + sizeof(Hash256);
+    }
+    usage += tx->vout.capacity() * sizeof(TXOutput);
+    for (auto& vout : tx->vout) {
+        usage += vout.pub_key_hash.capacity();
+    }
+    // 交易表, 手续费率索引和加入顺序索引的节点
+    usage += tree_node + sizeof(Hash256) + sizeof(MempoolEntry);
+    usage += tree_node + sizeof(long) + sizeof(size_t) + sizeof(uint64_t) + sizeof(Hash256);
+    usage += tree_node + sizeof(uint64_t) + sizeof(Hash256);
+    return usage;
+}
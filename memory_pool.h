@@ -1,33 +1,148 @@
 #pragma once
 
+#include <chrono>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include "transaction.h"
 
+// 交易池中的交易及其手续费信息
+struct MempoolEntry {
+    Transaction* tx;
+    long fee; // 手续费, 输入总额减输出总额
+    size_t size; // 二进制编码大小(字节)
+    uint64_t sequence; // 加入顺序, 手续费率相同时先到先得
+    size_t usage; // 估算的内存占用(字节), 包括交易对象和索引
+    long descendant_fee; // 自身和池中全部后代的手续费之和
+    size_t descendant_size; // 自身和池中全部后代的大小之和
+    std::chrono::steady_clock::time_point time; // 加入时间
+};
+
+// 交易池统计
+struct MempoolStats {
+    size_t count; // 交易数量
+    size_t bytes; // 交易编码大小之和
+    size_t usage; // 估算的内存占用
+    size_t max_usage; // 内存占用上限
+    uint64_t evicted; // 因容量不足被驱逐的交易数
+    uint64_t expired; // 超时被移除的交易数
+    uint64_t replaced; // 被更高手续费交易替换的交易数
+};
+
+// 默认的交易池内存上限
+const size_t DEFAULT_MEMPOOL_MAX_USAGE = 300 * 1024 * 1024;
+
+// 默认的交易过期时间
+const std::chrono::seconds DEFAULT_MEMPOOL_EXPIRY(14 * 24 * 3600);
+
+// 交易池, 持有池中的交易, 移除时释放
+// 交易按手续费率(fee / size)建立有序索引, 矿工按手续费率从高到低选择交易生成区块模板.
+// 另外维护 outpoint -> 花费它的交易 ID 的索引, 同一个输出在池中最多被一笔交易花费:
+// 冲突的新交易只有在手续费率高于每一笔冲突交易, 且手续费高于被替换交易(含后代)的总和时才替换它们, 否则被拒绝.
+// 交易池的内存占用有上限, 超出时按驱逐分数从低到高驱逐交易及其后代. 驱逐分数取自身手续费率和含后代的手续费率中
+// 较高的一个, 手续费高的子交易会保护它的父交易; 手续费率不高于被驱逐分数的新交易被拒绝.
 class MemoryPool {
 public:
+    MemoryPool();
+    MemoryPool(size_t max_usage, std::chrono::seconds expiry);
+    ~MemoryPool();
 
     // 创建交易池
     static MemoryPool* new_memory_pool();
 
+    // 创建交易池, 指定内存上限和交易过期时间
+    static MemoryPool* new_memory_pool(size_t max_usage, std::chrono::seconds expiry);
+
     // 检查交易
-    bool containes(const string& txid);
+    bool containes(const Hash256& txid);
+
+    // 添加交易(手续费为 0)
+    bool add(Transaction* tx);
+
+    // 添加交易, 重复的交易替换旧对象. 与池中交易冲突且手续费不足以替换, 或者交易池已满且手续费率不足以驱逐
+    // 其他交易时返回 false, 交易仍归调用方所有
+    bool add(Transaction* tx, long fee);
 
-    // 添加交易
-    void add(Transaction* tx);
+    // 池中花费 outpoint 的交易 ID, 没有时返回空哈希
+    Hash256 spender(const OutPoint& outpoint);
 
     // 获取交易
-    Transaction* get(const string& txid);
+    Transaction* get(const Hash256& txid);
+
+    // 获取交易条目, 不存在时返回 nullptr
+    const MempoolEntry* get_entry(const Hash256& txid);
+
+    // 删除交易, 不影响花费它的输出的交易
+    void remove(const Hash256& txid);
+
+    // 区块上链后调用: 删除区块中的交易, 并驱逐与它们花费同一输出的池中交易及其后代, 返回驱逐的交易数
+    size_t remove_confirmed(const vector<Transaction*>& txs);
 
-    // 删除交易
-    void remove(const string& txid);
+    // 移除加入时间早于 now - expiry 的交易及其后代, 返回移除的交易数
+    size_t expire(std::chrono::steady_clock::time_point now);
 
     // 池中交易数量
     size_t len();
 
+    // 估算的内存占用
+    size_t usage();
+
+    // 交易池统计
+    MempoolStats stats();
+
     // 获取池中所有交易
     vector<Transaction*> get_all();
 
+    // 生成区块模板: 按手续费率从高到低选择交易, 总大小不超过 max_bytes, 数量不超过 max_count.
+    // 花费池中其他交易输出的交易排在父交易之后. total_fees 返回所选交易的手续费总额.
+    vector<Transaction*> build_template(size_t max_bytes, size_t max_count, long& total_fees);
+
 private:
-    map<string, Transaction*> txs;
+    // 手续费率索引的键, 按手续费率从高到低排列
+    struct FeeRateKey {
+        long fee;
+        size_t size;
+        uint64_t sequence;
+        Hash256 txid;
+
+        bool operator<(const FeeRateKey& other) const;
+    };
+
+    map<Hash256, MempoolEntry> txs;
+    set<FeeRateKey> by_fee_rate;
+    set<FeeRateKey> by_eviction_score; // 按驱逐分数从高到低排列, 驱逐时从末尾开始
+    unordered_map<OutPoint, Hash256, OutPointHash> spent_by; // outpoint -> 花费它的池中交易 ID
+    map<uint64_t, Hash256> by_sequence; // 按加入顺序排列, 用于过期检查
+    uint64_t next_sequence;
+    size_t max_usage;
+    std::chrono::seconds expiry;
+    size_t total_usage;
+    size_t total_bytes;
+    uint64_t evicted;
+    uint64_t expired;
+    uint64_t replaced;
+
+    // 条目在手续费率索引中的键
+    static FeeRateKey fee_rate_key(const MempoolEntry& entry);
+
+    // 条目在驱逐索引中的键
+    static FeeRateKey eviction_key(const MempoolEntry& entry);
+
+    // 从手续费率索引, 驱逐索引和 outpoint 索引中删除条目
+    void unlink(const MempoolEntry& entry);
+
+    // 收集 txid 及其在池中的所有后代
+    void collect_descendants(const Hash256& txid, set<Hash256>& out);
+
+    // 收集 txid 在池中的所有祖先, 不含自身
+    void collect_ancestors(const Hash256& txid, set<Hash256>& out);
+
+    // 重新计算交易的后代手续费和大小, 并更新驱逐索引
+    void update_descendant_totals(const set<Hash256>& txids);
 };
 
+// 交易的二进制编码大小
+size_t transaction_size(Transaction* tx);
+
+// 估算交易在交易池中的内存占用, 包括交易对象的堆内存和各个索引的节点
+size_t transaction_usage(Transaction* tx);
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "memory_pool.h"
+
+// 测试用的交易 ID
+static Hash256 h(const string& label) {
+    return Hash256::sha256(label);
+}
+
+// 构造花费 inputs 的交易
+static Transaction* make_tx(const string& id, vector<string> inputs) {
+    Transaction* tx = new Transaction;
+    tx->id = h(id);
+    for (auto& txid : inputs) {
+        tx->vin.push_back(TXInput{h(txid), 0, {}, {}});
+    }
+    TXOutput txout;
+    txout.value = 1;
+    tx->vout.push_back(txout);
+    return tx;
+}
+
+TEST(MemoryPoolTests, build_template) {
+    MemoryPool pool;
+    pool.add(make_tx("low", {"a"}), 1);
+    pool.add(make_tx("high", {"b"}), 50);
+    pool.add(make_tx("mid", {"c"}), 10);
+    // 子交易手续费率最高, 但必须排在父交易之后
+    pool.add(make_tx("child", {"low"}), 100);
+
+    long fees = 0;
+    vector<Transaction*> txs = pool.build_template(1000000, 10, fees);
+    vector<Hash256> ids;
+    for (auto tx : txs) {
+        ids.push_back(tx->id);
+    }
+    EXPECT_EQ(ids, (vector<Hash256>{h("high"), h("mid"), h("low"), h("child")}));
+    EXPECT_EQ(fees, 161);
+
+    // 数量上限
+    txs = pool.build_template(1000000, 2, fees);
+    ASSERT_EQ(txs.size(), 2);
+    EXPECT_EQ(txs[0]->id, h("high"));
+    EXPECT_EQ(fees, 60);
+
+    // 字节上限: 只能放下一笔交易
+    size_t size = pool.get_entry(h("high"))->size;
+    txs = pool.build_template(size, 10, fees);
+    ASSERT_EQ(txs.size(), 1);
+    EXPECT_EQ(txs[0]->id, h("high"));
+
+    // 移除后不再出现在模板中
+    pool.remove(h("high"));
+    txs = pool.build_template(1000000, 10, fees);
+    EXPECT_EQ(txs.size(), 3);
+    EXPECT_EQ(txs[0]->id, h("mid"));
+}
+
+TEST(MemoryPoolTests, conflicts) {
+    MemoryPool pool;
+    EXPECT_TRUE(pool.add(make_tx("tx1", {"a"}), 10));
+    EXPECT_TRUE(pool.add(make_tx("tx2", {"tx1"}), 5));
+    EXPECT_EQ(pool.spender(OutPoint{h("a"), 0}), h("tx1"));
+
+    // 手续费率不高于冲突交易时拒绝
+    unique_ptr<Transaction> low(make_tx("tx3", {"a"}));
+    EXPECT_FALSE(pool.add(low.get(), 10));
+    // 手续费率更高, 但不足以抵偿被替换交易及其后代的手续费
+    unique_ptr<Transaction> mid(make_tx("tx4", {"a"}));
+    EXPECT_FALSE(pool.add(mid.get(), 15));
+    EXPECT_EQ(pool.len(), 2);
+
+    // 替换冲突交易及其后代
+    EXPECT_TRUE(pool.add(make_tx("tx5", {"a"}), 16));
+    EXPECT_EQ(pool.len(), 1);
+    EXPECT_EQ(pool.spender(OutPoint{h("a"), 0}), h("tx5"));
+    EXPECT_EQ(pool.spender(OutPoint{h("tx1"), 0}), Hash256());
+
+    // 区块中的交易花费了同一输出, 池中的冲突交易及其后代被驱逐
+    EXPECT_TRUE(pool.add(make_tx("tx6", {"tx5"}), 1));
+    EXPECT_TRUE(pool.add(make_tx("tx7", {"b"}), 1));
+    unique_ptr<Transaction> confirmed(make_tx("tx8", {"a"}));
+    EXPECT_EQ(pool.remove_confirmed({confirmed.get()}), 2);
+    EXPECT_EQ(pool.len(), 1);
+    EXPECT_TRUE(pool.containes(h("tx7")));
+    EXPECT_EQ(pool.spender(OutPoint{h("a"), 0}), Hash256());
+}
+
+TEST(MemoryPoolTests, evict_and_expire) {
+    // 容量只够放下三笔交易
+    size_t usage = transaction_usage(unique_ptr<Transaction>(make_tx("tx1", {"a"})).get());
+    MemoryPool pool(usage * 3, std::chrono::seconds(60));
+    EXPECT_TRUE(pool.add(make_tx("tx1", {"a"}), 5));
+    EXPECT_TRUE(pool.add(make_tx("tx2", {"tx1"}), 50));
+    EXPECT_TRUE(pool.add(make_tx("tx3", {"b"}), 10));
+    EXPECT_EQ(pool.usage(), usage * 3);
+
+    // 手续费率不高于池中最低的驱逐分数时拒绝
+    unique_ptr<Transaction> low(make_tx("tx4", {"c"}));
+    EXPECT_FALSE(pool.add(low.get(), 5));
+
+    // tx1 的手续费率最低, 但含子交易 tx2 的手续费率高于 tx3, 先驱逐 tx3
+    EXPECT_TRUE(pool.add(make_tx("tx5", {"d"}), 20));
+    EXPECT_EQ(pool.len(), 3);
+    EXPECT_FALSE(pool.containes(h("tx3")));
+    EXPECT_TRUE(pool.containes(h("tx1")));
+    EXPECT_TRUE(pool.containes(h("tx2")));
+    EXPECT_EQ(pool.stats().evicted, 1);
+    EXPECT_LE(pool.usage(), usage * 3);
+
+    // 驱逐 tx1 时连同后代一起驱逐, 新交易的手续费率必须高于两者合计的手续费率
+    EXPECT_TRUE(pool.add(make_tx("tx6", {"e"}), 30));
+    EXPECT_FALSE(pool.containes(h("tx5")));
+    unique_ptr<Transaction> mid(make_tx("tx7", {"f"}));
+    EXPECT_FALSE(pool.add(mid.get(), 27));
+    EXPECT_TRUE(pool.add(make_tx("tx8", {"g"}), 28));
+    EXPECT_EQ(pool.len(), 2);
+    EXPECT_TRUE(pool.containes(h("tx6")));
+    EXPECT_TRUE(pool.containes(h("tx8")));
+    EXPECT_EQ(pool.stats().evicted, 4);
+
+    // 过期
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(pool.expire(now), 0);
+    EXPECT_EQ(pool.expire(now + std::chrono::seconds(61)), 2);
+    EXPECT_EQ(pool.len(), 0);
+    EXPECT_EQ(pool.usage(), 0);
+    EXPECT_EQ(pool.stats().expired, 2);
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <iostream>
+#include "config.h"
+#include "miner.h"
+#include "signature_verifier.h"
+
+Miner::Miner(Blockchain* bc, UTXOSet* utxo, MemoryPool* tx_pool, std::mutex& chain_mutex)
+    : bc(bc), utxo(utxo), tx_pool(tx_pool), chain_mutex(chain_mutex),
+      pending(false), stopping(false), cancelled(false), mining_height(-1) {}
+
+Miner::~Miner() {
+    stop();
+}
+
+// 启动矿工线程
+void Miner::start() {
+    worker = std::thread(&Miner::loop, this);
+}
+
+// 停止矿工线程
+void Miner::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cancelled = true;
+    cv.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+// 交易池有变化, 唤醒矿工线程
+void Miner::notify() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = true;
+    }
+    cv.notify_one();
+}
+
+// 链尾更新, 正在挖的高度已被占用时取消挖矿
+void Miner::on_new_tip(long height) {
+    long current = mining_height.load();
+    if (current >= 0 && current <= height) {
+        std::cout << "Competing block at height " << height << ", restart mining" << std::endl;
+        cancelled = true;
+        notify();
+    }
+}
+
+// 设置区块挖出后的回调
+void Miner::set_on_mined(std::function<void(Block*)> on_mined) {
+    this->on_mined = on_mined;
+}
+
+// 矿工线程主循环
+void Miner::loop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return pending || stopping; });
+            if (stopping) {
+                return;
+            }
+            pending = false;
+        }
+        // 挖矿期间可能又收到了足够的交易, 继续检查
+        if (mine_once()) {
+            notify();
+        }
+    }
+}
+
+// 从交易池生成模板并挖一个区块
+bool Miner::mine_once() {
+    Hash256 tip;
+    long height;
+    vector<Transaction*> txs;
+    map<Hash256, long> fees; // 模板中每笔交易的手续费
+    {
+        std::lock_guard<std::mutex> lock(chain_mutex);
+        if (tx_pool->len() < TRANSACTION_THRESHOLD) {
+            return false;
+        }
+        // 按手续费率选择交易, 为 coinbase 交易预留一个位置
+        Config* config = Config::get_instance();
+        size_t max_bytes = config->get_block_max_bytes();
+        size_t max_txs = config->get_block_max_txs();
+        max_bytes = max_bytes > COINBASE_RESERVED_BYTES ? max_bytes - COINBASE_RESERVED_BYTES : 0;
+        max_txs = max_txs > 1 ? max_txs - 1 : 0;
+        long total_fees = 0;
+        // 模板持有交易的副本, 验证和挖矿期间网络线程可以继续修改交易池
+        for (auto tx : tx_pool->build_template(max_bytes, max_txs, total_fees)) {
+            txs.push_back(new Transaction(*tx));
+            fees[tx->id] = tx_pool->get_entry(tx->id)->fee;
+        }
+        tip = bc->get_tip_hash();
+        height = bc->get_last_height() + 1;
+        // 在 chain_mutex 内重置取消标志, 之后到达的竞争区块一定能看到 mining_height
+        cancelled = false;
+        mining_height = height;
+    }
+
+    // 并行验证模板中全部输入的签名, 不持有 chain_mutex. 剔除无效交易(其后代引用的交易不再在模板中, 随后也会被剔除)
+    vector<Hash256> invalid;
+    while (true) {
+        VerifyResult result = SignatureVerifier::get_instance()->verify(txs, bc);
+        if (result.ok) {
+            std::cout << "Verified " << result.inputs << " inputs (" << result.cached << " cached) in " << result.micros / 1000.0 << " ms" << std::endl;
+            break;
+        }
+        std::cerr << "ERROR: Invalid transaction " << result.failed_txid << std::endl;
+        auto it = std::find_if(txs.begin(), txs.end(), [&result](Transaction* tx) { return tx->id == result.failed_txid; });
+        delete *it;
+        txs.erase(it);
+        invalid.push_back(result.failed_txid);
+    }
+    if (!invalid.empty()) {
+        std::lock_guard<std::mutex> lock(chain_mutex);
+        for (auto& txid : invalid) {
+            tx_pool->remove(txid);
+        }
+    }
+    if (txs.size() < TRANSACTION_THRESHOLD) {
+        mining_height = -1;
+        for (auto tx : txs) {
+            delete tx;
+        }
+        return false;
+    }
+    // 挖矿奖励, 包含手续费(无效交易的手续费不计入)
+    long total_fees = 0;
+    for (auto tx : txs) {
+        total_fees += fees[tx->id];
+    }
+    txs.push_back(Transaction::new_coinbase_tx(Config::get_instance()->get_mining_address(), total_fees));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            mining_height = -1;
+            for (auto tx : txs) {
+                delete tx;
+            }
+            return false;
+        }
+    }
+
+    // 挖区块, 不持有 chain_mutex
+    MiningStats stats;
+    unique_ptr<Block> block(new_block(tip, txs, height, &cancelled, &stats));
+    mining_height = -1;
+    if (block == nullptr) {
+        std::cout << "Mining at height " << height << " cancelled after " << stats.hashes << " hashes" << std::endl;
+        return false;
+    }
+    std::cout << "Mined block at height " << height << ": " << stats.hashes << " hashes, "
+              << static_cast<long>(stats.hash_rate) << " hashes/s" << std::endl;
+
+    std::lock_guard<std::mutex> lock(chain_mutex);
+    // 挖矿期间链尾已经变化, 区块作废
+    if (bc->get_tip_hash() != block->pre_block_hash) {
+        std::cout << "Discard stale block at height " << height << std::endl;
+        return false;
+    }
+    // 模板中的交易在挖矿期间可能已经被其他区块花费
+    if (!utxo->check_inputs(block.get())) {
+        std::cout << "Discard block at height " << height << ": spends a missing or spent output" << std::endl;
+        return false;
+    }
+    bc->add_block(block.get());
+    // 更新 UTXO 集
+    utxo->update(block.get());
+    std::cout << "New block mined: " << block->hash << std::endl;
+    // 从内存池中移除交易
+    tx_pool->remove_confirmed(block->transactions);
+    if (on_mined) {
+        on_mined(block.get());
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "blockchain.h"
+#include "memory_pool.h"
+#include "utxo_set.h"
+
+// 内存池中的交易阈值, 触发矿工挖新区块
+const uint8_t TRANSACTION_THRESHOLD = 2;
+
+// 区块模板中为 coinbase 交易预留的字节数
+const size_t COINBASE_RESERVED_BYTES = 1000;
+
+// 后台矿工
+// 挖矿在独立线程中进行, 网络线程只负责通知. 矿工在 chain_mutex 保护下从交易池复制出区块模板,
+// 释放锁后计算工作量证明, 找到随机数后重新加锁, 确认模板仍然接在链尾才写入区块.
+// 收到同高度(或更高)的竞争区块时取消当前挖矿, 以新的链尾重新生成模板.
+class Miner {
+public:
+    // bc, utxo, tx_pool 由调用方持有, 访问它们时必须持有 chain_mutex
+    Miner(Blockchain* bc, UTXOSet* utxo, MemoryPool* tx_pool, std::mutex& chain_mutex);
+
+    // 析构时停止矿工线程
+    ~Miner();
+
+    // 启动矿工线程
+    void start();
+
+    // 停止矿工线程, 正在进行的挖矿会被取消
+    void stop();
+
+    // 交易池有变化, 检查是否需要挖新区块
+    void notify();
+
+    // 链尾更新到 height, 当前模板已经过期时取消挖矿并重新生成模板
+    void on_new_tip(long height);
+
+    // 区块挖出并写入后调用(持有 chain_mutex), 用于广播
+    void set_on_mined(std::function<void(Block*)> on_mined);
+
+private:
+    Blockchain* bc;
+    UTXOSet* utxo;
+    MemoryPool* tx_pool;
+    std::mutex& chain_mutex;
+    std::function<void(Block*)> on_mined;
+
+    std::thread worker;
+    std::mutex mutex; // 保护 pending, stopping
+    std::condition_variable cv;
+    bool pending;
+    bool stopping;
+    std::atomic<bool> cancelled;
+    std::atomic<long> mining_height; // 当前模板的高度, 空闲时为 -1
+
+    // 矿工线程主循环
+    void loop();
+
+    // 从交易池生成模板并挖一个区块, 成功写入区块时返回 true
+    bool mine_once();
+};
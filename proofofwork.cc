@@ -1,62 +1,298 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "config.h"
 #include "proofofwork.h"
 #include "util.h"
 
 // 难度值, 这里表示哈希的前 20 位必须是 0
 const int targetBit = 8;
 
-ProofOfWork::ProofOfWork(Block* block) {
-    mpz_init(target); 
-    // target 等于 1 左移 256 - targetBit 位
-    mpz_ui_pow_ui(target, 2, 256 - targetBit);
+MiningKernel::MiningKernel(const vector<unsigned char>& prefix, int target_bits) 
+    : MiningKernel(prefix, target_bits, sha256_best_impl()) {}
 
+MiningKernel::MiningKernel(const vector<unsigned char>& prefix, int target_bits, const Sha256Impl& impl) {
+    this->impl = &impl;
+    // 压缩前缀中的完整块
+    int full_blocks = prefix.size() / 64;
+    sha256_init_state(midstate);
+    sha256_compress(midstate, prefix.data(), full_blocks);
+    tail_len = prefix.size() - full_blocks * 64;
+    // 每种随机数长度的尾部块: 前缀剩余字节, 随机数占位, 0x80, 补零, 消息的比特长度(大端序)
+    for (int nonce_len = 1; nonce_len <= 16; nonce_len++) {
+        unsigned char* blocks = tails[nonce_len];
+        int len = tail_len + nonce_len;
+        int nblocks = len + 9 <= 64 ? 1 : 2;
+        memset(blocks, 0, sizeof(tails[nonce_len]));
+        memcpy(blocks, prefix.data() + full_blocks * 64, tail_len);
+        blocks[len] = 0x80;
+        uint64_t bit_len = (prefix.size() + nonce_len) * 8;
+        for (int i = 0; i < 8; i++) {
+            blocks[nblocks * 64 - 1 - i] = static_cast<unsigned char>(bit_len >> (8 * i));
+        }
+        tail_blocks[nonce_len] = nblocks;
+    }
+    // target 等于 1 左移 256 - targetBit 位, 按大端序存放
+    memset(target, 0, sizeof(target));
+    int bit = 256 - target_bits;
+    if (bit >= 256) {
+        memset(target, 0xff, sizeof(target));
+    } else {
+        target[sizeof(target) - 1 - bit / 8] = static_cast<unsigned char>(1 << (bit % 8));
+    }
+}
+
+// 一批并行计算的随机数个数
+int MiningKernel::lanes() const {
+    return impl->lanes;
+}
+
+// 填充随机数所在的尾部块, 返回块数
+int MiningKernel::prepare_tail(long nonce, int nonce_len, unsigned char* blocks) const {
+    int nblocks = tail_blocks[nonce_len];
+    memcpy(blocks, tails[nonce_len], nblocks * 64);
+    format_nonce(nonce, reinterpret_cast<char*>(blocks + tail_len));
+    return nblocks;
+}
+
+// 计算随机数对应的 32 字节摘要
+void MiningKernel::hash(long nonce, unsigned char* digest) const {
+    unsigned char blocks[128];
+    int nblocks = prepare_tail(nonce, nonce_length(nonce), blocks);
+    sha256_impls()[0].hash_lanes(midstate, blocks, nblocks, digest);
+}
+
+// 批量计算 count(不超过 lanes) 个随机数的摘要
+void MiningKernel::hash_batch(const long* nonces, int count, unsigned char* digests) const {
+    int lanes = impl->lanes;
+    // 各路的块数必须相同; 随机数位数变化时块数可能不同, 此时逐个计算
+    int nblocks = tail_blocks[nonce_length(nonces[0])];
+    bool uniform = count == lanes;
+    for (int i = 1; i < count && uniform; i++) {
+        uniform = tail_blocks[nonce_length(nonces[i])] == nblocks;
+    }
+    if (!uniform) {
+        for (int i = 0; i < count; i++) {
+            hash(nonces[i], digests + i * 32);
+        }
+        return;
+    }
+    alignas(64) unsigned char blocks[SHA256_MAX_LANES * 128];
+    for (int i = 0; i < lanes; i++) {
+        prepare_tail(nonces[i], nonce_length(nonces[i]), blocks + i * nblocks * 64);
+    }
+    impl->hash_lanes(midstate, blocks, nblocks, digests);
+}
+
+// 检查摘要是否小于目标值
+bool MiningKernel::meets_target(const unsigned char* digest) const {
+    return memcmp(digest, target, sizeof(target)) < 0;
+}
+
+// 随机数 16 进制字符串的长度
+int nonce_length(long nonce) {
+    int len = 1;
+    unsigned long v = static_cast<unsigned long>(nonce) >> 4;
+    while (v != 0) {
+        len++;
+        v >>= 4;
+    }
+    return len;
+}
+
+// 随机数转换为 16 进制字符串(小写, 无前导零), 返回长度
+int format_nonce(long nonce, char* buf) {
+    static const char digits[] = "0123456789abcdef";
+    char tmp[16];
+    int len = 0;
+    unsigned long v = static_cast<unsigned long>(nonce);
+    do {
+        tmp[len++] = digits[v & 0xf];
+        v >>= 4;
+    } while (v != 0);
+    for (int i = 0; i < len; i++) {
+        buf[i] = tmp[len - 1 - i];
+    }
+    return len;
+}
+
+ProofOfWork::ProofOfWork(Block* block, int target_bits) {
     this->block = block;
+    this->target_bits = target_bits;
+    this->hashes = 0;
+    this->elapsed_secs = 0;
 }
 
-// 调整随机数
-vector<unsigned char> ProofOfWork::prepare_data(long nonce) {
-    block->nonce = nonce;
+ProofOfWork::ProofOfWork(Block* block) : ProofOfWork(block, targetBit) {}
+
+// 哈希按文本形式(16 进制, 创世区块的前一个区块为 "None")参与计算
+static void append_hash(vector<unsigned char>& bytes, const Hash256& hash) {
+    string text = hash.to_string();
+    bytes.insert(bytes.end(), std::begin(text), std::end(text));
+}
+
+// 前缀末尾的时间戳和难度
+static void append_tail(vector<unsigned char>& bytes, long timestamp, int target_bits) {
+    string timestamp_str = to_string(timestamp);
+    bytes.insert(bytes.end(), std::begin(timestamp_str), std::end(timestamp_str));
+    string targetbit_str = to_hex(target_bits);
+    bytes.insert(bytes.end(), std::begin(targetbit_str), std::end(targetbit_str));
+}
+
+// 按前缀和随机数重新计算哈希, 检查与记录的哈希一致并且满足难度
+static bool check_hash(const vector<unsigned char>& prefix, int target_bits, long nonce, const Hash256& hash) {
+    if (nonce < 0) {
+        return false;
+    }
+    const MiningKernel kernel(prefix, target_bits);
+    unsigned char digest[32];
+    kernel.hash(nonce, digest);
+    return kernel.meets_target(digest) && Hash256::from_raw(digest) == hash;
+}
+
+// 区块数据中除随机数以外的固定前缀
+vector<unsigned char> ProofOfWork::prepare_prefix() {
     vector<unsigned char> bytes;
-    bytes.insert(bytes.end(), std::begin(block->pre_block_hash), std::end(block->pre_block_hash));
+    append_hash(bytes, block->pre_block_hash);
     // tx_hash
     for (auto tx : block->transactions) {
-        bytes.insert(bytes.end(), std::begin(tx->id), std::end(tx->id));
+        append_hash(bytes, tx->id);
     }
-    // timestamp
-    string timestamp_str = to_string(block->timestamp);
-    bytes.insert(bytes.end(), std::begin(timestamp_str), std::end(timestamp_str));
-    // targetBit
-    string targetbit_str = to_hex(targetBit);
-    bytes.insert(bytes.end(), std::begin(targetbit_str), std::end(targetbit_str));
-    // nonce
-    string nonce_str = to_hex(nonce);
-    bytes.insert(bytes.end(), std::begin(nonce_str), std::end(nonce_str));
+    append_tail(bytes, block->timestamp, target_bits);
+    // nonce 由挖矿内核追加
     return bytes;     
 }
 
-// 运行挖矿
-pair<long, string> ProofOfWork::run() {
-    mpz_t hashInt;
-    mpz_init(hashInt);
-    string hash;
-    long nonce = 0;
-
-    while (nonce < LONG_MAX) {
-        auto data = prepare_data(nonce);
-        hash = sha256_digest_hex(data);
-        // 将 hash 转换为 GMP 数字
-        mpz_set_str(hashInt, hash.c_str(), 16);
-        if (mpz_cmp(hashInt, target) < 0) {
-            break;
-        } else {
-            nonce++;
+// 运行挖矿, 线程数由配置决定
+pair<long, Hash256> ProofOfWork::run() {
+    return run(Config::get_instance()->get_mining_threads());
+}
+
+// 多线程运行挖矿
+// 第 k 个线程尝试 k, k + threads, k + 2 * threads ... 的随机数. 找到有效随机数后记录最小值,
+// 各线程越过该值即停止, 因此最终结果就是单线程顺序搜索的结果.
+pair<long, Hash256> ProofOfWork::run(int threads) {
+    return run(threads, nullptr);
+}
+
+// 可取消的挖矿, 每批随机数计算前检查一次取消标志
+pair<long, Hash256> ProofOfWork::run(int threads, const std::atomic<bool>* cancel) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<long> best_nonce(LONG_MAX);
+    std::atomic<long> total_hashes(0);
+    vector<Hash256> found_hashes(threads);
+    vector<long> found_nonces(threads, LONG_MAX);
+    const MiningKernel kernel(prepare_prefix(), target_bits);
+    const int lanes = kernel.lanes();
+
+    auto worker = [&](int k) {
+        long nonces[SHA256_MAX_LANES];
+        unsigned char digests[SHA256_MAX_LANES * 32];
+        long count = 0;
+        bool found = false;
+        // 每批计算 lanes 个属于本线程的随机数
+        for (long base = k; !found && base < best_nonce.load(std::memory_order_relaxed); base += (long)threads * lanes) {
+            if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+                break;
+            }
+            int n = 0;
+            for (; n < lanes && base <= LONG_MAX - (long)n * threads; n++) {
+                nonces[n] = base + (long)n * threads;
+            }
+            kernel.hash_batch(nonces, n, digests);
+            count += n;
+            for (int i = 0; i < n; i++) {
+                if (!kernel.meets_target(digests + i * 32)) {
+                    continue;
+                }
+                long nonce = nonces[i];
+                found_nonces[k] = nonce;
+                found_hashes[k] = Hash256::from_raw(digests + i * 32);
+                // 只保留最小的有效随机数
+                long current = best_nonce.load();
+                while (nonce < current && !best_nonce.compare_exchange_weak(current, nonce)) {
+                }
+                found = true;
+                break;
+            }
+            if (base > LONG_MAX - (long)threads * lanes) {
+                break;
+            }
+        }
+        total_hashes += count;
+    };
+
+    vector<std::thread> workers;
+    for (int k = 1; k < threads; k++) {
+        workers.emplace_back(worker, k);
+    }
+    worker(0);
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    int winner = 0;
+    for (int k = 1; k < threads; k++) {
+        if (found_nonces[k] < found_nonces[winner]) {
+            winner = k;
         }
     }
-    // 释放内存
-    mpz_clear(hashInt);
-    return make_pair(nonce, hash);
+    this->hashes = total_hashes.load();
+    this->elapsed_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // 取消时即使部分线程已找到随机数也不能采用, 更小的随机数可能还未搜索
+    if (cancel != nullptr && cancel->load()) {
+        return make_pair(-1L, Hash256());
+    }
+    return make_pair(found_nonces[winner], found_hashes[winner]);
+}
+
+// 校验区块的随机数和哈希
+bool ProofOfWork::validate() {
+    return check_hash(prepare_prefix(), target_bits, block->nonce, block->hash);
+}
+
+// 上一次挖矿尝试的哈希次数
+long ProofOfWork::get_hashes() {
+    return hashes;
+}
+
+// 上一次挖矿的哈希速率(次/秒)
+double ProofOfWork::get_hash_rate() {
+    if (elapsed_secs <= 0) {
+        return 0;
+    }
+    return hashes / elapsed_secs;
 }
 
 ProofOfWork::~ProofOfWork() {
-    mpz_clear(target);
 }
 
+// 哈希是否满足当前难度
+// 哈希小于 1 << (256 - targetBit), 即前 targetBit 位为零
+bool hash_meets_target(const Hash256& hash) {
+    for (int bit = 0; bit < targetBit; bit++) {
+        if (hash.bytes[bit / 8] & (0x80 >> (bit % 8))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 校验区块头: 用区块头中的前一个区块哈希, 交易 ID, 时间戳和随机数重新计算哈希
+bool validate_header(const BlockHeader& header) {
+    vector<unsigned char> bytes;
+    append_hash(bytes, header.pre_block_hash);
+    for (auto& id : header.tx_ids) {
+        append_hash(bytes, id);
+    }
+    append_tail(bytes, header.timestamp, targetBit);
+    return check_hash(bytes, targetBit, header.nonce, header.hash);
+}
+
+// 单个区块的工作量, 即找到有效哈希的期望尝试次数
+long block_work() {
+    return 1L << targetBit;
+}
@@ -1,21 +1,90 @@
 #pragma once
 
-#include <gmp.h>
+#include <atomic>
 #include "block.h"
+#include "sha256.h"
+
+// 挖矿内核
+// 区块数据中只有随机数会变化, 因此预先计算固定前缀的 SHA-256 中间状态(midstate),
+// 每次尝试只追加随机数的 16 进制字符串, 并直接按字节比较摘要与目标值, 循环内没有内存分配.
+// 多个随机数按批次交给多路 SHA-256 实现(SSE4/AVX2/AVX-512/SHA-NI)并行计算, 实现在运行时按 CPU 特性选择.
+class MiningKernel {
+public:
+    MiningKernel(const vector<unsigned char>& prefix, int target_bits);
+
+    // 指定 SHA-256 实现
+    MiningKernel(const vector<unsigned char>& prefix, int target_bits, const Sha256Impl& impl);
+
+    // 一批并行计算的随机数个数
+    int lanes() const;
+
+    // 计算随机数对应的 32 字节摘要
+    void hash(long nonce, unsigned char* digest) const;
+
+    // 批量计算 count(不超过 lanes) 个随机数的摘要, 第 i 个摘要写入 digests + i * 32
+    void hash_batch(const long* nonces, int count, unsigned char* digests) const;
+
+    // 检查摘要是否小于目标值
+    bool meets_target(const unsigned char* digest) const;
+
+private:
+    const Sha256Impl* impl;
+    uint32_t midstate[8]; // 前缀中完整块的压缩结果
+    int tail_len; // 前缀中不足一块的剩余字节数
+    unsigned char tails[17][128]; // 按随机数长度预先填充好的尾部块, 只需写入随机数
+    int tail_blocks[17]; // 尾部块数(1 或 2)
+    unsigned char target[32];
+
+    // 填充随机数所在的尾部块, 返回块数
+    int prepare_tail(long nonce, int nonce_len, unsigned char* blocks) const;
+};
+
+// 随机数转换为 16 进制字符串(小写, 无前导零), 返回长度
+int format_nonce(long nonce, char* buf);
+
+// 随机数 16 进制字符串的长度
+int nonce_length(long nonce);
 
 // 工作量证明
 class ProofOfWork {
 public:
+    ProofOfWork(Block* block, int target_bits);
     ProofOfWork(Block* block);
     ~ProofOfWork();
 
-    // 运行挖矿
-    pair<long, string> run();
+    // 运行挖矿, 线程数由配置决定
+    pair<long, Hash256> run();
+
+    // 多线程运行挖矿, 返回满足难度的最小随机数, 结果与线程数无关
+    pair<long, Hash256> run(int threads);
+
+    // 可取消的挖矿, cancel 被置位后尽快返回 (-1, 空哈希)
+    pair<long, Hash256> run(int threads, const std::atomic<bool>* cancel);
+
+    // 校验区块的随机数和哈希: 重新计算哈希, 与区块记录的哈希一致并且满足难度
+    bool validate();
+
+    // 上一次挖矿尝试的哈希次数
+    long get_hashes();
+
+    // 上一次挖矿的哈希速率(次/秒)
+    double get_hash_rate();
 private:
     Block* block;
-    mpz_t  target;
+    int    target_bits;
+    long   hashes;
+    double elapsed_secs;
 
-    // 调整随机数
-    vector<unsigned char> prepare_data(long nonce);
+    // 区块数据中除随机数以外的固定前缀
+    vector<unsigned char> prepare_prefix();
 };
 
+// 哈希是否满足当前难度(只检查哈希本身, 不重新计算)
+bool hash_meets_target(const Hash256& hash);
+
+// 校验区块头的工作量证明: 由区块头携带的字段(含交易 ID)重新计算哈希, 与记录的哈希一致并且满足难度.
+// 高度不参与哈希计算, 由调用方按父区块检查
+bool validate_header(const BlockHeader& header);
+
+// 单个区块的工作量, 即找到有效哈希的期望尝试次数
+long block_work();
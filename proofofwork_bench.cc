@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <gmp.h>
+#include <chrono>
+#include <thread>
+#include "block.h"
+#include "proofofwork.h"
+#include "util.h"
+
+// blockchain_bench --gtest_filter=ProofOfWorkBench.threads
+TEST(ProofOfWorkBench, threads) {
+    // 提高难度, 使单次挖矿有足够的哈希次数
+    const int target_bits = 18;
+    Block block;
+    block.timestamp = current_timestamp();
+    block.pre_block_hash = Hash256::sha256(string("pre"));
+    block.height = 1;
+    Transaction* tx = new Transaction();
+    tx->id = Hash256::sha256(string("tx"));
+    block.transactions.push_back(tx);
+
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    long expected_nonce = -1;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        ProofOfWork pow(&block, target_bits);
+        auto ans = pow.run(threads);
+        // 结果与线程数无关
+        if (expected_nonce < 0) {
+            expected_nonce = ans.first;
+        }
+        EXPECT_EQ(expected_nonce, ans.first);
+        std::cout << "threads = " << threads << ", nonce = " << ans.first << ", hashes = " << pow.get_hashes()
+                  << ", rate = " << static_cast<long>(pow.get_hash_rate()) << " hashes/s" << std::endl;
+    }
+}
+
+// blockchain_bench --gtest_filter=ProofOfWorkBench.kernel
+TEST(ProofOfWorkBench, kernel) {
+    const long attempts = 200000;
+    const int target_bits = 8;
+    // 固定前缀: 前一个区块哈希 + 交易 ID + 时间戳 + 难度
+    string prefix_str = string(64, '0') + string(64, 'a') + to_string(current_timestamp()) + to_hex(target_bits);
+    vector<unsigned char> prefix(prefix_str.begin(), prefix_str.end());
+
+    // 原有实现: 每次尝试重新拼接数据, 16 进制编码摘要后再解析为 GMP 整数比较
+    mpz_t target, hash_int;
+    mpz_init(target);
+    mpz_init(hash_int);
+    mpz_ui_pow_ui(target, 2, 256 - target_bits);
+    auto start = std::chrono::steady_clock::now();
+    long legacy_found = 0;
+    for (long nonce = 0; nonce < attempts; nonce++) {
+        vector<unsigned char> data(prefix);
+        string nonce_str = to_hex(nonce);
+        data.insert(data.end(), nonce_str.begin(), nonce_str.end());
+        string hash = sha256_digest_hex(data);
+        mpz_set_str(hash_int, hash.c_str(), 16);
+        legacy_found += mpz_cmp(hash_int, target) < 0;
+    }
+    double legacy_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    mpz_clear(target);
+    mpz_clear(hash_int);
+
+    std::cout << "legacy: " << static_cast<long>(attempts / legacy_secs) << " hashes/s" << std::endl;
+
+    // 挖矿内核: 中间状态 + 预分配缓冲区 + 字节比较, 按批次使用各个 SHA-256 实现
+    for (auto& impl : sha256_impls()) {
+        MiningKernel kernel(prefix, target_bits, impl);
+        long nonces[SHA256_MAX_LANES];
+        unsigned char digests[SHA256_MAX_LANES * 32];
+        start = std::chrono::steady_clock::now();
+        long kernel_found = 0;
+        for (long base = 0; base < attempts; base += kernel.lanes()) {
+            for (int i = 0; i < kernel.lanes(); i++) {
+                nonces[i] = base + i;
+            }
+            kernel.hash_batch(nonces, kernel.lanes(), digests);
+            for (int i = 0; i < kernel.lanes(); i++) {
+                kernel_found += nonces[i] < attempts && kernel.meets_target(digests + i * 32);
+            }
+        }
+        double kernel_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_EQ(legacy_found, kernel_found);
+        std::cout << "kernel " << impl.name << " (" << impl.lanes << " lanes): " 
+                  << static_cast<long>(attempts / kernel_secs) << " hashes/s" << std::endl;
+    }
+}
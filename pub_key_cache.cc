@@ -0,0 +1,72 @@
+#include "pub_key_cache.h"
+#include "util.h"
+
+PubKeyCache::PubKeyCache(size_t capacity) : capacity(capacity), hit_count(0), miss_count(0) {}
+
+PubKeyCache::~PubKeyCache() {
+    for (auto& entry : entries) {
+        EC_KEY_free(entry.second);
+    }
+}
+
+// 全局缓存
+PubKeyCache* PubKeyCache::get_instance() {
+    static PubKeyCache instance(DEFAULT_PUB_KEY_CACHE_SIZE);
+    return &instance;
+}
+
+// 获取解码后的公钥
+EC_KEY* PubKeyCache::get(ByteSpan public_key) {
+    string key(public_key.begin(), public_key.end());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            hit_count++;
+            entries.splice(entries.begin(), entries, it->second);
+            EC_KEY_up_ref(it->second->second);
+            return it->second->second;
+        }
+        miss_count++;
+    }
+    // 解码不持有锁, 两个线程同时解码同一个公钥时只保留先写入的
+    EC_KEY* eckey = ecdsa_p256_public_key(public_key);
+    if (eckey == nullptr || capacity == 0) {
+        return eckey;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        EC_KEY_free(eckey);
+        eckey = it->second->second;
+        entries.splice(entries.begin(), entries, it->second);
+    } else {
+        entries.push_front(make_pair(key, eckey));
+        index[key] = entries.begin();
+        while (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            EC_KEY_free(entries.back().second);
+            entries.pop_back();
+        }
+    }
+    EC_KEY_up_ref(eckey);
+    return eckey;
+}
+
+// 缓存的公钥数量
+size_t PubKeyCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+// 命中次数
+uint64_t PubKeyCache::hits() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hit_count;
+}
+
+// 未命中次数
+uint64_t PubKeyCache::misses() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return miss_count;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <openssl/ec.h>
+#include "codec.h"
+
+using namespace std;
+
+// 默认的公钥缓存容量(个)
+const size_t DEFAULT_PUB_KEY_CACHE_SIZE = 10000;
+
+// 已解码公钥的 LRU 缓存
+// 键为序列化的公钥字节, 值为解码后的 EC_KEY. 同一个地址的交易反复使用同一个公钥,
+// 缓存后验证签名时不必每次新建 EC_KEY 并从字节解码椭圆曲线上的点.
+// get 返回的 EC_KEY 增加了引用计数, 调用方用完后 EC_KEY_free, 缓存淘汰它时不影响正在使用的线程.
+class PubKeyCache {
+public:
+    PubKeyCache(size_t capacity);
+    ~PubKeyCache();
+
+    PubKeyCache(const PubKeyCache&) = delete;
+    PubKeyCache& operator=(const PubKeyCache&) = delete;
+
+    // 全局缓存
+    static PubKeyCache* get_instance();
+
+    // 获取解码后的公钥, 公钥无效时返回 nullptr
+    EC_KEY* get(ByteSpan public_key);
+
+    // 缓存的公钥数量
+    size_t size();
+
+    // 命中次数
+    uint64_t hits();
+
+    // 未命中次数
+    uint64_t misses();
+
+private:
+    typedef list<pair<string, EC_KEY*>> Entries;
+
+    size_t capacity;
+    std::mutex mutex; // 保护以下全部字段
+    Entries entries; // 按最近使用排列, 最近使用的在前
+    unordered_map<string, Entries::iterator> index;
+    uint64_t hit_count;
+    uint64_t miss_count;
+};
@@ -1,29 +1,53 @@
 #include "json/value.h"
 #include "json/writer.h"
 #include <json/json.h>
+#include <atomic>
 #include <cstddef>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <string>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 #include "config.h"
 #include "memory_pool.h"
+#include "proofofwork.h"
 #include "server.h"
+#include "signature_verifier.h"
+#include "tcp_transport.h"
 #include "transaction.h"
 #include "utxo_set.h"
 #include "config.h"
 #include "util.h"
 
 // 版本号
-const uint8_t NODE_VERSION = 1;
+const uint8_t NODE_VERSION = 3;
 
-// 内存池中的交易阈值, 触发矿工挖新区块
-const uint8_t TRANSACTION_THRESHOLD = 2;
+// 支持区块头同步(GetHeaders/Headers, 区块头携带交易 ID)的最低版本号
+const uint8_t HEADERS_VERSION = 3;
 
-// 最大报文长度
-const size_t MAXLINE = 2048;
+// 单条 Headers 消息中的最大区块头数量
+const size_t MAX_HEADERS_PER_MESSAGE = 500;
+
+// 单条 Headers 消息中区块头编码的最大字节数, base64 编码后不超过一个 UDP 报文
+const size_t MAX_HEADERS_BYTES = 45000;
+
+// 最大报文长度(UDP 报文的最大载荷), 更大的区块需要使用 TCP 传输
+const size_t MAXLINE = 65507;
+
+// 单次 epoll_wait 返回的最大事件数
+const int MAX_EVENTS = 64;
+
+// 定时任务的间隔(毫秒)
+const int TICK_INTERVAL_MS = 1000;
+
+// 输出统计的间隔(定时任务的次数)
+const int STATS_TICKS = 60;
 
 // 报文类型
 enum class PackageType: uint8_t {
@@ -33,6 +57,8 @@ enum class PackageType: uint8_t {
     Inv = 4,
     Tx = 5,
     Version = 6,
+    GetHeaders = 7,
+    Headers = 8,
 };
 
 Server::Server(string addr, Blockchain* bc, UTXOSet* utxo, MemoryPool* tx_pool) {
@@ -42,19 +68,31 @@ Server::Server(string addr, Blockchain* bc, UTXOSet* utxo, MemoryPool* tx_pool)
     this->utxo = utxo;
     this->addr = addr;
     this->tx_pool = tx_pool;
+    // 区块下载器, 只在持有 chain_mutex 时访问
+    this->downloader.reset(new BlockDownloader(
+        Config::get_instance()->get_download_window(),
+        [](const string& peer, const Hash256& hash) { send_get_data(peer, OpType::Block, hash); },
+        [bc](const Hash256& hash) { return bc->has_block(hash); }));
 }
 
 // 创建服务器
 Server* Server::new_server(string addr, Blockchain* bc) {
-    MemoryPool* tx_pool = MemoryPool::new_memory_pool();
+    Config* config = Config::get_instance();
+    MemoryPool* tx_pool = MemoryPool::new_memory_pool(config->get_mempool_max_usage(), config->get_mempool_expiry());
     UTXOSet* utxo = UTXOSet::new_utxo_set(bc);
     return new Server(addr, bc, utxo, tx_pool);
 }
 
+// 收到 SIGINT 或 SIGTERM 后置位, 事件循环据此退出
+static std::atomic<bool> stop_requested(false);
+
+static void request_stop(int) {
+    stop_requested = true;
+}
+
 void Server::run() { 
-    struct sockaddr_in servaddr, cliaddr;
+    struct sockaddr_in servaddr;
     memset(&servaddr, 0, sizeof(servaddr));
-    memset(&cliaddr, 0, sizeof(cliaddr));
 
     // 服务器地址
     if (!parse_address(addr, servaddr)) {
@@ -75,31 +113,261 @@ void Server::run() {
         exit(1);
     }
 
+    // 非阻塞模式, 由 epoll 通知可读
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        std::cerr << "set socket non-blocking failed" << std::endl;
+        exit(1);
+    }
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        std::cerr << "epoll creation failed" << std::endl;
+        exit(1);
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = sockfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        std::cerr << "epoll_ctl failed" << std::endl;
+        exit(1);
+    }
+    // TCP 传输: 同时监听相同地址的 TCP 端口, UDP 报文仍然可以接收
+    int listenfd = -1;
+    if (Config::get_instance()->use_tcp()) {
+        listenfd = listen_tcp(addr);
+        ev.data.fd = listenfd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &ev) < 0) {
+            std::cerr << "epoll_ctl failed" << std::endl;
+            exit(1);
+        }
+    }
+
+    // 处理消息的工作线程
+    int worker_threads = Config::get_instance()->get_worker_threads();
+    workers.reset(new ThreadPool(worker_threads));
+
     // 发送 VERSION 消息
     if (addr != CENTERAL_NODE) {
-        long height = bc->get_last_height();
+        long height;
+        {
+            std::lock_guard<std::mutex> lock(chain_mutex);
+            height = bc->get_last_height();
+        }
         std::cout << "send version height: " << height << std::endl;
         send_version(CENTERAL_NODE, height);
     }
-    std::cout << "Start node server on " << addr << std::endl;
-    // 接收报文
+    // 启动后台矿工
+    if (Config::get_instance()->is_miner()) {
+        miner.reset(new Miner(bc, utxo, tx_pool, chain_mutex));
+        miner->set_on_mined([this](Block* block) {
+            // 广播区块
+            string node_addr = Config::get_instance()->get_node_address();
+            vector<string> targets;
+            for (auto node : nodes) {
+                // 过滤当前节点
+                if (node == node_addr) {
+                    continue;
+                }
+                targets.push_back(node);
+            }
+            broadcast_inv(targets, OpType::Block, vector<Hash256>{block->hash});
+        });
+        miner->start();
+    }
+    std::cout << "Start node server on " << addr << " (" << Config::get_instance()->get_transport() << ") with " 
+              << worker_threads << " workers" << std::endl;
+
+    // 收到 SIGINT 或 SIGTERM 时, epoll_wait 被中断或者在下一个定时周期内返回, 事件循环随后退出
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    // 事件循环: 只负责收包和分发, 消息处理全部交给工作线程
+    struct epoll_event events[MAX_EVENTS];
+    auto last_tick = std::chrono::steady_clock::now();
+    long ticks = 0;
+    while (!stop_requested) {
+        int nfds = epoll_wait(epfd, events, MAX_EVENTS, TICK_INTERVAL_MS);
+        if (nfds < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error in epoll_wait" << std::endl;
+            close(epfd);
+            close(sockfd);
+            exit(1);
+        }
+        for (int i = 0; i < nfds; i++) {
+            int fd = events[i].data.fd;
+            if (fd == sockfd) {
+                read_datagrams(sockfd);
+            } else if (fd == listenfd) {
+                accept_connections(epfd, listenfd);
+            } else {
+                read_stream(epfd, fd);
+            }
+        }
+        // 定时任务交给工作线程, 检查超时的区块请求和过期的交易
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_tick >= std::chrono::milliseconds(TICK_INTERVAL_MS)) {
+            last_tick = now;
+            bool report = ++ticks % STATS_TICKS == 0;
+            workers->submit([this, now, report]() {
+                std::lock_guard<std::mutex> lock(chain_mutex);
+                downloader->tick(now, download_peers(""));
+                // 下载全部结束后仍没有区块体的区块头不会再接入, 删除它们
+                if (downloader->in_flight() == 0 && downloader->queued() == 0 && downloader->buffered() == 0) {
+                    if (bc->unconnected_header_count() > 0) {
+                        std::cout << "Pruned " << bc->prune_headers() << " headers without blocks" << std::endl;
+                    }
+                    resume_header_sync();
+                }
+                size_t expired = tx_pool->expire(now);
+                if (expired > 0) {
+                    std::cout << "Expired " << expired << " transactions from the pool" << std::endl;
+                }
+                if (report) {
+                    print_stats();
+                }
+            });
+        }
+    }
+
+    std::cout << "Shutting down node server on " << addr << std::endl;
+    // 先执行完排队的消息并停止矿工, 之后不会再有区块连接, 再把 UTXO 缓存写回数据库
+    workers.reset();
+    miner.reset();
+    {
+        std::lock_guard<std::mutex> lock(chain_mutex);
+        utxo->flush();
+    }
+    for (auto& kv : tcp_peers) {
+        close(kv.first);
+    }
+    tcp_peers.clear();
+    if (listenfd >= 0) {
+        close(listenfd);
+    }
+    close(epfd);
+    close(sockfd);
+}
+
+// 读取 socket 中所有已到达的报文, 交给工作线程处理
+void Server::read_datagrams(int sockfd) {
     char buffer[MAXLINE];
-    socklen_t len = sizeof(cliaddr);
     while (true) {
-        int n = recvfrom(sockfd, (char *)buffer, MAXLINE, MSG_WAITALL, (struct sockaddr *)&cliaddr, &len);
+        struct sockaddr_in cliaddr;
+        socklen_t len = sizeof(cliaddr);
+        int n = recvfrom(sockfd, buffer, MAXLINE, 0, (struct sockaddr *)&cliaddr, &len);
         if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
             std::cerr << "Error in recvfrom" << std::endl;
             close(sockfd);
             exit(1);
-        } else if (n == 0) {
-            std::cout << "Client closed the connection" << std::endl;
-            close(sockfd);
-            exit(1);
         }
- 
-        // 处理接收到的消息
-        this->serve(cliaddr, vector<unsigned char>(buffer, buffer + n));
+        dispatch(cliaddr, vector<unsigned char>(buffer, buffer + n));
+    }
+}
+
+// 接受所有等待中的 TCP 连接
+void Server::accept_connections(int epfd, int listenfd) {
+    while (true) {
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int fd = accept4(listenfd, (struct sockaddr *)&peer, &len, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // EAGAIN: 没有更多连接; 其他错误(如文件描述符耗尽)等待下次事件
+            return;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        tcp_peers[fd].addr = peer;
+    }
+}
+
+// 读取 TCP 连接上已到达的数据, 切分出完整的帧交给工作线程处理
+void Server::read_stream(int epfd, int fd) {
+    auto it = tcp_peers.find(fd);
+    if (it == tcp_peers.end()) {
+        return;
+    }
+    TcpPeer& peer = it->second;
+    char buffer[MAXLINE];
+    bool closed = false;
+    vector<unsigned char> frame;
+    while (!peer.reader.failed()) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            // 每次读取后立即切分, 缓冲区最多保存一个未收完的帧
+            peer.reader.append(buffer, n);
+            while (peer.reader.next(frame)) {
+                dispatch(peer.addr, std::move(frame));
+            }
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        // 对端关闭或连接出错
+        closed = true;
+        break;
+    }
+    if (peer.reader.failed()) {
+        std::cout << "Frame too large from " << sockaddr_tostring(peer.addr) << ", closing connection" << std::endl;
+        closed = true;
+    }
+    if (closed) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        tcp_peers.erase(it);
+    }
+}
+
+// 将一条消息交给工作线程处理
+void Server::dispatch(struct sockaddr_in addr, vector<unsigned char> data) {
+    // 空消息没有类型字节, 丢弃
+    if (data.empty()) {
+        return;
     }
+    workers->submit([this, addr, data = std::move(data)]() {
+        this->serve(addr, data);
+    });
+}
+
+// 解析消息中的 16 进制哈希列表, 任一哈希格式错误时返回 false
+static bool parse_hashes(const Json::Value& values, vector<Hash256>& hashes) {
+    if (!values.isArray()) {
+        return values.isNull();
+    }
+    for (auto& value : values) {
+        Hash256 hash;
+        if (!Hash256::from_hex(value.asString(), hash)) {
+            return false;
+        }
+        hashes.push_back(hash);
+    }
+    return true;
 }
 
 // 处理接收到的消息
@@ -121,25 +389,85 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                     std::cout << "Error in parsing block." << std::endl;
                     return;
                 }
-                bc->add_block(block.get());
-                std::cout << "Added block " << block->hash << std::endl;
+                // 重新计算工作量证明, 区块内容必须与哈希(以及已同步的区块头)一致
+                if (!ProofOfWork(block.get()).validate()) {
+                    std::cout << "Invalid proof of work in block " << block->hash << std::endl;
+                    return;
+                }
+                // 乱序到达的区块先由下载器缓存, 父区块接入后按高度顺序放行
+                vector<Block*> ready;
+                {
+                    std::lock_guard<std::mutex> lock(chain_mutex);
+                    ready = downloader->on_block(block.release());
+                }
+                size_t connected_count = 0;
+                set<Hash256> rejected;
+                for (size_t pos = 0; pos < ready.size(); pos++) {
+                    unique_ptr<Block> connected(ready[pos]);
+                    // 接在无效区块之后的区块一并丢弃, 其他分叉上的区块不受影响
+                    if (rejected.count(connected->pre_block_hash)) {
+                        rejected.insert(connected->hash);
+                        continue;
+                    }
+                    // 区块体必须与同步来的区块头一致, 高度接在父区块之后
+                    if (!bc->check_header(connected.get())) {
+                        std::cout << "Rejected block " << connected->hash << ": does not match its header" << std::endl;
+                        rejected.insert(connected->hash);
+                        continue;
+                    }
+                    // 并行验证区块内全部输入的签名, 不持有 chain_mutex. 父区块已经接入, 引用的交易都可以从交易索引查到
+                    VerifyResult result = SignatureVerifier::get_instance()->verify(connected->transactions, bc);
+                    if (!result.ok) {
+                        std::cout << "Rejected block " << connected->hash << ": invalid transaction " << result.failed_txid << std::endl;
+                        rejected.insert(connected->hash);
+                        continue;
+                    }
+                    std::cout << "Verified block " << connected->hash << ": " << result.inputs << " inputs (" << result.cached << " cached) in "
+                              << result.micros / 1000.0 << " ms" << std::endl;
 
-                // 继续区块下载
-                if (blocks_in_transit.size() > 0) {
-                    string block_hash = blocks_in_transit.front();
-                    send_get_data(addr_from, OpType::Block, block_hash);
-                    // 从下载队列中移除
-                    blocks_in_transit.erase(blocks_in_transit.begin()); 
-                } else {
-                    // 区块全部下载后, 再重建索引
-                    utxo->reindex();
+                    // 只在接入链时持有 chain_mutex
+                    std::lock_guard<std::mutex> lock(chain_mutex);
+                    // 接在 UTXO 集最新区块之后的区块, 每个输入都必须引用未花费的输出
+                    if (!utxo->check_inputs(connected.get())) {
+                        std::cout << "Rejected block " << connected->hash << ": spends a missing or spent output" << std::endl;
+                        rejected.insert(connected->hash);
+                        continue;
+                    }
+                    connected_count++;
+                    bc->add_block(connected.get());
+                    std::cout << "Added block " << connected->hash << std::endl;
+                    // 增量更新 UTXO 集, 后面的区块按更新后的 UTXO 集检查
+                    if (!utxo->sync()) {
+                        std::cout << "UTXO set stopped before an invalid block" << std::endl;
+                    }
+                    // 已上链的交易移出内存池, 并驱逐与之冲突的交易
+                    size_t evicted = tx_pool->remove_confirmed(connected->transactions);
+                    if (evicted > 0) {
+                        std::cout << "Evicted " << evicted << " conflicting transactions" << std::endl;
+                    }
+                    // 验证期间到达的子区块在父区块接入前被缓存, 现在放行
+                    vector<Block*> children = downloader->on_connected(connected->hash);
+                    ready.insert(ready.end(), children.begin(), children.end());
+                }
+
+                std::lock_guard<std::mutex> lock(chain_mutex);
+                if (connected_count > 0) {
+                    resume_header_sync();
+                    // 竞争区块占用了正在挖的高度, 重新开始挖矿
+                    if (miner != nullptr) {
+                        miner->on_new_tip(bc->get_last_height());
+                    }
                 }
+
+                // 继续区块下载, 补满请求窗口
+                downloader->schedule(download_peers(addr_from));
                 break;
             }
         case PackageType::GetBlocks:
             {
                 string addr_from = string(data.begin() + 1, data.end());
-                vector<string> block_hashes = bc->get_block_hashes();
+                std::lock_guard<std::mutex> lock(chain_mutex);
+                vector<Hash256> block_hashes = bc->get_block_hashes();
                 send_inv(addr_from, OpType::Block, block_hashes);
                 break;
             }
@@ -153,11 +481,16 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                 }
                 string addr_from = root["addr_from"].asString();
                 OpType otype = static_cast<OpType>(root["op_type"].asInt());
-                string id = root["id"].asString();
+                Hash256 id;
+                if (!Hash256::from_hex(root["id"].asString(), id)) {
+                    std::cout << "Invalid get data." << std::endl;
+                    return;
+                }
                 switch (otype) {
                     case OpType::Block:
                         {
-                            unique_ptr<Block> block(bc->get_block(id));
+                            // 只读取数据库, 不需要持有 chain_mutex
+                            shared_ptr<Block> block = bc->get_block(id);
                             if (block == nullptr) {
                                 std::cout << "Block not found." << std::endl;
                                 return;
@@ -167,6 +500,7 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                         }
                     case OpType::Tx:
                         {
+                            std::lock_guard<std::mutex> lock(chain_mutex);
                             auto tx = tx_pool->get(id);
                             if (tx == nullptr) {
                                 std::cout << "Transaction not found." << std::endl;
@@ -191,32 +525,29 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                 }
                 string addr_from = root["addr_from"].asString(); 
                 OpType otype = static_cast<OpType>(root["op_type"].asInt());
-                vector<string> items;
-                if (root["items"].isArray()) {
-                    for (auto item : root["items"]) {
-                        items.push_back(item.asString());
-                    }
+                vector<Hash256> items;
+                if (!parse_hashes(root["items"], items)) {
+                    std::cout << "Invalid package." << std::endl;
+                    return;
                 }
                 if (items.size() == 0) {
                     return;
                 }
+                std::lock_guard<std::mutex> lock(chain_mutex);
                 switch (otype) {
                     // 两种触发情况: 
                     // 1. 当 version 消息检查到区块高度落后时, 会收到全量的 block hash 列表.
                     // 2. 矿工挖出新的区块后, 会将新区块的 hash 广播给其他节点.
                     case OpType::Block:
                         {
-                            blocks_in_transit.insert(blocks_in_transit.end(), items.begin(), items.end());
-                            string block_hash = items.front();
-                            // 下载一个区块
-                            send_get_data(addr_from, OpType::Block, block_hash);
-                            // 从下载队列中移除
-                            blocks_in_transit.erase(blocks_in_transit.begin());
+                            // 列表按从新到旧排列, 倒序加入下载队列, 使父区块先被请求
+                            downloader->add(vector<Hash256>(items.rbegin(), items.rend()));
+                            downloader->schedule(download_peers(addr_from));
                             break;
                         }
                     case OpType::Tx:
                         {
-                            string txid = items.front();
+                            Hash256 txid = items.front();
                             // 检查交易池, 不包含则下载
                             if (!tx_pool->containes(txid)) {
                                 send_get_data(addr_from, OpType::Tx, txid);
@@ -243,12 +574,32 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                     std::cout << "Invalid transaction." << std::endl;
                     return;
                 } 
-                // 将交易添加到内存池
-                tx_pool->add(tx);
+                // 加锁前并行验证签名, 输入是否存在由 compute_fee 检查
+                VerifyResult result = SignatureVerifier::get_instance()->verify(vector<Transaction*>{tx}, nullptr);
+                if (!result.ok) {
+                    std::cout << "Rejected transaction " << tx->id << ": invalid signature" << std::endl;
+                    delete tx;
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(chain_mutex);
+                // 计算手续费, 输入必须来自 UTXO 集或池中的其他交易
+                long fee = 0;
+                if (!compute_fee(tx, fee)) {
+                    std::cout << "Rejected transaction " << tx->id << ": unknown inputs or outputs exceed inputs" << std::endl;
+                    delete tx;
+                    return;
+                }
+                // 将交易添加到内存池, 双花池中交易且手续费不足以替换时拒绝
+                if (!tx_pool->add(tx, fee)) {
+                    std::cout << "Rejected transaction " << tx->id << ": conflicts with the pool or fee rate too low" << std::endl;
+                    delete tx;
+                    return;
+                }
 
                 // 中心节点广播交易
                 string node_addr = Config::get_instance()->get_node_address();
                 if (node_addr == CENTERAL_NODE) {
+                    vector<string> targets;
                     for (auto node : nodes) {
                         // 过滤当前节点
                         if (node == node_addr) {
@@ -258,37 +609,14 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                         if (node == sockaddr_tostring(cliaddr)) {
                             continue;
                         }
-                        // 发送交易
-                        send_inv(node, OpType::Tx, vector<string>{tx->id});
+                        targets.push_back(node);
                     }
+                    // 发送交易
+                    broadcast_inv(targets, OpType::Tx, vector<Hash256>{tx->id});
                 }
-                // 矿工节点(内存池中的交易数量达到阈值, 挖新区块)
-                if (tx_pool->len() >= TRANSACTION_THRESHOLD && Config::get_instance()->is_miner()) {
-                    // 挖矿奖励
-                    string mining_address = Config::get_instance()->get_mining_address();  
-                    Transaction* coinbase_tx = Transaction::new_coinbase_tx(mining_address);
-                    // 内存池中的交易
-                    auto txs = tx_pool->get_all();
-                    txs.push_back(coinbase_tx);
-                    // 挖区块
-                    unique_ptr<Block> new_block(bc->mine_block(txs));
-                    // 重建 UTXO
-                    utxo->reindex();
-                    std::cout << "New block mined: " << new_block->hash << std::endl;
-
-                    // 从内存池中移除交易
-                    for (auto tx : txs) {
-                        tx_pool->remove(tx->id);
-                    }
-                    // 广播区块
-                    for (auto node : nodes) {
-                        // 过滤当前节点
-                        if (node == node_addr) {
-                            continue;
-                        }
-                        // 发送区块
-                        send_inv(node, OpType::Block, vector<string>{new_block->hash});
-                    }
+                // 矿工节点(内存池中的交易数量达到阈值, 由后台矿工挖新区块)
+                if (miner != nullptr && tx_pool->len() >= TRANSACTION_THRESHOLD) {
+                    miner->notify();
                 }
                 break;
             }
@@ -304,11 +632,16 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                 int version = root["version"].asInt();
                 long height = std::stol(root["height"].asString());
                 std::cout << "Version: " << version << ", height: " << height << std::endl;
+                std::lock_guard<std::mutex> lock(chain_mutex);
 
                 long local_height = this->bc->get_last_height();
                 if (height > local_height) {
-                    // 向目标节点请求区块
-                    send_get_blocks(addr_from);
+                    // 先同步区块头, 旧版本节点不支持时直接请求区块列表
+                    if (version >= HEADERS_VERSION) {
+                        send_get_headers(addr_from, bc->get_locator());
+                    } else {
+                        send_get_blocks(addr_from);
+                    }
                 }
                 if (height < local_height) {
                     // 提醒目标节点拉取区块
@@ -318,12 +651,170 @@ void Server::serve(sockaddr_in cliaddr, std::vector<unsigned char> data) {
                 this->add_node(addr_from);
                 break;
             }
+        case PackageType::GetHeaders:
+            {
+                Json::Value root;
+                Json::Reader reader;
+                if (!reader.parse(string(data.begin() + 1, data.end()), root)) {
+                    std::cout << "Invalid get headers." << std::endl;
+                    return;
+                }
+                string addr_from = root["addr_from"].asString();
+                vector<Hash256> locator;
+                if (!parse_hashes(root["locator"], locator)) {
+                    std::cout << "Invalid get headers." << std::endl;
+                    return;
+                }
+                vector<BlockHeader> headers;
+                {
+                    std::lock_guard<std::mutex> lock(chain_mutex);
+                    // 从分叉点之后开始, 没有共同区块时从创世区块开始
+                    long fork_height = bc->find_fork_height(locator);
+                    headers = bc->get_headers(fork_height + 1, MAX_HEADERS_PER_MESSAGE);
+                }
+                send_headers(addr_from, headers);
+                break;
+            }
+        case PackageType::Headers:
+            {
+                Json::Value root;
+                Json::Reader reader;
+                if (!reader.parse(string(data.begin() + 1, data.end()), root)) {
+                    std::cout << "Invalid headers." << std::endl;
+                    return;
+                }
+                string addr_from = root["addr_from"].asString();
+                // 对方没有更多区块头时回复空的 Headers
+                string encoded = root["headers"].asString();
+                if (encoded.empty()) {
+                    return;
+                }
+                vector<unsigned char> bytes;
+                if (!decode_base64(encoded, bytes)) {
+                    std::cout << "Invalid headers." << std::endl;
+                    return;
+                }
+                vector<BlockHeader> headers;
+                Decoder dec(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+                while (dec.remaining() > 0 && headers.size() < MAX_HEADERS_PER_MESSAGE) {
+                    headers.emplace_back();
+                    if (!BlockHeader::decode_with_tx_ids(dec, headers.back())) {
+                        std::cout << "Invalid headers." << std::endl;
+                        return;
+                    }
+                }
+                if (headers.empty()) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(chain_mutex);
+                // 区块下载落后太多时先不保存, 区块接入后从前一个区块头继续请求
+                if (bc->unconnected_header_count() + headers.size() > MAX_UNCONNECTED_HEADERS) {
+                    std::cout << "Too many headers without blocks, pause header sync with " << addr_from << std::endl;
+                    paused_header_peer = addr_from;
+                    paused_header_hash = headers.front().pre_block_hash;
+                    return;
+                }
+                // 先校验区块头链, 再并行下载区块体
+                if (!bc->add_headers(headers)) {
+                    std::cout << "Invalid header chain from " << addr_from << std::endl;
+                    return;
+                }
+                std::cout << "Received " << headers.size() << " headers up to height " << headers.back().height << std::endl;
+                vector<Hash256> hashes;
+                for (auto& header : headers) {
+                    hashes.push_back(header.hash);
+                }
+                downloader->add(hashes);
+                downloader->schedule(download_peers(addr_from));
+                // 区块头可能还有更多(发送方可能按字节数截断), 从最后一个区块头继续请求, 直到收到空的 Headers
+                send_get_headers(addr_from, vector<Hash256>{headers.back().hash});
+                break;
+            }
         default:
             std::cout << "Invalid package type." << std::endl;
             return;
     }
 }
 
+// 输出交易池, 签名缓存, 区块缓存和未花费输出缓存统计
+void Server::print_stats() {
+    MempoolStats stats = tx_pool->stats();
+    std::cout << "Mempool: " << stats.count << " txs, " << stats.bytes << " bytes, usage " << stats.usage << "/"
+              << stats.max_usage << ", evicted " << stats.evicted << ", expired " << stats.expired << ", replaced "
+              << stats.replaced << std::endl;
+    SignatureCacheStats cache = SignatureCache::get_instance()->stats();
+    uint64_t lookups = cache.hits + cache.misses;
+    std::cout << "Signature cache: " << cache.size << "/" << cache.capacity << " entries, hits " << cache.hits
+              << ", misses " << cache.misses << ", hit rate " << (lookups > 0 ? 100.0 * cache.hits / lookups : 0.0)
+              << "%" << std::endl;
+    BlockCacheStats blocks = bc->block_cache_stats();
+    lookups = blocks.hits + blocks.misses;
+    std::cout << "Block cache: " << blocks.count << " blocks, usage " << blocks.usage << "/" << blocks.max_usage
+              << ", hits " << blocks.hits << ", misses " << blocks.misses << ", evicted " << blocks.evicted
+              << ", hit rate " << (lookups > 0 ? 100.0 * blocks.hits / lookups : 0.0) << "%" << std::endl;
+    CoinsCacheStats coins = utxo->cache_stats();
+    lookups = coins.hits + coins.misses;
+    std::cout << "Coins cache: " << coins.count << " outputs, " << coins.dirty << " dirty, usage " << coins.usage
+              << ", hits " << coins.hits << ", misses " << coins.misses << ", hit rate "
+              << (lookups > 0 ? 100.0 * coins.hits / lookups : 0.0) << "%" << std::endl;
+}
+
+// 区块头同步已暂停并且区块下载已经跟上时, 从暂停处继续请求区块头
+void Server::resume_header_sync() {
+    if (paused_header_peer.empty() || bc->unconnected_header_count() + MAX_HEADERS_PER_MESSAGE > MAX_UNCONNECTED_HEADERS) {
+        return;
+    }
+    // 暂停处的区块头可能已被删除, 定位器中再附上主链
+    vector<Hash256> locator{paused_header_hash};
+    vector<Hash256> chain_locator = bc->get_locator();
+    locator.insert(locator.end(), chain_locator.begin(), chain_locator.end());
+    send_get_headers(paused_header_peer, locator);
+    paused_header_peer.clear();
+}
+
+// 计算交易的手续费(输入总额减输出总额), 输入找不到或手续费为负时返回 false
+bool Server::compute_fee(Transaction* tx, long& fee) {
+    fee = 0;
+    if (tx->is_coinbase()) {
+        return true;
+    }
+    long input_value = 0;
+    for (auto& vin : tx->vin) {
+        TXOutput txout;
+        if (utxo->get_output(OutPoint{vin.txid, vin.vout}, txout)) {
+            input_value += txout.value;
+            continue;
+        }
+        // 花费池中尚未上链的交易
+        Transaction* parent = tx_pool->get(vin.txid);
+        if (parent == nullptr || vin.vout < 0 || vin.vout >= (int)parent->vout.size()) {
+            return false;
+        }
+        input_value += parent->vout[vin.vout].value;
+    }
+    long output_value = 0;
+    for (auto& vout : tx->vout) {
+        output_value += vout.value;
+    }
+    fee = input_value - output_value;
+    return fee >= 0;
+}
+
+// 可以下载区块的节点: 已知节点和通告区块的节点, 不包含当前节点
+vector<string> Server::download_peers(const string& addr_from) {
+    string node_addr = Config::get_instance()->get_node_address();
+    vector<string> peers;
+    for (auto& node : nodes) {
+        if (node != node_addr) {
+            peers.push_back(node);
+        }
+    }
+    if (!addr_from.empty() && addr_from != node_addr && std::find(peers.begin(), peers.end(), addr_from) == peers.end()) {
+        peers.push_back(addr_from);
+    }
+    return peers;
+}
+
 // 注册节点
 void Server::add_node(string addr) {
     if (std::find(nodes.begin(), nodes.end(), addr) == nodes.end()) {
@@ -333,9 +824,27 @@ void Server::add_node(string addr) {
 
 // 析构函数~Server();
 Server::~Server() {
+    // 先等待工作线程和矿工退出, 再释放它们使用的对象
+    workers.reset();
+    miner.reset();
+    delete tx_pool;
+    delete utxo;
     delete bc;
 }
 
+// 所有发送路径共用的出站 socket, 首次使用时创建, 进程退出时由系统回收
+static int outbound_socket() {
+    static int sockfd = []() {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd == -1) {
+            std::cerr << "Failed to create socket." << std::endl;
+            exit(1);
+        }
+        return fd;
+    }();
+    return sockfd;
+}
+
 // 发送 UDP 数据包
 void send_udp(string addr, vector<unsigned char> data) {
     sockaddr_in sockaddr;
@@ -343,26 +852,72 @@ void send_udp(string addr, vector<unsigned char> data) {
         std::cerr << "Invalid address " << addr << std::endl; 
         exit(1);
     }
-    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd == -1) {
-        std::cerr << "Failed to create socket." << std::endl;
-        exit(1);
+    if (data.size() > MAXLINE) {
+        std::cerr << "Message of " << data.size() << " bytes exceeds the UDP limit, use the tcp transport" << std::endl;
+        return;
     }
-    ssize_t n = sendto(sockfd, data.data(), data.size(), 0, (const struct sockaddr *)&sockaddr, sizeof(sockaddr));
+    ssize_t n = sendto(outbound_socket(), data.data(), data.size(), 0, (const struct sockaddr *)&sockaddr, sizeof(sockaddr));
     if (n == -1) {
         std::cerr << "Failed to send data." << std::endl;
-        close(sockfd);
         exit(1);
     }
-    close(sockfd);
+}
+
+// 向多个地址发送同一个 UDP 数据包, 一次 sendmmsg 系统调用发出一批
+void send_udp_batch(const vector<string>& addrs, const vector<unsigned char>& data) {
+    if (data.size() > MAXLINE) {
+        std::cerr << "Message of " << data.size() << " bytes exceeds the UDP limit, use the tcp transport" << std::endl;
+        return;
+    }
+    vector<sockaddr_in> sockaddrs(addrs.size());
+    for (size_t i = 0; i < addrs.size(); i++) {
+        if (!parse_address(addrs[i], sockaddrs[i])) {
+            std::cerr << "Invalid address " << addrs[i] << std::endl;
+            exit(1);
+        }
+    }
+    // 所有消息共享同一块数据
+    struct iovec iov;
+    iov.iov_base = const_cast<unsigned char*>(data.data());
+    iov.iov_len = data.size();
+    vector<struct mmsghdr> msgs(addrs.size());
+    for (size_t i = 0; i < addrs.size(); i++) {
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &sockaddrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddrs[i]);
+        msgs[i].msg_hdr.msg_iov = &iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    // sendmmsg 可能只发送了一部分, 从未发送的位置继续
+    size_t sent = 0;
+    while (sent < msgs.size()) {
+        int n = sendmmsg(outbound_socket(), msgs.data() + sent, msgs.size() - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Failed to send data." << std::endl;
+            exit(1);
+        }
+        sent += n;
+    }
+}
+
+// 按配置的传输协议发送消息
+void send_message(string addr, vector<unsigned char> data) {
+    if (Config::get_instance()->use_tcp()) {
+        send_tcp(addr, data);
+        return;
+    }
+    send_udp(addr, data);
 }
 
 // 下载数据
-void send_get_data(string addr, OpType otype, string id) {
+void send_get_data(string addr, OpType otype, const Hash256& id) {
     Json::Value root;
     root["addr_from"] = Config::get_instance()->get_node_address();
     root["op_type"] = static_cast<int>(otype);
-    root["id"] = id;
+    root["id"] = id.to_hex();
     Json::FastWriter writer;
     string body = writer.write(root);
     // 转换为字节流
@@ -370,7 +925,7 @@ void send_get_data(string addr, OpType otype, string id) {
     data.push_back(static_cast<unsigned char>(PackageType::GetData));
     data.insert(data.end(), body.begin(), body.end());
     // 发送数据
-    send_udp(addr, data); 
+    send_message(addr, data);
 }
 
 // 发送区块
@@ -385,7 +940,7 @@ void send_block(string addr, Block* block) {
     data.push_back(static_cast<unsigned char>(PackageType::Block));
     data.insert(data.end(), body.begin(), body.end());
     // 发送数据
-    send_udp(addr, data);
+    send_message(addr, data);
 }
 
 // 发送交易
@@ -400,27 +955,46 @@ void send_tx(string addr, Transaction* tx) {
     data.push_back(static_cast<unsigned char>(PackageType::Tx));
     data.insert(data.end(), body.begin(), body.end());
     // 发送数据
-    send_udp(addr, data);
+    send_message(addr, data);
 }
 
-// 发送 INV 消息
-void send_inv(string addr, OpType otype, vector<string> block_hashes) {
+// 编码 INV 消息
+static vector<unsigned char> inv_message(OpType otype, const vector<Hash256>& items) {
     Json::Value root;
     root["addr_from"] = Config::get_instance()->get_node_address();
     root["op_type"] = static_cast<int>(otype);
-    Json::Value items;
-    for (auto s : block_hashes) {
-        items.append(s);
+    Json::Value values;
+    for (auto& hash : items) {
+        values.append(hash.to_hex());
     }
-    root["items"] = items;
+    root["items"] = values;
     Json::FastWriter writer;
     string body = writer.write(root);
     // 转换为字节流
     vector<unsigned char> data;
     data.push_back(static_cast<unsigned char>(PackageType::Inv));
     data.insert(data.end(), body.begin(), body.end());
-    // 发送数据
-    send_udp(addr, data);
+    return data;
+}
+
+// 发送 INV 消息
+void send_inv(string addr, OpType otype, const vector<Hash256>& block_hashes) {
+    send_message(addr, inv_message(otype, block_hashes));
+}
+
+// 向多个节点广播 INV 消息, 消息只编码一次
+void broadcast_inv(const vector<string>& addrs, OpType otype, const vector<Hash256>& items) {
+    if (addrs.empty()) {
+        return;
+    }
+    vector<unsigned char> data = inv_message(otype, items);
+    if (Config::get_instance()->use_tcp()) {
+        for (auto& addr : addrs) {
+            send_tcp(addr, data);
+        }
+        return;
+    }
+    send_udp_batch(addrs, data);
 }
 
 // 发送 VERSION 消息
@@ -435,7 +1009,7 @@ void send_version(string addr, long height) {
     vector<unsigned char> data{static_cast<unsigned char>(PackageType::Version)};
     data.insert(data.end(), body.begin(), body.end());
     // 发送数据
-    send_udp(addr, data);
+    send_message(addr, data);
 }
 
 // 发送 GET_BLOCKS 消息
@@ -444,6 +1018,49 @@ void send_get_blocks(string addr) {
     vector<unsigned char> data{static_cast<unsigned char>(PackageType::GetBlocks)};
     data.insert(data.end(), add_from.begin(), add_from.end());
     // 发送数据
-    send_udp(addr, data);
+    send_message(addr, data);
 }
 
+
+// 发送 GET_HEADERS 消息
+void send_get_headers(string addr, const vector<Hash256>& locator) {
+    Json::Value root;
+    root["addr_from"] = Config::get_instance()->get_node_address();
+    Json::Value items;
+    for (auto& hash : locator) {
+        items.append(hash.to_hex());
+    }
+    root["locator"] = items;
+    Json::FastWriter writer;
+    string body = writer.write(root);
+    // 转换为字节流
+    vector<unsigned char> data{static_cast<unsigned char>(PackageType::GetHeaders)};
+    data.insert(data.end(), body.begin(), body.end());
+    // 发送数据
+    send_message(addr, data);
+}
+
+// 发送 HEADERS 消息, 区块头按固定长度拼接后整体编码为 base64
+void send_headers(string addr, const vector<BlockHeader>& headers) {
+    Encoder enc;
+    for (auto& header : headers) {
+        size_t before = enc.data().size();
+        header.encode_with_tx_ids(enc);
+        // 超过字节上限时截断, 对方会从最后一个区块头继续请求
+        if (enc.data().size() > MAX_HEADERS_BYTES && before > 0) {
+            enc.data().resize(before);
+            break;
+        }
+    }
+    const string& bytes = enc.data();
+    Json::Value root;
+    root["addr_from"] = Config::get_instance()->get_node_address();
+    root["headers"] = encode_base64(vector<unsigned char>(bytes.begin(), bytes.end()));
+    Json::FastWriter writer;
+    string body = writer.write(root);
+    // 转换为字节流
+    vector<unsigned char> data{static_cast<unsigned char>(PackageType::Headers)};
+    data.insert(data.end(), body.begin(), body.end());
+    // 发送数据
+    send_message(addr, data);
+}
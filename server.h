@@ -1,9 +1,14 @@
 #pragma once
 
 #include <netinet/in.h>
+#include <mutex>
 #include <string>
+#include "block_downloader.h"
 #include "blockchain.h"
 #include "memory_pool.h"
+#include "miner.h"
+#include "tcp_transport.h"
+#include "thread_pool.h"
 #include "transaction.h"
 
 // 操作类型
@@ -12,6 +17,18 @@ enum class OpType: uint8_t {
     Tx = 2,
 };
 
+// 入站 TCP 连接, 只由事件循环线程访问
+struct TcpPeer {
+    struct sockaddr_in addr; // 对端地址
+    FrameReader reader; // 接收缓冲区
+};
+
+// 节点服务器
+// 事件循环线程只负责收包, 每条消息交给工作线程池处理, 网络 I/O 不会等待消息处理.
+// 所有权: Server 持有 bc, utxo, tx_pool 和 miner, 析构时先停止工作线程和矿工再释放它们.
+// 并发规则: 读写 bc 的链尾, utxo, tx_pool, nodes, downloader 时必须持有 chain_mutex;
+// 消息的解析和区块的签名验证在加锁前完成, 加锁只用于接入链. 只读取数据库的 Blockchain::get_block,
+// get_header 和 find_transaction 可以不加锁调用.
 class Server {
 public:
     // 构造函数
@@ -22,7 +39,7 @@ public:
 
     static Server* new_server(string addr, Blockchain* bc);
 
-    // 启动服务器
+    // 启动服务器, 收到 SIGINT 或 SIGTERM 后写回 UTXO 缓存并返回
     void run();
 
 private:
@@ -30,18 +47,58 @@ private:
     UTXOSet* utxo;
     string addr;
     vector<string> nodes;
-    vector<string> blocks_in_transit;
+    unique_ptr<BlockDownloader> downloader; // 区块下载调度
     MemoryPool* tx_pool;
+    unique_ptr<Miner> miner; // 矿工节点的后台矿工
+    unique_ptr<ThreadPool> workers; // 处理消息的工作线程
+    // 保护 bc, utxo, tx_pool, nodes, downloader; 工作线程处理消息和矿工读写链时持有
+    std::mutex chain_mutex;
+    map<int, TcpPeer> tcp_peers; // 入站 TCP 连接, 以文件描述符为键
+    string paused_header_peer; // 区块下载落后太多而暂停了区块头同步的节点, 受 chain_mutex 保护
+    Hash256 paused_header_hash; // 暂停时已保存的最后一个区块头
+
+    // 读取 socket 中所有已到达的报文, 交给工作线程处理
+    void read_datagrams(int sockfd);
+
+    // 接受所有等待中的 TCP 连接
+    void accept_connections(int epfd, int listenfd);
 
-    // 处理接收到的消息
+    // 读取 TCP 连接上已到达的数据, 切分出完整的帧交给工作线程处理
+    void read_stream(int epfd, int fd);
+
+    // 将一条消息交给工作线程处理
+    void dispatch(struct sockaddr_in addr, vector<unsigned char> data);
+
+    // 处理接收到的消息(在工作线程中执行)
     void serve(struct sockaddr_in addr, std::vector<unsigned char> data);
 
     // 注册节点
     void add_node(string addr);
+
+    // 计算交易的手续费, 输入找不到或手续费为负时返回 false
+    bool compute_fee(Transaction* tx, long& fee);
+
+    // 输出交易池, 签名缓存, 区块缓存和未花费输出缓存统计(持有 chain_mutex)
+    void print_stats();
+
+    // 可以下载区块的节点: 已知节点和通告区块的节点, 不包含当前节点
+    vector<string> download_peers(const string& addr_from);
+
+    // 区块头同步已暂停并且区块下载已经跟上时, 从暂停处继续请求区块头(持有 chain_mutex)
+    void resume_header_sync();
 };
 
+// 发送 UDP 数据包, 所有发送共用一个出站 socket
+void send_udp(string addr, vector<unsigned char> data);
+
+// 向多个地址发送同一个 UDP 数据包(sendmmsg 批量发送)
+void send_udp_batch(const vector<string>& addrs, const vector<unsigned char>& data);
+
+// 按配置的传输协议(UDP 或 TCP 长连接)发送消息
+void send_message(string addr, vector<unsigned char> data);
+
 // 下载数据
-void send_get_data(string addr, OpType otype, string id);
+void send_get_data(string addr, OpType otype, const Hash256& id);
 
 // 发送区块
 void send_block(string addr, Block* block);
@@ -50,7 +107,10 @@ void send_block(string addr, Block* block);
 void send_tx(string addr, Transaction* tx);
 
 // 发送 INV 消息
-void send_inv(string addr, OpType otype, vector<string> block_hashes);
+void send_inv(string addr, OpType otype, const vector<Hash256>& block_hashes);
+
+// 向多个节点广播 INV 消息
+void broadcast_inv(const vector<string>& addrs, OpType otype, const vector<Hash256>& items);
 
 // 发送 VERSION 消息
 void send_version(string addr, long height);
@@ -58,3 +118,9 @@ void send_version(string addr, long height);
 // 发送 GET_BLOCKS 消息
 void send_get_blocks(string addr);
 
+// 发送 GET_HEADERS 消息, locator 为本地主链的区块定位器
+void send_get_headers(string addr, const vector<Hash256>& locator);
+
+// 发送 HEADERS 消息
+void send_headers(string addr, const vector<BlockHeader>& headers);
+
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "server.h"
+#include "util.h"
+
+// 每条消息新建 socket 的旧实现, 作为对照
+static void send_udp_per_socket(string addr, vector<unsigned char> data) {
+    sockaddr_in sockaddr;
+    parse_address(addr, sockaddr);
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    sendto(sockfd, data.data(), data.size(), 0, (const struct sockaddr *)&sockaddr, sizeof(sockaddr));
+    close(sockfd);
+}
+
+// blockchain_bench --gtest_filter=ServerBench.broadcast
+TEST(ServerBench, broadcast) {
+    const int peers = 16;
+    const int rounds = 2000;
+    // 本机上的接收端, 报文放不下时由内核丢弃, 不影响发送端的测量
+    vector<int> receivers;
+    vector<string> addrs;
+    for (int i = 0; i < peers; i++) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in sockaddr;
+        memset(&sockaddr, 0, sizeof(sockaddr));
+        sockaddr.sin_family = AF_INET;
+        sockaddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        sockaddr.sin_port = 0;
+        ASSERT_EQ(::bind(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)), 0);
+        socklen_t len = sizeof(sockaddr);
+        getsockname(fd, (struct sockaddr *)&sockaddr, &len);
+        receivers.push_back(fd);
+        addrs.push_back("127.0.0.1:" + std::to_string(ntohs(sockaddr.sin_port)));
+    }
+    // 与一条 INV 消息大小相当
+    vector<unsigned char> data(120, 'x');
+
+    auto measure = [&](const string& name, function<void()> broadcast) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            broadcast();
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << static_cast<long>(rounds * peers / secs) << " messages/s" << std::endl;
+    };
+    measure("socket per message", [&]() {
+        for (auto& addr : addrs) {
+            send_udp_per_socket(addr, data);
+        }
+    });
+    measure("shared socket", [&]() {
+        for (auto& addr : addrs) {
+            send_udp(addr, data);
+        }
+    });
+    measure("sendmmsg", [&]() {
+        send_udp_batch(addrs, data);
+    });
+
+    for (int fd : receivers) {
+        close(fd);
+    }
+}
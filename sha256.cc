@@ -0,0 +1,92 @@
+#include <cstring>
+#include "sha256.h"
+#include "sha256_lanes.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+// 各指令集的多路实现, 分别在独立的源文件中以对应的编译选项编译
+void sha256_lanes_sse4(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests);
+void sha256_lanes_avx2(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests);
+void sha256_lanes_avx512(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests);
+void sha256_lanes_shani(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests);
+#endif
+
+// SHA-256 初始状态
+void sha256_init_state(uint32_t* state) {
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    for (int i = 0; i < 8; i++) {
+        state[i] = init[i];
+    }
+}
+
+// 标量压缩函数, 将 nblocks 个 64 字节块压缩进 state
+void sha256_compress(uint32_t* state, const unsigned char* blocks, int nblocks) {
+    unsigned char digest[32];
+    for (int b = 0; b < nblocks; b++) {
+        sha256_lanes<ScalarOps>(state, blocks + b * 64, 1, digest);
+        for (int i = 0; i < 8; i++) {
+            state[i] = load_be32(digest + 4 * i);
+        }
+    }
+}
+
+// 标量实现
+void sha256_lanes_scalar(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests) {
+    sha256_lanes<ScalarOps>(midstate, blocks, nblocks, digests);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 检查 CPU 是否支持 SHA 扩展指令(CPUID.7.0:EBX[29])
+bool cpu_supports_sha() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ebx & (1u << 29)) != 0 && __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+// 当前 CPU 可用的全部实现, 第一个为标量实现
+const vector<Sha256Impl>& sha256_impls() {
+    static const vector<Sha256Impl> impls = []() {
+        vector<Sha256Impl> impls{{"scalar", 1, sha256_lanes_scalar}};
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.1")) {
+            impls.push_back({"sse4", 4, sha256_lanes_sse4});
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            impls.push_back({"avx2", 8, sha256_lanes_avx2});
+        }
+        if (__builtin_cpu_supports("avx512f")) {
+            impls.push_back({"avx512", 16, sha256_lanes_avx512});
+        }
+        if (cpu_supports_sha()) {
+            impls.push_back({"shani", 4, sha256_lanes_shani});
+        }
+#endif
+        return impls;
+    }();
+    return impls;
+}
+
+// 根据 CPU 特性选择的最快实现
+// 实测 16 路 AVX-512 快于 SHA 扩展指令, SHA 扩展指令又快于 4/8 路的 SSE4/AVX2
+const Sha256Impl& sha256_best_impl() {
+    static const Sha256Impl& best = []() -> const Sha256Impl& {
+        const vector<Sha256Impl>& impls = sha256_impls();
+        for (const char* name : {"avx512", "shani", "avx2", "sse4"}) {
+            for (auto& impl : impls) {
+                if (strcmp(impl.name, name) == 0) {
+                    return impl;
+                }
+            }
+        }
+        return impls[0];
+    }();
+    return best;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// 多路 SHA-256 哈希函数
+// 所有消息共享同一个中间状态 midstate(8 个字), 每路消息有 nblocks 个已填充好的 64 字节尾部块,
+// 第 lane 路的尾部块从 blocks + lane * nblocks * 64 开始. 第 lane 路的摘要写入 digests + lane * 32.
+typedef void (*Sha256LanesFn)(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests);
+
+// SHA-256 实现
+struct Sha256Impl {
+    const char* name; // 名称
+    int lanes; // 一次计算的消息路数
+    Sha256LanesFn hash_lanes;
+};
+
+// 一次最多计算的消息路数
+const int SHA256_MAX_LANES = 16;
+
+// SHA-256 初始状态
+void sha256_init_state(uint32_t* state);
+
+// 标量压缩函数, 将 nblocks 个 64 字节块压缩进 state
+void sha256_compress(uint32_t* state, const unsigned char* blocks, int nblocks);
+
+// 当前 CPU 可用的全部实现, 第一个为标量实现
+const vector<Sha256Impl>& sha256_impls();
+
+// 根据 CPU 特性选择的最快实现
+const Sha256Impl& sha256_best_impl();
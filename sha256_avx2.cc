@@ -0,0 +1,27 @@
+// AVX2 八路 SHA-256, 使用 -mavx2 编译
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include "sha256_lanes.h"
+
+namespace {
+
+struct Avx2Ops {
+    typedef __m256i vec;
+    static const int lanes = 8;
+    static vec set1(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+    static vec load(const uint32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(uint32_t* p, vec v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+    static vec add(vec a, vec b) { return _mm256_add_epi32(a, b); }
+    static vec xor3(vec a, vec b, vec c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+    static vec ch(vec e, vec f, vec g) { return _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g)); }
+    static vec maj(vec a, vec b, vec c) { return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))); }
+    template <int n> static vec ror(vec x) { return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+    template <int n> static vec shr(vec x) { return _mm256_srli_epi32(x, n); }
+};
+
+}
+
+void sha256_lanes_avx2(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests) {
+    sha256_lanes<Avx2Ops>(midstate, blocks, nblocks, digests);
+}
+#endif
@@ -0,0 +1,28 @@
+// AVX-512 十六路 SHA-256, 使用 -mavx512f 编译
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include "sha256_lanes.h"
+
+namespace {
+
+// AVX-512 有原生的循环右移, 三输入逻辑运算用 ternarylogic 一条指令完成
+struct Avx512Ops {
+    typedef __m512i vec;
+    static const int lanes = 16;
+    static vec set1(uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+    static vec load(const uint32_t* p) { return _mm512_load_si512(p); }
+    static void store(uint32_t* p, vec v) { _mm512_store_si512(p, v); }
+    static vec add(vec a, vec b) { return _mm512_add_epi32(a, b); }
+    static vec xor3(vec a, vec b, vec c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+    static vec ch(vec e, vec f, vec g) { return _mm512_ternarylogic_epi32(e, f, g, 0xca); }
+    static vec maj(vec a, vec b, vec c) { return _mm512_ternarylogic_epi32(a, b, c, 0xe8); }
+    template <int n> static vec ror(vec x) { return _mm512_ror_epi32(x, n); }
+    template <int n> static vec shr(vec x) { return _mm512_srli_epi32(x, n); }
+};
+
+}
+
+void sha256_lanes_avx512(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests) {
+    sha256_lanes<Avx512Ops>(midstate, blocks, nblocks, digests);
+}
+#endif
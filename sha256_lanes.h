@@ -0,0 +1,110 @@
+#pragma once
+
+// 多路 SHA-256 的通用实现, 向量操作由 Ops 提供.
+// 各指令集的源文件使用不同的编译选项包含本文件, 因此全部定义放在匿名命名空间中,
+// 避免不同指令集编译出的同名函数在链接时被合并.
+
+#include <cstdint>
+
+namespace {
+
+const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t load_be32(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void store_be32(unsigned char* p, uint32_t v) {
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
+}
+
+// 标量操作, 作为一路的"向量"
+struct ScalarOps {
+    typedef uint32_t vec;
+    static const int lanes = 1;
+    static vec set1(uint32_t x) { return x; }
+    static vec load(const uint32_t* p) { return *p; }
+    static void store(uint32_t* p, vec v) { *p = v; }
+    static vec add(vec a, vec b) { return a + b; }
+    static vec xor3(vec a, vec b, vec c) { return a ^ b ^ c; }
+    static vec ch(vec e, vec f, vec g) { return (e & f) ^ (~e & g); }
+    static vec maj(vec a, vec b, vec c) { return (a & b) ^ (a & c) ^ (b & c); }
+    template <int n> static vec ror(vec x) { return (x >> n) | (x << (32 - n)); }
+    template <int n> static vec shr(vec x) { return x >> n; }
+};
+
+// 对 Ops::lanes 路消息执行压缩
+template <typename Ops>
+void sha256_lanes(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests) {
+    typedef typename Ops::vec vec;
+    const int N = Ops::lanes;
+    alignas(64) uint32_t buf[16 * N];
+    vec s[8];
+    for (int i = 0; i < 8; i++) {
+        s[i] = Ops::set1(midstate[i]);
+    }
+    for (int b = 0; b < nblocks; b++) {
+        // 转置消息字, buf[i * N + lane] 为第 lane 路的第 i 个字
+        vec w[16];
+        for (int i = 0; i < 16; i++) {
+            for (int lane = 0; lane < N; lane++) {
+                buf[i * N + lane] = load_be32(blocks + (lane * nblocks + b) * 64 + 4 * i);
+            }
+            w[i] = Ops::load(buf + i * N);
+        }
+        vec a = s[0], b1 = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int r = 0; r < 64; r++) {
+            if (r >= 16) {
+                // 消息扩展, w 作为 16 个字的环形缓冲区
+                vec w15 = w[(r - 15) & 15];
+                vec w2 = w[(r - 2) & 15];
+                vec s0 = Ops::xor3(Ops::template ror<7>(w15), Ops::template ror<18>(w15), Ops::template shr<3>(w15));
+                vec s1 = Ops::xor3(Ops::template ror<17>(w2), Ops::template ror<19>(w2), Ops::template shr<10>(w2));
+                w[r & 15] = Ops::add(Ops::add(w[r & 15], s0), Ops::add(w[(r - 7) & 15], s1));
+            }
+            vec S1 = Ops::xor3(Ops::template ror<6>(e), Ops::template ror<11>(e), Ops::template ror<25>(e));
+            vec t1 = Ops::add(Ops::add(h, S1), Ops::add(Ops::ch(e, f, g), Ops::add(Ops::set1(SHA256_K[r]), w[r & 15])));
+            vec S0 = Ops::xor3(Ops::template ror<2>(a), Ops::template ror<13>(a), Ops::template ror<22>(a));
+            vec t2 = Ops::add(S0, Ops::maj(a, b1, c));
+            h = g;
+            g = f;
+            f = e;
+            e = Ops::add(d, t1);
+            d = c;
+            c = b1;
+            b1 = a;
+            a = Ops::add(t1, t2);
+        }
+        s[0] = Ops::add(s[0], a);
+        s[1] = Ops::add(s[1], b1);
+        s[2] = Ops::add(s[2], c);
+        s[3] = Ops::add(s[3], d);
+        s[4] = Ops::add(s[4], e);
+        s[5] = Ops::add(s[5], f);
+        s[6] = Ops::add(s[6], g);
+        s[7] = Ops::add(s[7], h);
+    }
+    for (int i = 0; i < 8; i++) {
+        Ops::store(buf + i * N, s[i]);
+    }
+    for (int lane = 0; lane < N; lane++) {
+        for (int i = 0; i < 8; i++) {
+            store_be32(digests + lane * 32 + 4 * i, buf[i * N + lane]);
+        }
+    }
+}
+
+}
@@ -0,0 +1,66 @@
+// SHA 扩展指令(SHA-NI)实现, 使用 -msha -msse4.1 编译
+// 硬件一次处理一路消息, 这里按 4 路一批逐路压缩, 与多路实现保持相同的接口
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include "sha256_lanes.h"
+
+namespace {
+
+// 压缩 nblocks 个 64 字节块
+void sha256_compress_shani(uint32_t* state, const unsigned char* data, int nblocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    // 状态重排为 ABEF / CDGH, 这是 sha256rnds2 指令要求的布局
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);
+    state1 = _mm_shuffle_epi32(state1, 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (int b = 0; b < nblocks; b++) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+        __m128i msg[4];
+        for (int i = 0; i < 16; i++) {
+            // 每组 4 轮, 前 4 组直接读取消息, 之后用 sha256msg1/msg2 扩展
+            if (i < 4) {
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + b * 64 + 16 * i)), MASK);
+            } else {
+                __m128i x = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+                x = _mm_add_epi32(x, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+                msg[i & 3] = _mm_sha256msg2_epu32(x, msg[(i + 3) & 3]);
+            }
+            __m128i m = _mm_add_epi32(msg[i & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(&SHA256_K[4 * i])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+            m = _mm_shuffle_epi32(m, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+        }
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    // 还原为 ABCD / EFGH
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+}
+
+void sha256_lanes_shani(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests) {
+    const int lanes = 4;
+    for (int lane = 0; lane < lanes; lane++) {
+        uint32_t state[8];
+        for (int i = 0; i < 8; i++) {
+            state[i] = midstate[i];
+        }
+        sha256_compress_shani(state, blocks + lane * nblocks * 64, nblocks);
+        for (int i = 0; i < 8; i++) {
+            store_be32(digests + lane * 32 + 4 * i, state[i]);
+        }
+    }
+}
+#endif
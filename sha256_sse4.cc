@@ -0,0 +1,27 @@
+// SSE4.1 四路 SHA-256, 使用 -msse4.1 编译
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include "sha256_lanes.h"
+
+namespace {
+
+struct Sse4Ops {
+    typedef __m128i vec;
+    static const int lanes = 4;
+    static vec set1(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+    static vec load(const uint32_t* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(uint32_t* p, vec v) { _mm_store_si128(reinterpret_cast<__m128i*>(p), v); }
+    static vec add(vec a, vec b) { return _mm_add_epi32(a, b); }
+    static vec xor3(vec a, vec b, vec c) { return _mm_xor_si128(_mm_xor_si128(a, b), c); }
+    static vec ch(vec e, vec f, vec g) { return _mm_xor_si128(_mm_and_si128(e, f), _mm_andnot_si128(e, g)); }
+    static vec maj(vec a, vec b, vec c) { return _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(c, _mm_or_si128(a, b))); }
+    template <int n> static vec ror(vec x) { return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n)); }
+    template <int n> static vec shr(vec x) { return _mm_srli_epi32(x, n); }
+};
+
+}
+
+void sha256_lanes_sse4(const uint32_t* midstate, const unsigned char* blocks, int nblocks, unsigned char* digests) {
+    sha256_lanes<Sse4Ops>(midstate, blocks, nblocks, digests);
+}
+#endif
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "proofofwork.h"
+#include "sha256.h"
+#include "util.h"
+
+// 各多路实现与标量实现、OpenSSL 的结果逐位一致
+TEST(Sha256Tests, lanes_match_scalar) {
+    std::mt19937 gen(7);
+    const vector<Sha256Impl>& impls = sha256_impls();
+    // 覆盖尾部为 1 块和 2 块的前缀长度
+    for (int prefix_len : {0, 1, 40, 54, 55, 56, 63, 64, 100, 119, 120, 200}) {
+        vector<unsigned char> prefix(prefix_len);
+        for (auto& b : prefix) {
+            b = static_cast<unsigned char>(gen());
+        }
+        MiningKernel scalar(prefix, 8, impls[0]);
+        for (auto& impl : impls) {
+            MiningKernel kernel(prefix, 8, impl);
+            long nonces[SHA256_MAX_LANES];
+            // 随机数位数相同和不同的批次
+            for (long base : {0L, 0xfffaL, static_cast<long>(gen())}) {
+                for (int i = 0; i < kernel.lanes(); i++) {
+                    nonces[i] = base + i;
+                }
+                unsigned char digests[SHA256_MAX_LANES * 32];
+                kernel.hash_batch(nonces, kernel.lanes(), digests);
+                for (int i = 0; i < kernel.lanes(); i++) {
+                    unsigned char expected[32];
+                    scalar.hash(nonces[i], expected);
+                    ASSERT_EQ(0, memcmp(expected, digests + i * 32, 32)) << impl.name << " prefix_len = " << prefix_len << " nonce = " << nonces[i];
+                    // 与 OpenSSL 比较
+                    vector<unsigned char> data(prefix);
+                    string nonce_str = to_hex(nonces[i]);
+                    data.insert(data.end(), nonce_str.begin(), nonce_str.end());
+                    ASSERT_EQ(sha256_digest(data), vector<unsigned char>(expected, expected + 32));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include "pub_key_cache.h"
+#include "util.h"
+#include "wallet.h"
+
+// blockchain_bench --gtest_filter=SignatureBench.verify
+TEST(SignatureBench, verify) {
+    const int keys = 16;
+    const int rounds = 4000;
+    // 少量地址反复花费, 与活跃地址的情况相当
+    vector<unique_ptr<Wallet>> wallets;
+    vector<vector<unsigned char>> public_keys;
+    vector<vector<unsigned char>> signatures;
+    vector<unsigned char> message(200, 'x');
+    for (int i = 0; i < keys; i++) {
+        wallets.emplace_back(Wallet::new_wallet());
+        public_keys.push_back(wallets.back()->get_public_key());
+        signatures.push_back(ecdsa_p256_sha256_sign_digest(wallets.back()->ec_key, message));
+    }
+
+    auto measure = [&](const string& name, function<bool(int)> verify) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            ASSERT_TRUE(verify(r % keys));
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << static_cast<long>(rounds / secs) << " verifications/s" << std::endl;
+    };
+    measure("decode public key per verify", [&](int i) {
+        return ecdsa_p256_sha256_sign_verify(public_keys[i], signatures[i], message);
+    });
+    PubKeyCache cache(DEFAULT_PUB_KEY_CACHE_SIZE);
+    measure("public key cache", [&](int i) {
+        EC_KEY* eckey = cache.get(public_keys[i]);
+        bool ok = ecdsa_p256_sha256_sign_verify(eckey, signatures[i], message);
+        EC_KEY_free(eckey);
+        return ok;
+    });
+}
@@ -0,0 +1,60 @@
+#include <mutex>
+#include "config.h"
+#include "signature_cache.h"
+#include "util.h"
+
+SignatureCache::SignatureCache(size_t capacity) : capacity(capacity), hits(0), misses(0) {}
+
+// 全局缓存
+SignatureCache* SignatureCache::get_instance() {
+    static SignatureCache instance(Config::get_instance()->get_signature_cache_size());
+    return &instance;
+}
+
+// 计算缓存的键, 公钥带长度前缀, 避免公钥和签名的边界被移动后得到相同的拼接
+string SignatureCache::make_key(const vector<unsigned char>& message_hash, ByteSpan pub_key, ByteSpan signature) {
+    vector<unsigned char> data(message_hash);
+    data.push_back(static_cast<unsigned char>(pub_key.size() >> 8));
+    data.push_back(static_cast<unsigned char>(pub_key.size()));
+    data.insert(data.end(), pub_key.begin(), pub_key.end());
+    data.insert(data.end(), signature.begin(), signature.end());
+    vector<unsigned char> digest = sha256_digest(data);
+    return string(digest.begin(), digest.end());
+}
+
+// 查询签名是否已经验证通过
+bool SignatureCache::contains(const string& key) {
+    bool found;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        found = entries.count(key) > 0;
+    }
+    if (found) {
+        hits++;
+    } else {
+        misses++;
+    }
+    return found;
+}
+
+// 记录验证通过的签名
+void SignatureCache::insert(const string& key) {
+    if (capacity == 0) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!entries.insert(key).second) {
+        return;
+    }
+    order.push_back(key);
+    while (order.size() > capacity) {
+        entries.erase(order.front());
+        order.pop_front();
+    }
+}
+
+// 缓存统计
+SignatureCacheStats SignatureCache::stats() {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return SignatureCacheStats{hits, misses, entries.size(), capacity};
+}
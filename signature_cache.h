@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "codec.h"
+
+using namespace std;
+
+// 签名缓存统计
+struct SignatureCacheStats {
+    uint64_t hits; // 命中次数
+    uint64_t misses; // 未命中次数
+    size_t size; // 缓存的签名数
+    size_t capacity; // 容量
+};
+
+// 默认的签名缓存容量(条)
+const size_t DEFAULT_SIGNATURE_CACHE_SIZE = 100000;
+
+// 验证通过的签名缓存
+// 键为 sha256(消息摘要 | 公钥 | 签名), 只缓存验证通过的签名. 交易进入交易池时验证过的签名,
+// 在生成区块模板或收到包含它的区块时不必再做椭圆曲线运算. 容量满时淘汰最早加入的条目.
+// 查询持有共享锁, 多个验证线程可以同时查询.
+class SignatureCache {
+public:
+    SignatureCache(size_t capacity);
+
+    SignatureCache(const SignatureCache&) = delete;
+    SignatureCache& operator=(const SignatureCache&) = delete;
+
+    // 全局缓存, 容量取自配置
+    static SignatureCache* get_instance();
+
+    // 计算缓存的键, message_hash 为签名消息的 sha256 摘要
+    static string make_key(const vector<unsigned char>& message_hash, ByteSpan pub_key, ByteSpan signature);
+
+    // 查询签名是否已经验证通过, 同时更新命中计数
+    bool contains(const string& key);
+
+    // 记录验证通过的签名
+    void insert(const string& key);
+
+    // 缓存统计
+    SignatureCacheStats stats();
+
+private:
+    size_t capacity;
+    std::shared_mutex mutex; // 保护 entries, order
+    unordered_set<string> entries;
+    deque<string> order; // 加入顺序, 用于淘汰
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+};
@@ -0,0 +1,182 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include "blockchain.h"
+#include "config.h"
+#include "signature_verifier.h"
+#include "util.h"
+
+// 一批交易的验证状态, 由调用线程和验证线程共享
+struct VerifyBatch {
+    const vector<Transaction*>* txs;
+    Blockchain* bc;
+    SignatureCache* cache;
+    PubKeyCache* keys;
+    map<Hash256, size_t> positions; // 交易 ID -> 在批次中的位置
+    vector<vector<unsigned char>> messages; // 每笔交易签名的消息
+    vector<vector<unsigned char>> message_hashes; // 消息的 sha256 摘要, 用于签名缓存
+    vector<pair<size_t, size_t>> checks; // (交易位置, 输入下标)
+    std::atomic<size_t> next;
+    std::atomic<bool> failed;
+    std::atomic<size_t> cached;
+    Hash256 failed_txid;
+
+    std::mutex mutex; // 保护 failed_txid, closed, active
+    std::condition_variable cv;
+    bool closed; // 调用方已经返回, 尚未开始的验证线程直接退出
+    int active; // 正在验证的线程数
+
+    // 验证一个输入
+    bool check(size_t tx_pos, size_t vin_idx);
+
+    // 椭圆曲线验证签名, 有公钥缓存时使用缓存中解码好的公钥
+    bool verify_signature(size_t tx_pos, const TXInput& vin);
+
+    // 领取并验证输入, 直到全部领完或出现失败
+    void run();
+};
+
+// 验证一个输入
+bool VerifyBatch::check(size_t tx_pos, size_t vin_idx) {
+    Transaction* tx = (*txs)[tx_pos];
+    TXInput& vin = tx->vin[vin_idx];
+    if (bc != nullptr) {
+        // 引用的交易在批次中排在前面, 或者已经在链上
+        auto it = positions.find(vin.txid);
+        if (it != positions.end() && it->second < tx_pos) {
+            if (vin.vout < 0 || vin.vout >= (int)(*txs)[it->second]->vout.size()) {
+                return false;
+            }
+        } else {
+            unique_ptr<Transaction> prev_tx(bc->find_transaction(vin.txid));
+            if (prev_tx == nullptr) {
+                std::cerr << "ERROR: Previous transaction not found!" << std::endl;
+                return false;
+            }
+            if (vin.vout < 0 || vin.vout >= (int)prev_tx->vout.size()) {
+                return false;
+            }
+        }
+    }
+    if (cache == nullptr) {
+        return verify_signature(tx_pos, vin);
+    }
+    string key = SignatureCache::make_key(message_hashes[tx_pos], vin.pub_key, vin.signature);
+    if (cache->contains(key)) {
+        cached++;
+        return true;
+    }
+    if (!verify_signature(tx_pos, vin)) {
+        return false;
+    }
+    cache->insert(key);
+    return true;
+}
+
+// 椭圆曲线验证签名
+bool VerifyBatch::verify_signature(size_t tx_pos, const TXInput& vin) {
+    if (keys == nullptr) {
+        return ecdsa_p256_sha256_sign_verify(vin.pub_key, vin.signature, messages[tx_pos]);
+    }
+    EC_KEY* eckey = keys->get(vin.pub_key);
+    if (eckey == nullptr) {
+        return false;
+    }
+    bool ok = ecdsa_p256_sha256_sign_verify(eckey, vin.signature, messages[tx_pos]);
+    EC_KEY_free(eckey);
+    return ok;
+}
+
+// 领取并验证输入
+void VerifyBatch::run() {
+    while (!failed) {
+        size_t i = next++;
+        if (i >= checks.size()) {
+            return;
+        }
+        if (!check(checks[i].first, checks[i].second)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failed) {
+                failed = true;
+                failed_txid = (*txs)[checks[i].first]->id;
+            }
+            return;
+        }
+    }
+}
+
+SignatureVerifier::SignatureVerifier(int threads, SignatureCache* cache, PubKeyCache* keys)
+    : threads(threads < 0 ? 0 : threads), cache(cache), keys(keys) {
+    if (this->threads > 0) {
+        pool.reset(new ThreadPool(this->threads));
+    }
+}
+
+// 全局验证器, 调用线程也参与验证, 因此额外的验证线程比配置少一个
+SignatureVerifier* SignatureVerifier::get_instance() {
+    static SignatureVerifier instance(Config::get_instance()->get_verify_threads() - 1, SignatureCache::get_instance(),
+                                      PubKeyCache::get_instance());
+    return &instance;
+}
+
+// 验证交易的输入签名
+VerifyResult SignatureVerifier::verify(const vector<Transaction*>& txs, Blockchain* bc) {
+    auto start = std::chrono::steady_clock::now();
+    auto batch = std::make_shared<VerifyBatch>();
+    batch->txs = &txs;
+    batch->bc = bc;
+    batch->cache = cache;
+    batch->keys = keys;
+    batch->next = 0;
+    batch->failed = false;
+    batch->cached = 0;
+    batch->closed = false;
+    batch->active = 0;
+    for (size_t i = 0; i < txs.size(); i++) {
+        Transaction* tx = txs[i];
+        batch->positions.insert(make_pair(tx->id, i));
+        if (tx->is_coinbase()) {
+            batch->messages.emplace_back();
+            batch->message_hashes.emplace_back();
+            continue;
+        }
+        batch->messages.push_back(tx->signature_message());
+        batch->message_hashes.push_back(cache != nullptr ? sha256_digest(batch->messages.back()) : vector<unsigned char>{});
+        for (size_t j = 0; j < tx->vin.size(); j++) {
+            batch->checks.push_back(make_pair(i, j));
+        }
+    }
+
+    // 唤醒验证线程, 输入较少时不值得切换线程
+    size_t helpers = batch->checks.size() > 1 ? std::min((size_t)threads, batch->checks.size() - 1) : 0;
+    for (size_t i = 0; i < helpers; i++) {
+        pool->submit([batch]() {
+            {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (batch->closed) {
+                    return;
+                }
+                batch->active++;
+            }
+            batch->run();
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (--batch->active == 0) {
+                batch->cv.notify_all();
+            }
+        });
+    }
+    batch->run();
+    // 等待已经开始的验证线程结束, 之后 txs 可能被调用方释放
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->closed = true;
+    batch->cv.wait(lock, [&batch]() { return batch->active == 0; });
+
+    VerifyResult result;
+    result.ok = !batch->failed;
+    result.failed_txid = batch->failed_txid;
+    result.inputs = batch->checks.size();
+    result.cached = batch->cached;
+    result.micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include "pub_key_cache.h"
+#include "signature_cache.h"
+#include "thread_pool.h"
+#include "transaction.h"
+
+// 签名验证结果
+struct VerifyResult {
+    bool ok;
+    Hash256 failed_txid; // 验证失败的交易, 并行验证时不一定是排在最前面的那一笔
+    size_t inputs; // 验证的输入数量
+    size_t cached; // 命中签名缓存, 跳过椭圆曲线运算的输入数量
+    long micros; // 耗时(微秒)
+};
+
+// 并行签名验证器
+// 把一批交易(一个区块, 或一个区块模板)全部输入的签名检查分摊到线程池, 调用线程也参与验证.
+// 输入按下标逐个领取, 任一检查失败后其余线程不再领取新的输入, 调用方尽早得到结果.
+// 验证通过的签名记入签名缓存, 再次验证时直接跳过; 公钥从公钥缓存中取解码好的 EC_KEY.
+class SignatureVerifier {
+public:
+    // 创建 threads 个验证线程(不含调用线程), cache / keys 为空时不使用签名缓存 / 公钥缓存
+    SignatureVerifier(int threads, SignatureCache* cache, PubKeyCache* keys);
+
+    SignatureVerifier(const SignatureVerifier&) = delete;
+    SignatureVerifier& operator=(const SignatureVerifier&) = delete;
+
+    // 全局验证器, 线程数取自配置
+    static SignatureVerifier* get_instance();
+
+    // 验证 txs 中所有非 coinbase 交易的输入签名. bc 不为空时, 还要求每个输入引用的交易已经在链上,
+    // 或者在 txs 中排在它前面. bc 只用于从交易索引查询交易, 调用方不需要持有 chain_mutex
+    VerifyResult verify(const vector<Transaction*>& txs, Blockchain* bc);
+
+private:
+    int threads;
+    SignatureCache* cache;
+    PubKeyCache* keys;
+    unique_ptr<ThreadPool> pool;
+};
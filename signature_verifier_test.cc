@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "signature_verifier.h"
+#include "util.h"
+#include "wallet.h"
+
+// 构造一笔有 inputs 个已签名输入的交易
+static Transaction* make_signed_tx(Wallet* wallet, const string& id, int inputs) {
+    Transaction* tx = new Transaction;
+    tx->id = Hash256::sha256(id);
+    for (int i = 0; i < inputs; i++) {
+        tx->vin.push_back(TXInput{Hash256::sha256(string("prev")), i, {}, wallet->get_public_key()});
+    }
+    tx->vout.push_back(TXOutput(10, wallet->get_address()));
+    auto message = tx->signature_message();
+    for (auto& vin : tx->vin) {
+        auto signature = ecdsa_p256_sha256_sign_digest(wallet->ec_key, message);
+        vin.signature.assign(signature.begin(), signature.end());
+    }
+    return tx;
+}
+
+TEST(SignatureVerifierTests, parallel_verify) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    vector<unique_ptr<Transaction>> owned;
+    vector<Transaction*> txs;
+    for (int i = 0; i < 8; i++) {
+        owned.emplace_back(make_signed_tx(wallet.get(), "tx" + to_string(i), 4));
+        txs.push_back(owned.back().get());
+    }
+    SignatureVerifier verifier(3, nullptr, nullptr);
+    VerifyResult result = verifier.verify(txs, nullptr);
+    EXPECT_TRUE(result.ok);
+    EXPECT_EQ(result.inputs, 32);
+
+    // 篡改一个签名
+    txs[5]->vin[2].signature[8] ^= 0x01;
+    result = verifier.verify(txs, nullptr);
+    EXPECT_FALSE(result.ok);
+    EXPECT_EQ(result.failed_txid, Hash256::sha256(string("tx5")));
+
+    // 没有验证线程时由调用线程完成全部检查
+    SignatureVerifier inline_verifier(0, nullptr, nullptr);
+    result = inline_verifier.verify(txs, nullptr);
+    EXPECT_FALSE(result.ok);
+    EXPECT_EQ(result.failed_txid, Hash256::sha256(string("tx5")));
+}
+
+TEST(SignatureVerifierTests, signature_cache) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Transaction> tx1(make_signed_tx(wallet.get(), "tx1", 3));
+    unique_ptr<Transaction> tx2(make_signed_tx(wallet.get(), "tx2", 2));
+    SignatureCache cache(4);
+    SignatureVerifier verifier(2, &cache, nullptr);
+
+    // 第一次验证全部未命中
+    VerifyResult result = verifier.verify({tx1.get()}, nullptr);
+    EXPECT_TRUE(result.ok);
+    EXPECT_EQ(result.cached, 0);
+    // 第二次验证全部命中
+    result = verifier.verify({tx1.get()}, nullptr);
+    EXPECT_TRUE(result.ok);
+    EXPECT_EQ(result.cached, 3);
+    EXPECT_EQ(cache.stats().hits, 3);
+    EXPECT_EQ(cache.stats().misses, 3);
+
+    // 篡改签名后不会命中, 失败的签名不进入缓存
+    tx1->vin[0].signature[8] ^= 0x01;
+    result = verifier.verify({tx1.get()}, nullptr);
+    EXPECT_FALSE(result.ok);
+    EXPECT_EQ(cache.stats().size, 3);
+
+    // 容量满时淘汰最早的条目
+    result = verifier.verify({tx2.get()}, nullptr);
+    EXPECT_TRUE(result.ok);
+    EXPECT_EQ(cache.stats().size, 4);
+}
+
+TEST(SignatureVerifierTests, pub_key_cache) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Wallet> other(Wallet::new_wallet());
+    unique_ptr<Transaction> tx1(make_signed_tx(wallet.get(), "tx1", 3));
+    unique_ptr<Transaction> tx2(make_signed_tx(other.get(), "tx2", 1));
+    PubKeyCache keys(1);
+    SignatureVerifier verifier(0, nullptr, &keys);
+
+    // 同一个公钥只解码一次
+    EXPECT_TRUE(verifier.verify({tx1.get()}, nullptr).ok);
+    EXPECT_EQ(keys.misses(), 1);
+    EXPECT_EQ(keys.hits(), 2);
+    // 容量为 1, 新的公钥淘汰旧的
+    EXPECT_TRUE(verifier.verify({tx2.get()}, nullptr).ok);
+    EXPECT_EQ(keys.size(), 1);
+    EXPECT_TRUE(verifier.verify({tx1.get()}, nullptr).ok);
+    EXPECT_EQ(keys.misses(), 3);
+
+    // 无效的公钥和签名
+    EXPECT_EQ(keys.get(vector<unsigned char>{1, 2, 3}), nullptr);
+    tx1->vin[1].signature.clear();
+    EXPECT_FALSE(verifier.verify({tx1.get()}, nullptr).ok);
+}
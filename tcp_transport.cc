@@ -0,0 +1,202 @@
+#include <cerrno>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "tcp_transport.h"
+#include "util.h"
+
+// 帧编码
+string encode_frame(const vector<unsigned char>& data) {
+    string frame;
+    frame.reserve(4 + data.size());
+    uint32_t len = data.size();
+    for (int i = 3; i >= 0; i--) {
+        frame.push_back(static_cast<char>((len >> (8 * i)) & 0xff));
+    }
+    frame.append(reinterpret_cast<const char*>(data.data()), data.size());
+    return frame;
+}
+
+FrameReader::FrameReader() : offset(0), error(false) {}
+
+// 追加收到的数据
+void FrameReader::append(const char* data, size_t size) {
+    if (error) {
+        return;
+    }
+    // 已取出的数据超过一半时整体前移, 避免缓冲区无限增长
+    if (offset > 0 && offset * 2 >= buf.size()) {
+        buf.erase(0, offset);
+        offset = 0;
+    }
+    buf.append(data, size);
+    // 收到长度前缀就检查, 超长的帧不再继续缓冲
+    uint32_t len;
+    if (frame_length(len) && len > MAX_FRAME_SIZE) {
+        error = true;
+        buf.clear();
+        offset = 0;
+    }
+}
+
+// 当前帧的长度前缀, 不足 4 字节时返回 false
+bool FrameReader::frame_length(uint32_t& len) {
+    if (buf.size() - offset < 4) {
+        return false;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buf.data() + offset);
+    len = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+          (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    return true;
+}
+
+// 取出下一个完整的帧
+bool FrameReader::next(vector<unsigned char>& frame) {
+    uint32_t len;
+    if (error || !frame_length(len)) {
+        return false;
+    }
+    if (len > MAX_FRAME_SIZE) {
+        error = true;
+        return false;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buf.data() + offset);
+    if (buf.size() - offset - 4 < len) {
+        return false;
+    }
+    frame.assign(p + 4, p + 4 + len);
+    offset += 4 + len;
+    return true;
+}
+
+// 是否收到了超长的帧
+bool FrameReader::failed() {
+    return error;
+}
+
+// 缓冲区中尚未取出的字节数
+size_t FrameReader::buffered() {
+    return buf.size() - offset;
+}
+
+// 连接和发送超时(秒)
+const int SEND_TIMEOUT_SECS = 5;
+
+// 出站连接, 同一连接上的帧不能交错写入
+struct TcpConnection {
+    std::mutex mutex;
+    int fd = -1;
+};
+
+// 按地址复用的出站连接
+static std::mutex connections_mutex;
+static map<string, shared_ptr<TcpConnection>> connections;
+
+// 建立到 addr 的阻塞连接, 失败返回 -1
+static int connect_tcp(const string& addr) {
+    sockaddr_in sockaddr;
+    if (!parse_address(addr, sockaddr)) {
+        std::cerr << "Invalid address " << addr << std::endl;
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // 连接和发送超时, 避免不可达的节点长期占用工作线程
+    struct timeval timeout = {SEND_TIMEOUT_SECS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    // 小消息(INV, GetData)不等待合并
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// 写入全部数据
+static bool write_all(int fd, const string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+// 通过持久连接发送一帧
+bool send_tcp(const string& addr, const vector<unsigned char>& data) {
+    if (data.size() > MAX_FRAME_SIZE) {
+        std::cerr << "Message too large: " << data.size() << " bytes" << std::endl;
+        return false;
+    }
+    shared_ptr<TcpConnection> conn;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        auto& entry = connections[addr];
+        if (entry == nullptr) {
+            entry = make_shared<TcpConnection>();
+        }
+        conn = entry;
+    }
+    string frame = encode_frame(data);
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    // 第一次尝试使用已有连接, 失败后重连再试一次
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (conn->fd < 0) {
+            conn->fd = connect_tcp(addr);
+            if (conn->fd < 0) {
+                break;
+            }
+        }
+        if (write_all(conn->fd, frame)) {
+            return true;
+        }
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    std::cerr << "Failed to send data to " << addr << std::endl;
+    return false;
+}
+
+// 创建非阻塞的 TCP 监听 socket
+int listen_tcp(const string& addr) {
+    sockaddr_in sockaddr;
+    if (!parse_address(addr, sockaddr)) {
+        std::cerr << "Invalid address " << addr << std::endl;
+        exit(1);
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "socket creation failed" << std::endl;
+        exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
+        std::cerr << "bind socket to " << addr << " failed" << std::endl;
+        exit(1);
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        std::cerr << "listen on " << addr << " failed" << std::endl;
+        exit(1);
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 单帧最大长度, 超过则认为连接出错
+const uint32_t MAX_FRAME_SIZE = 64 << 20;
+
+// 帧编码: 4 字节大端序长度 + 数据
+string encode_frame(const vector<unsigned char>& data);
+
+// 流式帧解析, 从 TCP 字节流中按长度前缀切分出完整的帧
+class FrameReader {
+public:
+    FrameReader();
+
+    // 追加收到的数据, 当前帧的长度前缀超过 MAX_FRAME_SIZE 时出错并丢弃缓冲区
+    void append(const char* data, size_t size);
+
+    // 取出下一个完整的帧, 数据不足时返回 false
+    bool next(vector<unsigned char>& frame);
+
+    // 是否收到了超长的帧, 出错后连接应当关闭
+    bool failed();
+
+    // 缓冲区中尚未取出的字节数
+    size_t buffered();
+
+private:
+    string buf;
+    size_t offset; // 已经取出的字节数, 积累到一定程度再整体前移
+    bool error;
+
+    // 当前帧的长度前缀, 不足 4 字节时返回 false
+    bool frame_length(uint32_t& len);
+};
+
+// 通过持久连接发送一帧, 连接按地址复用, 断开后自动重连一次. 发送失败返回 false
+bool send_tcp(const string& addr, const vector<unsigned char>& data);
+
+// 创建非阻塞的 TCP 监听 socket
+int listen_tcp(const string& addr);
@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include "tcp_transport.h"
+
+TEST(FrameReaderTests, split_frames) {
+    vector<unsigned char> small{1, 2, 3};
+    // 超过 UDP 报文上限的大帧
+    vector<unsigned char> large(1 << 20);
+    for (size_t i = 0; i < large.size(); i++) {
+        large[i] = static_cast<unsigned char>(i * 31);
+    }
+    string stream = encode_frame(small) + encode_frame(large) + encode_frame(vector<unsigned char>());
+
+    // 逐段追加, 模拟 TCP 字节流被任意切分
+    FrameReader reader;
+    vector<vector<unsigned char>> frames;
+    vector<unsigned char> frame;
+    for (size_t pos = 0; pos < stream.size(); pos += 1000) {
+        reader.append(stream.data() + pos, std::min<size_t>(1000, stream.size() - pos));
+        while (reader.next(frame)) {
+            frames.push_back(frame);
+        }
+    }
+    ASSERT_EQ(frames.size(), 3);
+    EXPECT_EQ(frames[0], small);
+    EXPECT_EQ(frames[1], large);
+    EXPECT_TRUE(frames[2].empty());
+    EXPECT_EQ(reader.buffered(), 0);
+    EXPECT_FALSE(reader.failed());
+
+    // 超长的帧使连接出错
+    FrameReader bad;
+    bad.append("\xff\xff\xff\xff", 4);
+    EXPECT_TRUE(bad.failed());
+    EXPECT_FALSE(bad.next(frame));
+    // 出错后不再缓冲后续数据
+    string body(1000, 'x');
+    bad.append(body.data(), body.size());
+    EXPECT_EQ(bad.buffered(), 0);
+}
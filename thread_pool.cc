@@ -0,0 +1,53 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int threads) : stopping(false) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+// 提交任务
+void ThreadPool::submit(function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    cv.notify_one();
+}
+
+// 排队中的任务数量
+size_t ThreadPool::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size();
+}
+
+// 工作线程主循环, 停止时先执行完队列中剩余的任务
+void ThreadPool::loop() {
+    while (true) {
+        function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
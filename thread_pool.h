@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 固定大小的线程池, 任务按提交顺序取出, 由任意空闲线程执行
+class ThreadPool {
+public:
+    // 创建 threads 个工作线程(至少 1 个)
+    ThreadPool(int threads);
+
+    // 析构时等待已提交的任务执行完毕
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 提交任务
+    void submit(function<void()> task);
+
+    // 排队中(尚未开始执行)的任务数量
+    size_t pending();
+
+private:
+    vector<std::thread> workers;
+    queue<function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping;
+
+    // 工作线程主循环
+    void loop();
+};
@@ -0,0 +1,15 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include "thread_pool.h"
+
+TEST(ThreadPoolTests, run_all_tasks) {
+    std::atomic<int> sum(0);
+    {
+        ThreadPool pool(4);
+        for (int i = 1; i <= 1000; i++) {
+            pool.submit([&sum, i]() { sum += i; });
+        }
+        // 析构时执行完所有已提交的任务
+    }
+    EXPECT_EQ(sum.load(), 500500);
+}
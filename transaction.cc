@@ -6,8 +6,10 @@
 #include <unistd.h>
 #include <vector>
 #include <map>
+#include <functional>
 #include "blockchain.h"
 #include "openssl/ossl_typ.h"
+#include "signature_verifier.h"
 #include "transaction.h"
 #include "wallet.h"
 #include "util.h"
@@ -16,17 +18,31 @@
 // 挖矿奖励金
 const int SUBSIDY = 10;
 
+TXInput::TXInput(const allocator_type& alloc) : signature(alloc), pub_key(alloc) {}
+
+TXInput::TXInput(const Hash256& txid, int vout, ByteSpan signature, ByteSpan pub_key)
+    : txid(txid), vout(vout), signature(signature.begin(), signature.end()), pub_key(pub_key.begin(), pub_key.end()) {}
+
+TXInput::TXInput(const TXInput& other, const allocator_type& alloc)
+    : txid(other.txid), vout(other.vout), signature(other.signature, alloc), pub_key(other.pub_key, alloc) {}
+
+TXInput::TXInput(TXInput&& other, const allocator_type& alloc)
+    : txid(other.txid), vout(other.vout), signature(std::move(other.signature), alloc), pub_key(std::move(other.pub_key), alloc) {}
+
 // 检查公钥哈希是否能够解锁输出
 bool TXInput::uses_key(vector<unsigned char>& pub_key_hash) {
     vector<unsigned char> locking_hash = hash_pub_key(pub_key);
     return are_vectors_equal(locking_hash, pub_key_hash);
 }
 
+TXOutput::TXOutput(const allocator_type& alloc) : pub_key_hash(alloc) {}
+
+TXOutput::TXOutput(const TXOutput& other, const allocator_type& alloc) : value(other.value), pub_key_hash(other.pub_key_hash, alloc) {}
+
+TXOutput::TXOutput(TXOutput&& other, const allocator_type& alloc) : value(other.value), pub_key_hash(std::move(other.pub_key_hash), alloc) {}
+
 // 构建输出
-TXOutput::TXOutput(int value, vector<unsigned char> pub_key_hash) {
-    this->value = value;
-    this->pub_key_hash = pub_key_hash;
-}
+TXOutput::TXOutput(int value, ByteSpan pub_key_hash) : value(value), pub_key_hash(pub_key_hash.begin(), pub_key_hash.end()) {}
 
 // 构造输出
 TXOutput::TXOutput(int value, const string& address) {
@@ -44,7 +60,7 @@ void TXOutput::lock(const string& address) {
         exit(1);
     }
     // 去掉版本号和校验码
-    this->pub_key_hash = vector<unsigned char>(payload.begin() + 1, payload.end() - ADDRESS_CHECK_SUM_LEN);
+    this->pub_key_hash.assign(payload.begin() + 1, payload.end() - ADDRESS_CHECK_SUM_LEN);
 }
 
 // 解锁检查
@@ -52,37 +68,59 @@ bool TXOutput::is_locked_with_key(vector<unsigned char> &pub_key_hash) {
     return are_vectors_equal(this->pub_key_hash, pub_key_hash);
 }
 
+bool OutPoint::operator<(const OutPoint& other) const {
+    if (txid != other.txid) {
+        return txid < other.txid;
+    }
+    return vout < other.vout;
+}
+
+bool OutPoint::operator==(const OutPoint& other) const {
+    return txid == other.txid && vout == other.vout;
+}
+
+size_t OutPointHash::operator()(const OutPoint& outpoint) const {
+    return std::hash<Hash256>()(outpoint.txid) * 31 + std::hash<int>()(outpoint.vout);
+}
+
+Transaction::Transaction(std::pmr::memory_resource* resource) : vin(resource), vout(resource) {}
+
 // 判断是否是 coinbase 交易
 bool Transaction::is_coinbase() {
     return this->vin.size() == 1 && this->vin[0].pub_key.size() == 0;
 }
 
 // 交易哈希
-string Transaction::hash() {
-    if (this->id != "") {
+Hash256 Transaction::hash() {
+    if (!this->id.is_null()) {
         return this->id;
     }
     // 交易 ID 不参与哈希计算
-    vector<unsigned char> tx_bytes = this->serialize_transaction();
-    return sha256_digest_hex(tx_bytes);
+    return Hash256::sha256(this->serialize_transaction());
 }
 
 // 创建一个修剪后的交易副本
 Transaction* Transaction::trimmed_copy() {
-    vector<TXInput> new_vin;
-    vector<TXOutput> new_vout;
-    for (auto vin : this->vin) {
-        new_vin.push_back(TXInput{vin.txid, vin.vout, vector<unsigned char>{}, vector<unsigned char>{}});
-    }
-    for (auto vout : this->vout) {
-        new_vout.push_back(TXOutput{vout.value, vout.pub_key_hash});
+    Transaction* tx = new Transaction();
+    tx->id = this->id;
+    tx->vin.reserve(this->vin.size());
+    for (auto& vin : this->vin) {
+        tx->vin.push_back(TXInput{vin.txid, vin.vout, {}, {}});
     }
-    return new Transaction{this->id, new_vin, new_vout};
+    tx->vout.assign(this->vout.begin(), this->vout.end());
+    return tx;
 }
 
-// 克隆交易
+// 克隆交易, 副本总是分配在堆上, 不依赖原交易所在区块的 arena
 Transaction* Transaction::clone() {
-    return new Transaction{this->id, this->vin, this->vout};
+    return new Transaction(*this);
+}
+
+// 签名的消息
+// 签名时副本中的公钥和交易 ID 都会在序列化前还原, 每个输入签名的都是同一份修剪后的副本
+vector<unsigned char> Transaction::signature_message() {
+    unique_ptr<Transaction> tx_copy(this->trimmed_copy());
+    return tx_copy->serialize_transaction();
 }
 
 // 对交易的每个输入进行签名
@@ -90,67 +128,43 @@ void Transaction::sign(Blockchain* bc, EC_KEY* ec_key) {
     if (this->is_coinbase()) {
         return;
     }
-    // 交易副本
-    unique_ptr<Transaction> tx_copy(this->trimmed_copy());
-    
-    for (int idx = 0; idx < this->vin.size(); idx++) {
-        auto vin = this->vin[idx];
+    auto tx_bytes = this->signature_message();
+    for (auto& vin : this->vin) {
         // 查询输入引用的交易
         unique_ptr<Transaction> prev_tx(bc->find_transaction(vin.txid));
         if (prev_tx == nullptr) {
             std::cerr << "ERROR: Previous transaction not found!" << std::endl;
             exit(1);
         }
-        // 交易副本的输入
-        tx_copy->vin[idx].signature.clear();
-        tx_copy->vin[idx].pub_key = prev_tx->vout[vin.vout].pub_key_hash;
-        tx_copy->id = tx_copy->hash();
-        tx_copy->vin[idx].pub_key.clear();
         // 使用私钥签名
-        auto tx_bytes = tx_copy->serialize_transaction();
-        vin.signature = ecdsa_p256_sha256_sign_digest(ec_key, tx_bytes);
+        vector<unsigned char> signature = ecdsa_p256_sha256_sign_digest(ec_key, tx_bytes);
+        vin.signature.assign(signature.begin(), signature.end());
     }
 }
 
 // 对交易的每个输入进行验证
 bool Transaction::verify(Blockchain* bc) {
-    if (this->is_coinbase()) {
-        return true;
-    }
-    unique_ptr<Transaction> tx_copy(this->trimmed_copy());
-    for (int idx = 0; idx < this->vin.size(); idx++) {
-        auto vin = this->vin[idx];
-        // 智能指针
-        unique_ptr<Transaction> prev_tx(bc->find_transaction(vin.txid));
-        if (prev_tx == nullptr) {
-            std::cerr << "ERROR: Previous transaction not found!" << std::endl;
-            exit(1);
-        }
-        tx_copy->vin[idx].signature.clear();
-        tx_copy->vin[idx].pub_key = prev_tx->vout[vin.vout].pub_key_hash;
-        tx_copy->id = tx_copy->hash();
-        tx_copy->vin[idx].pub_key.clear();
-
-        // 使用公钥验证签名
-        auto tx_bytes = tx_copy->serialize_transaction();
-        if (!ecdsa_p256_sha256_sign_verify(vin.pub_key, vin.signature, tx_bytes)) {
-            return false;
-        }
-    }
-    return true;
+    return SignatureVerifier::get_instance()->verify(vector<Transaction*>{this}, bc).ok;
 }
 
 // 创建一笔 coinbase 交易, 该交易没有输入, 仅有一个输出
 Transaction* Transaction::new_coinbase_tx(const string& to) {
+    return new_coinbase_tx(to, 0);
+}
+
+// 创建 coinbase 交易, 奖励中包含手续费
+Transaction* Transaction::new_coinbase_tx(const string& to, long fees) {
     TXInput txin;
-    txin.txid = "None";
+    txin.txid = Hash256();
     txin.vout = 0;
     string uuid = generateUUID();
-    txin.signature = vector<unsigned char>(uuid.begin(), uuid.end());
-    TXOutput txout(SUBSIDY, to);
+    txin.signature.assign(uuid.begin(), uuid.end());
+    TXOutput txout(SUBSIDY + fees, to);
 
     // 生成交易 hash
-    Transaction* tx = new Transaction{"", {txin}, {txout}};
+    Transaction* tx = new Transaction();
+    tx->vin.push_back(txin);
+    tx->vout.push_back(txout);
     // 生成交易 ID
     tx->id = tx->hash();
     return tx;
@@ -158,6 +172,11 @@ Transaction* Transaction::new_coinbase_tx(const string& to) {
 
 // 创建一笔 UTXO 交易 
 Transaction* Transaction::new_utxo_transaction(const string& from, const string& to, int amount, UTXOSet* utxo_set) {
+    return new_utxo_transaction(from, to, amount, 0, utxo_set);
+}
+
+// 创建一笔支付手续费的 UTXO 交易
+Transaction* Transaction::new_utxo_transaction(const string& from, const string& to, int amount, int fee, UTXOSet* utxo_set) {
     // 查找钱包
     unique_ptr<Wallet> wallet(Wallet::load_wallet(from));
     if (wallet == nullptr) {
@@ -167,31 +186,28 @@ Transaction* Transaction::new_utxo_transaction(const string& from, const string&
     // 公钥哈希
     vector<unsigned char> pub_key_hash = hash_pub_key(wallet->get_public_key());
     // 找到足够的未花费输出
-    pair<int, map<string, vector<int>>> spendable_outputs = utxo_set->find_spendable_outputs(pub_key_hash, amount);
+    pair<int, map<Hash256, vector<int>>> spendable_outputs = utxo_set->find_spendable_outputs(pub_key_hash, amount + fee);
     int accumulated = spendable_outputs.first;
-    if (accumulated < amount) {
+    if (accumulated < amount + fee) {
         std::cerr << "ERROR: Not enough funds!" << std::endl;
         exit(1);
     }
     // 交易数据
-    map<string, vector<int>> valid_outputs = spendable_outputs.second;
-    vector<TXInput> inputs;
-    for (auto tx : valid_outputs) {
-        string txid = tx.first;
-        for (auto out : tx.second) {
-            TXInput txin = {txid, out, {}, wallet->get_public_key()};
-            inputs.push_back(txin);
+    map<Hash256, vector<int>> valid_outputs = spendable_outputs.second;
+    Transaction* tx = new Transaction();
+    for (auto& output : valid_outputs) {
+        Hash256 txid = output.first;
+        for (auto out : output.second) {
+            tx->vin.push_back(TXInput{txid, out, {}, wallet->get_public_key()});
         }
     }
     // 交易的输出
-    vector<TXOutput> outputs;
-    outputs.push_back(TXOutput(amount, to));
+    tx->vout.push_back(TXOutput(amount, to));
 
-    // 如果 UTXO 总数超过所需, 则产生找零
-    if (accumulated > amount) {
-        outputs.push_back(TXOutput(accumulated - amount, from)); 
+    // 如果 UTXO 总数超过所需, 则产生找零, 剩余部分作为手续费
+    if (accumulated > amount + fee) {
+        tx->vout.push_back(TXOutput(accumulated - amount - fee, from)); 
     }
-    Transaction* tx = new Transaction{"", inputs, outputs};
     // 生成交易 ID
     tx->id = tx->hash();
     // 交易中的 TXInput 签名
@@ -205,11 +221,14 @@ std::vector<unsigned char> Transaction::serialize_transaction() {
     size_t size = 0;
     // 数组长度
     size += sizeof(size_t);
+    // 交易 ID 按 16 进制字符串序列化(coinbase 输入为 "None"), 与交易哈希和签名的原有格式保持一致
+    vector<string> txids;
     for (auto& txin : this->vin) {
+        txids.push_back(txin.txid.to_string());
         // 字符串长度
         size += sizeof(size_t);
         // 加上 null 终止符
-        size += txin.txid.size() + 1;
+        size += txids.back().size() + 1;
         // vout
         size += sizeof(txin.vout);
         // signature
@@ -233,15 +252,16 @@ std::vector<unsigned char> Transaction::serialize_transaction() {
     size_t vin_size = this->vin.size();
     memcpy(ptr, &vin_size, sizeof(vin_size));
     ptr += sizeof(vin_size);
-    for (auto& txin : this->vin) {
+    for (size_t i = 0; i < this->vin.size(); i++) {
+        auto& txin = this->vin[i];
         // 字符串长度
-        size_t txid_size = txin.txid.size();
+        size_t txid_size = txids[i].size();
         memcpy(ptr, &txid_size, sizeof(txid_size));
         ptr += sizeof(txid_size);
         // 字符串内容
-        memcpy(ptr, txin.txid.c_str(), txin.txid.size() + 1);
+        memcpy(ptr, txids[i].c_str(), txid_size + 1);
         // 字符长度 + null 终止符
-        ptr += txin.txid.size() + 1;
+        ptr += txid_size + 1;
         // vout
         memcpy(ptr, &txin.vout, sizeof(txin.vout));
         ptr += sizeof(txin.vout);
@@ -291,7 +311,7 @@ Transaction* Transaction::deserialize_transaction(std::vector<unsigned char> dat
         // 字符串内容
         char *txid = new char[txid_size + 1];
         memcpy(txid, ptr, txid_size + 1);
-        txin.txid = txid;
+        Hash256::from_hex(txid, txin.txid);
         // 字符长度 + null 终止符
         ptr += txid_size + 1;
         // 释放内存
@@ -351,11 +371,11 @@ Transaction* Transaction::deserialize_transaction(std::vector<unsigned char> dat
 // 对象序列化
 string Transaction::to_json() {
     Json::Value root;
-    root["id"] = this->id;
+    root["id"] = this->id.to_string();
     Json::Value vin;
     for (auto& txin : this->vin) {
         Json::Value tx_vin;
-        tx_vin["txid"] = txin.txid;
+        tx_vin["txid"] = txin.txid.to_string();
         tx_vin["vout"] = txin.vout;
         // 字节数组转 base64
         tx_vin["signature"] = encode_base64(txin.signature);
@@ -383,13 +403,17 @@ Transaction* Transaction::from_json(const string& json) {
     if (!reader.parse(json, root)) {
         return nullptr;
     }
-    Transaction* tx = new Transaction();
-    tx->id = root["id"].asString();
+    unique_ptr<Transaction> tx(new Transaction());
+    if (!Hash256::from_hex(root["id"].asString(), tx->id)) {
+        return nullptr;
+    }
     Json::Value vin = root["vin"];
     if (vin.isArray()) {
         for (auto& tx_vin : vin) {
             TXInput txin;
-            txin.txid = tx_vin["txid"].asString();
+            if (!Hash256::from_hex(tx_vin["txid"].asString(), txin.txid)) {
+                return nullptr;
+            }
             txin.vout = tx_vin["vout"].asInt();
             // base64 转字节数组
             decode_base64(tx_vin["signature"].asString(), txin.signature);
@@ -407,6 +431,59 @@ Transaction* Transaction::from_json(const string& json) {
             tx->vout.push_back(txout);
         }
     }
-    return tx;
+    return tx.release();
 }
 
+// 二进制编码(区块存储格式)
+void Transaction::encode(Encoder& enc) {
+    this->id.encode(enc);
+    enc.put_varint(this->vin.size());
+    for (auto& txin : this->vin) {
+        txin.txid.encode(enc);
+        enc.put_u32(static_cast<uint32_t>(txin.vout));
+        enc.put_bytes(txin.signature);
+        enc.put_bytes(txin.pub_key);
+    }
+    enc.put_varint(this->vout.size());
+    for (auto& txout : this->vout) {
+        enc.put_u32(static_cast<uint32_t>(txout.value));
+        enc.put_bytes(txout.pub_key_hash);
+    }
+}
+
+// 读取交易 ID, 版本 1 为带长度前缀的 16 进制字符串
+bool Transaction::decode_id(Decoder& dec, uint8_t version, Hash256& id) {
+    if (version >= 2) {
+        return Hash256::decode(dec, id);
+    }
+    string hex;
+    return dec.get_string(hex) && Hash256::from_hex(hex, id);
+}
+
+// 二进制解码(区块存储格式), 输入输出和字节数组都从 tx 自己的内存来源分配
+bool Transaction::decode(Decoder& dec, uint8_t version, Transaction& tx) {
+    uint64_t vin_size, vout_size;
+    if (!decode_id(dec, version, tx.id) || !dec.get_varint(vin_size) || vin_size > dec.remaining()) {
+        return false;
+    }
+    tx.vin.resize(vin_size);
+    for (auto& txin : tx.vin) {
+        uint32_t vout;
+        if (!decode_id(dec, version, txin.txid) || !dec.get_u32(vout) || !dec.get_bytes(txin.signature) || !dec.get_bytes(txin.pub_key)) {
+            return false;
+        }
+        txin.vout = static_cast<int>(vout);
+    }
+    if (!dec.get_varint(vout_size) || vout_size > dec.remaining()) {
+        return false;
+    }
+    tx.vout.resize(vout_size);
+    for (auto& txout : tx.vout) {
+        uint32_t value;
+        if (!dec.get_u32(value) || !dec.get_bytes(txout.pub_key_hash)) {
+            return false;
+        }
+        txout.value = static_cast<int>(value);
+    }
+    return true;
+}
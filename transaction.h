@@ -1,6 +1,8 @@
 #pragma once
 
 #include <openssl/ecdsa.h>
+#include "codec.h"
+#include "hash256.h"
 #include "iostream"
 
 using namespace std;
@@ -9,12 +11,27 @@ using namespace std;
 class Blockchain;
 class UTXOSet;
 
+// 交易中各个对象使用的分配器, 放在 pmr 容器中时与容器使用同一个内存来源
+typedef std::pmr::polymorphic_allocator<unsigned char> TxAllocator;
+
 // 交易输入
 struct TXInput {
-    string txid; // 一个交易输入引用了之前一笔交易的一个输出, ID 表示是之前的哪一笔交易
+    typedef TxAllocator allocator_type;
+
+    Hash256 txid; // 一个交易输入引用了之前一笔交易的一个输出, ID 表示是之前的哪一笔交易, coinbase 输入为空哈希
     int vout; // 输出的索引
-    vector<unsigned char> signature; // 签名
-    vector<unsigned char> pub_key; // 公钥
+    Bytes signature; // 签名
+    Bytes pub_key; // 公钥
+
+    TXInput() = default;
+    explicit TXInput(const allocator_type& alloc);
+    TXInput(const Hash256& txid, int vout, ByteSpan signature, ByteSpan pub_key);
+    TXInput(const TXInput& other) = default;
+    TXInput(const TXInput& other, const allocator_type& alloc);
+    TXInput(TXInput&& other) = default;
+    TXInput(TXInput&& other, const allocator_type& alloc);
+    TXInput& operator=(const TXInput& other) = default;
+    TXInput& operator=(TXInput&& other) = default;
 
     // 检查公钥哈希是否能够解锁输出
     bool uses_key(vector<unsigned char>& pub_key_hash);
@@ -22,14 +39,23 @@ struct TXInput {
 
 // 交易输出
 struct TXOutput {
+    typedef TxAllocator allocator_type;
+
     int value; // 交易金额
-    vector<unsigned char> pub_key_hash; // 公钥哈希
+    Bytes pub_key_hash; // 公钥哈希
 
     // 构造函数
     TXOutput() = default;
+    explicit TXOutput(const allocator_type& alloc);
+    TXOutput(const TXOutput& other) = default;
+    TXOutput(const TXOutput& other, const allocator_type& alloc);
+    TXOutput(TXOutput&& other) = default;
+    TXOutput(TXOutput&& other, const allocator_type& alloc);
+    TXOutput& operator=(const TXOutput& other) = default;
+    TXOutput& operator=(TXOutput&& other) = default;
 
     // 构建输出
-    TXOutput(int value, vector<unsigned char> pub_key_hash);
+    TXOutput(int value, ByteSpan pub_key_hash);
     
     // 构造输出
     TXOutput(int value, const string& address);
@@ -41,18 +67,45 @@ struct TXOutput {
     bool is_locked_with_key(vector<unsigned char>& pub_key_hash);
 };
 
+// 交易输出的引用(交易 ID + 输出索引)
+struct OutPoint {
+    Hash256 txid;
+    int vout;
+
+    bool operator<(const OutPoint& other) const;
+
+    bool operator==(const OutPoint& other) const;
+};
+
+// OutPoint 的哈希函数, 用于 unordered_map
+struct OutPointHash {
+    size_t operator()(const OutPoint& outpoint) const;
+};
+
 // 交易
+// 输入输出及其字节数组都从同一个内存来源分配: 单独创建的交易使用堆内存, 解码得到的区块中的交易使用区块的 arena
 struct Transaction {
-    string id; // 交易 ID
-    vector<TXInput> vin; // 交易输入
-    vector<TXOutput> vout; // 交易输出
+    Hash256 id; // 交易 ID
+    std::pmr::vector<TXInput> vin; // 交易输入
+    std::pmr::vector<TXOutput> vout; // 交易输出
+
+    Transaction() = default;
+
+    // 从 resource 分配输入输出
+    explicit Transaction(std::pmr::memory_resource* resource);
 
     // 创建 coinbase 交易, 该交易没有输入, 只有一个输出
     static Transaction* new_coinbase_tx(const string& to);
 
+    // 创建 coinbase 交易, 奖励中包含区块内交易的手续费
+    static Transaction* new_coinbase_tx(const string& to, long fees);
+
     // 创建一笔 UTXO 交易 
     static Transaction* new_utxo_transaction(const string& from, const string& to, int amount, UTXOSet* utxo_set);
 
+    // 创建一笔支付手续费的 UTXO 交易, 找零扣除手续费
+    static Transaction* new_utxo_transaction(const string& from, const string& to, int amount, int fee, UTXOSet* utxo_set);
+
     // 从字节数组序列化为交易
     static Transaction* deserialize_transaction(std::vector<unsigned char> data);
 
@@ -62,8 +115,8 @@ struct Transaction {
     // 判断是否是 coinbase 交易
     bool is_coinbase();
 
-    // 交易哈希(16进制)
-    string hash();
+    // 交易哈希
+    Hash256 hash();
 
     // 创建一个修剪后的交易副本
     Transaction* trimmed_copy();
@@ -71,10 +124,13 @@ struct Transaction {
     // 克隆交易
     Transaction* clone();
 
+    // 签名的消息: 修剪后的交易副本(不含签名和公钥)的序列化, 所有输入共用
+    std::vector<unsigned char> signature_message();
+
     // 对交易的每个输入进行签名
     void sign(Blockchain* bc, EC_KEY* ec_key);
 
-    // 对交易的每个输入进行验证
+    // 对交易的每个输入进行验证, 输入引用的交易不在链上时返回 false
     bool verify(Blockchain* bc);
 
     // 对象序列化
@@ -82,5 +138,14 @@ struct Transaction {
 
     // 对象反序列化
     static Transaction* from_json(const string& json);
+
+    // 二进制编码(区块存储格式), 交易 ID 按 32 字节原始数据写入
+    void encode(Encoder& enc);
+
+    // 二进制解码(区块存储格式)到 tx 中, version 为区块格式版本, 版本 1 的交易 ID 是带长度前缀的 16 进制字符串
+    static bool decode(Decoder& dec, uint8_t version, Transaction& tx);
+
+    // 读取交易 ID, 版本 1 为带长度前缀的 16 进制字符串
+    static bool decode_id(Decoder& dec, uint8_t version, Hash256& id);
 };
 
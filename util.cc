@@ -25,7 +25,7 @@ long current_timestamp() {
 }
 
 // 比较两个 vector 是否相等
-bool are_vectors_equal(const std::vector<unsigned char>& v1, const std::vector<unsigned char>& v2) {
+bool are_vectors_equal(ByteSpan v1, ByteSpan v2) {
     if (v1.size() != v2.size()) {
         return false;
     }
@@ -33,7 +33,7 @@ bool are_vectors_equal(const std::vector<unsigned char>& v1, const std::vector<u
 }
 
 // 计算 sha256 摘要
-vector<unsigned char> sha256_digest(vector<unsigned char> bytes) {
+vector<unsigned char> sha256_digest(ByteSpan bytes) {
     unsigned char hash[SHA256_DIGEST_LENGTH];
     SHA256_CTX sha256;
     SHA256_Init(&sha256);
@@ -83,6 +83,30 @@ string to_hex(long num) {
     return ss.str();
 }
 
+// 16 进制字符串转换为字节数组
+bool from_hex(const string& hex, vector<unsigned char>& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    bytes.clear();
+    bytes.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int hi = nibble(hex[i]);
+        int lo = nibble(hex[i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        bytes.push_back(static_cast<unsigned char>((hi << 4) | lo));
+    }
+    return true;
+}
+
 // 创建密钥对( ECDSA 椭圆曲线)
 EC_KEY* new_ecdsa_key_pair() {
     EC_KEY* eckey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
@@ -114,24 +138,44 @@ vector<unsigned char> ecdsa_p256_sha256_sign_digest(EC_KEY* eckey, const vector<
     return signature_vec;
 }
 
-// ECDSA 验证签名
-bool ecdsa_p256_sha256_sign_verify(const vector<unsigned char>& public_key, const vector<unsigned char>& signature, const vector<unsigned char>& digest) {
-    // 解码 DER 格式的公钥
+// 解码公钥
+EC_KEY* ecdsa_p256_public_key(ByteSpan public_key) {
+    // 解码公钥(椭圆曲线上的点)
     // https://www.openssl.org/docs/man1.1.1/man3/d2i_EC_PUBKEY.html 
     EC_KEY* eckey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
     const unsigned char* public_key_ptr = public_key.data();
-    o2i_ECPublicKey(&eckey, &public_key_ptr, public_key.size()); 
+    if (o2i_ECPublicKey(&eckey, &public_key_ptr, public_key.size()) == nullptr) {
+        EC_KEY_free(eckey);
+        return nullptr;
+    }
+    return eckey;
+}
+
+// ECDSA 验证签名
+bool ecdsa_p256_sha256_sign_verify(ByteSpan public_key, ByteSpan signature, const vector<unsigned char>& digest) {
+    EC_KEY* eckey = ecdsa_p256_public_key(public_key);
+    if (eckey == nullptr) {
+        return false;
+    }
+    bool result = ecdsa_p256_sha256_sign_verify(eckey, signature, digest);
+    EC_KEY_free(eckey);
+    return result;
+}
+
+// ECDSA 验证签名, 使用已解码的公钥
+bool ecdsa_p256_sha256_sign_verify(EC_KEY* eckey, ByteSpan signature, const vector<unsigned char>& digest) {
     // 解码 DER 格式的签名
     // https://www.openssl.org/docs/man1.1.1/man3/d2i_ECDSA_SIG.html
-    ECDSA_SIG* ecdsa_sig = ECDSA_SIG_new();
     const unsigned char* signature_ptr = signature.data();
-    d2i_ECDSA_SIG(&ecdsa_sig, &signature_ptr, signature.size());
-    // 验证签名
+    ECDSA_SIG* ecdsa_sig = d2i_ECDSA_SIG(nullptr, &signature_ptr, signature.size());
+    if (ecdsa_sig == nullptr) {
+        return false;
+    }
+    // 验证签名, 出错时返回 -1, 只有 1 表示签名有效
     int result = ECDSA_do_verify(digest.data(), digest.size(), ecdsa_sig, eckey);
     // 释放资源
     ECDSA_SIG_free(ecdsa_sig);
-    EC_KEY_free(eckey);
-    return result;
+    return result == 1;
 }
 
 // All alphanumeric characters except for "0", "I", "O", and "l"
@@ -239,7 +283,7 @@ bool decode_base58(const std::string& str, std::vector<unsigned char>& vchRet) {
 }
 
 // 编码 base64
-string encode_base64(const vector<unsigned char>& vch) {
+string encode_base64(ByteSpan vch) {
     BIO* b64_bio = BIO_new(BIO_f_base64());
     BIO_set_flags(b64_bio, BIO_FLAGS_BASE64_NO_NL);
 
@@ -279,6 +323,16 @@ bool decode_base64(const string& str, vector<unsigned char>& vchRet) {
     return false;
 }
 
+// 解码 base64, 使用 vchRet 自身的内存来源
+bool decode_base64(const string& str, Bytes& vchRet) {
+    vector<unsigned char> buffer;
+    if (!decode_base64(str, buffer)) {
+        return false;
+    }
+    vchRet.assign(buffer.begin(), buffer.end());
+    return true;
+}
+
 // 创建目录
 bool create_directory(const string& path) {
     struct stat st;
@@ -5,6 +5,7 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include "codec.h"
 
 using namespace std;
 
@@ -12,10 +13,10 @@ using namespace std;
 long current_timestamp();
 
 // 比较两个 vector 是否相等
-bool are_vectors_equal(const std::vector<unsigned char>& v1, const std::vector<unsigned char>& v2);
+bool are_vectors_equal(ByteSpan v1, ByteSpan v2);
 
 // 计算 sha256 摘要
-vector<unsigned char> sha256_digest(vector<unsigned char> bytes);
+vector<unsigned char> sha256_digest(ByteSpan bytes);
 
 // 计算 sha256 16 进制摘要
 string sha256_digest_hex(vector<unsigned char> bytes);
@@ -29,6 +30,9 @@ string to_hex(vector<unsigned char> bytes);
 // 转换为 16 进制
 string to_hex(long num);
 
+// 16 进制字符串转换为字节数组, 格式错误时返回 false
+bool from_hex(const string& hex, vector<unsigned char>& bytes);
+
 // 创建密钥对( ECDSA 椭圆曲线)
 EC_KEY* new_ecdsa_key_pair();
 
@@ -38,8 +42,14 @@ vector<unsigned char> get_private_key(EC_KEY* ec_key);
 // ECDSA 签名
 vector<unsigned char> ecdsa_p256_sha256_sign_digest(EC_KEY* eckey, const vector<unsigned char>& digest);
 
+// 解码公钥, 无效时返回 nullptr
+EC_KEY* ecdsa_p256_public_key(ByteSpan public_key);
+
 // ECDSA 验证签名
-bool ecdsa_p256_sha256_sign_verify(const vector<unsigned char>& public_key, const vector<unsigned char>& signature, const vector<unsigned char>& digest);
+bool ecdsa_p256_sha256_sign_verify(ByteSpan public_key, ByteSpan signature, const vector<unsigned char>& digest);
+
+// ECDSA 验证签名, 使用已解码的公钥
+bool ecdsa_p256_sha256_sign_verify(EC_KEY* eckey, ByteSpan signature, const vector<unsigned char>& digest);
 
 // 编码 base58
 std::string encode_base58(const std::vector<unsigned char>& vch);
@@ -48,11 +58,14 @@ std::string encode_base58(const std::vector<unsigned char>& vch);
 bool decode_base58(const std::string& str, std::vector<unsigned char>& vchRet);
 
 // 编码 base64
-string encode_base64(const vector<unsigned char>& vch);
+string encode_base64(ByteSpan vch);
 
 // 解码 base64
 bool decode_base64(const string& str, vector<unsigned char>& vchRet);
 
+// 解码 base64, 使用 vchRet 自身的内存来源
+bool decode_base64(const string& str, Bytes& vchRet);
+
 // 创建目录
 bool create_directory(const string& path);
 
@@ -1,5 +1,5 @@
-#include <json/json.h>
 #include "blockchain.h"
+#include "config.h"
 #include "rocksdb/db.h"
 #include "util.h"
 #include "utxo_set.h"
@@ -12,17 +12,62 @@ using ROCKSDB_NAMESPACE::WriteBatch;
 using ROCKSDB_NAMESPACE::WriteOptions;
 
 const string utxoDBPath = "./data/chainstate";
+// chainstate 格式版本, 版本不一致时需要重建. 版本 3 起交易 ID 和区块哈希按 32 字节原始数据存放
+const string chainstateVersionKey = "chainstate_version";
+const string chainstateVersion = "3";
+// UTXO 键前缀, (txid, vout) -> TXOutput
+const string utxoPrefix = "utxo:";
+// 地址索引键前缀, (pub_key_hash, txid, vout) -> value
+const string addressPrefix = "addr:";
+// 撤销记录键前缀, 区块哈希 -> 区块花费的输出
+const string undoPrefix = "undo:";
+// 最新区块标记, UTXO 集反映到该区块为止的状态
+const string bestBlockKey = "best_block";
+
+// UTXO 键
+string utxo_key(const Hash256& txid, int vout);
+
+// 地址索引键前缀
+string address_prefix(ByteSpan pub_key_hash);
+
+// 地址索引键
+string address_key(ByteSpan pub_key_hash, const Hash256& txid, int vout);
+
+// 从键尾部解析 (txid, vout)
+OutPoint parse_outpoint(rocksdb::Slice key, size_t prefix_len);
 
 // 交易输出序列化
-string txouts_to_json(vector<TXOutput> txouts);
+string encode_txout(const TXOutput& txout);
 
 // 交易输出反序列化
-vector<TXOutput> txouts_from_json(string json_str);
+bool decode_txout(const string& bytes, TXOutput& txout);
+
+// 撤销记录序列化
+string encode_undo(const vector<pair<OutPoint, TXOutput>>& spent);
+
+// 撤销记录反序列化
+bool decode_undo(const string& bytes, vector<pair<OutPoint, TXOutput>>& spent);
 
 // 构造函数
-UTXOSet::UTXOSet(Blockchain* bc, DB* db) {
+UTXOSet::UTXOSet(Blockchain* bc, DB* db)
+    : coins([db](const OutPoint& outpoint, TXOutput& txout) {
+          string txout_bytes;
+          Status status = db->Get(ReadOptions(), utxo_key(outpoint.txid, outpoint.vout), &txout_bytes);
+          return status.ok() && decode_txout(txout_bytes, txout);
+      }),
+      max_usage(Config::get_instance()->get_coins_cache_size()), undo_usage(0) {
     this->bc = bc;
     this->db = db;
+    this->best_height = -1;
+    // 加载最新区块标记
+    string marker;
+    if (db->Get(ReadOptions(), bestBlockKey, &marker).ok()) {
+        Decoder dec(marker);
+        uint64_t height;
+        if (Hash256::decode(dec, best_block) && dec.get_u64(height)) {
+            best_height = static_cast<long>(height);
+        }
+    }
 }
 
 // 打开 UTXO 数据库
@@ -47,63 +92,82 @@ UTXOSet* UTXOSet::new_utxo_set(Blockchain *bc) {
         std::cerr << "Failed to create utxo_set directory: " << utxoDBPath << std::endl;
         exit(1);
     }
-    return new UTXOSet(bc, open_utxo_db());
+    UTXOSet* utxo_set = new UTXOSet(bc, open_utxo_db());
+    // 旧格式的 chainstate 需要重建
+    string version;
+    utxo_set->db->Get(ReadOptions(), chainstateVersionKey, &version);
+    if (version != chainstateVersion) {
+        utxo_set->reindex();
+    } else {
+        // 上次没有写回就退出时, 从数据库中的最新区块标记处重新连接
+        utxo_set->sync();
+        utxo_set->flush();
+    }
+    return utxo_set;
 }
 
 // 找到未花费的输出
-pair<int, map<string, vector<int>>> UTXOSet::find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount) {
-    map<string, vector<int>> unspent_outputs;
+pair<int, map<Hash256, vector<int>>> UTXOSet::find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount) {
+    // 地址索引只在数据库中, 先写回缓存
+    flush();
+    map<Hash256, vector<int>> unspent_outputs;
     int accumulated = 0;
+    string prefix = address_prefix(pub_key_hash);
     unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        string txid = it->key().ToString();
-        string value = it->value().ToString();
-        vector<TXOutput> txouts = txouts_from_json(value);
-        for (int out_idx = 0; out_idx < txouts.size(); out_idx++) {
-            TXOutput txout = txouts[out_idx];
-            if (txout.is_locked_with_key(pub_key_hash) && accumulated < amount) {
-                accumulated += txout.value;
-                unspent_outputs[txid].push_back(out_idx);
-            }
-            if (accumulated >= amount) {
-                goto endloop;
-            }
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix) && accumulated < amount; it->Next()) {
+        OutPoint outpoint = parse_outpoint(it->key(), prefix.size());
+        Decoder dec(it->value().data(), it->value().size());
+        uint32_t value;
+        if (!dec.get_u32(value)) {
+            continue;
         }
+        accumulated += static_cast<int>(value);
+        unspent_outputs[outpoint.txid].push_back(outpoint.vout);
     }
-    endloop:
     return make_pair(accumulated, unspent_outputs);
 }
 
 // 通过公钥哈希查找 UTXO 集
 vector<TXOutput> UTXOSet::find_utxo(vector<unsigned char>& pub_key_hash) {
-    unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
+    flush();
     vector<TXOutput> utxos;
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        string txid = it->key().ToString();
-        string value = it->value().ToString();
-        vector<TXOutput> txouts = txouts_from_json(value);
-        for (int out_idx = 0; out_idx < txouts.size(); out_idx++) {
-            TXOutput txout = txouts[out_idx];
-            if (txout.is_locked_with_key(pub_key_hash)) {
-                utxos.push_back(txout);
-            }
+    string prefix = address_prefix(pub_key_hash);
+    unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        Decoder dec(it->value().data(), it->value().size());
+        uint32_t value;
+        if (!dec.get_u32(value)) {
+            continue;
         }
+        utxos.push_back(TXOutput(static_cast<int>(value), pub_key_hash));
     }
     return utxos;
 }
 
 // 统计 UTXO 集合中的交易数量
 int UTXOSet::count_transactions() {
+    flush();
     unique_ptr<rocksdb::Iterator> it(db->NewIterator(ReadOptions()));
     int count = 0;
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        count++;
+    Hash256 last_txid;
+    // 同一交易的输出键相邻
+    for (it->Seek(utxoPrefix); it->Valid() && it->key().starts_with(utxoPrefix); it->Next()) {
+        Hash256 txid = parse_outpoint(it->key(), utxoPrefix.size()).txid;
+        if (count == 0 || txid != last_txid) {
+            count++;
+            last_txid = txid;
+        }
     }
     return count;
 }
 
 // 重建 UTXO 集
 void UTXOSet::reindex() {
+    // 丢弃尚未写回的修改
+    coins.clear();
+    pending_undo.clear();
+    erased_undo.clear();
+    undo_usage = 0;
     unique_ptr<rocksdb::Iterator> iter(db->NewIterator(ReadOptions()));
     // 清空数据库
     WriteBatch batch;
@@ -119,10 +183,13 @@ void UTXOSet::reindex() {
     auto utxo_map = bc->find_utxo();
     WriteBatch batch_write;
     for (auto it = utxo_map.begin(); it != utxo_map.end(); it++) {
-        string txid = it->first;
-        string value = txouts_to_json(it->second);
-        batch_write.Put(txid, value);
+        const OutPoint& outpoint = it->first;
+        const TXOutput& txout = it->second;
+        batch_write.Put(utxo_key(outpoint.txid, outpoint.vout), encode_txout(txout));
+        batch_write.Put(address_key(txout.pub_key_hash, outpoint.txid, outpoint.vout), encode_txout(txout));
     }
+    batch_write.Put(chainstateVersionKey, chainstateVersion);
+    set_best_block(batch_write, bc->get_tip_hash(), bc->get_last_height());
     status = db->Write(WriteOptions(), &batch_write);
     if (!status.ok()) {
         std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
@@ -130,35 +197,211 @@ void UTXOSet::reindex() {
     } 
 }
 
-// 使用来自区块的交易更新 UTXO 集
-void UTXOSet::update(Block *block) {
-    WriteBatch batch;
+// 查询未花费的输出
+bool UTXOSet::get_output(const OutPoint& outpoint, TXOutput& txout) {
+    return coins.get(outpoint, txout);
+}
+
+// 检查区块的输入都引用未花费的输出
+bool UTXOSet::check_inputs(Block *block) {
+    // 不接在最新区块之后的区块无法按当前的 UTXO 集检查, 连接时再检查
+    bool connects = best_height < 0 ? block->height == 0 : block->pre_block_hash == best_block;
+    if (!connects) {
+        return true;
+    }
+    // 区块内的交易可以花费前面交易的输出, 同一输出只能花费一次
+    set<OutPoint> created;
+    set<OutPoint> spent;
     for (auto tx : block->transactions) {
         if (!tx->is_coinbase()) {
-            for (auto vin : tx->vin) {
-                string txouts_bytes;
-                Status status = db->Get(ReadOptions(), vin.txid, &txouts_bytes);
-                if (!status.ok()) {
-                    std::cerr << "Failed to get txid: " << vin.txid << std::endl; 
-                    exit(1);
+            for (auto& vin : tx->vin) {
+                OutPoint outpoint{vin.txid, vin.vout};
+                if (!spent.insert(outpoint).second) {
+                    return false;
                 }
-                vector<TXOutput> txouts = txouts_from_json(txouts_bytes);
-                // 删除已经花费的输出
-                vector<TXOutput> updated_outs;
-                for (int idx = 0; idx < txouts.size(); idx++) {
-                    if (idx != vin.vout) {
-                        updated_outs.push_back(txouts[idx]);
-                    }
+                TXOutput txout;
+                if (!created.count(outpoint) && !coins.get(outpoint, txout)) {
+                    return false;
                 }
-                if (updated_outs.empty()) {
-                    batch.Delete(vin.txid);
-                } else {
-                    batch.Put(vin.txid, txouts_to_json(updated_outs));
+            }
+        }
+        for (size_t idx = 0; idx < tx->vout.size(); idx++) {
+            created.insert(OutPoint{tx->id, static_cast<int>(idx)});
+        }
+    }
+    return true;
+}
+
+// 使用来自区块的交易更新 UTXO 集(连接区块), 同时保存撤销记录
+bool UTXOSet::update(Block *block) {
+    // 区块必须接在最新区块之后, 否则按主链同步
+    bool connects = best_height < 0 ? block->height == 0 : block->pre_block_hash == best_block;
+    if (!connects) {
+        return sync();
+    }
+    // 先检查全部输入, 失败时 UTXO 集保持不变
+    if (!check_inputs(block)) {
+        std::cerr << "Failed to connect block " << block->hash << ": spends a missing or spent output" << std::endl;
+        return false;
+    }
+    // 本区块新增的输出, 区块内的交易可以花费前面交易的输出
+    map<OutPoint, TXOutput> created;
+    // 本区块花费的输出, 回滚时恢复
+    vector<pair<OutPoint, TXOutput>> spent;
+    for (auto tx : block->transactions) {
+        if (!tx->is_coinbase()) {
+            for (auto vin : tx->vin) {
+                OutPoint outpoint{vin.txid, vin.vout};
+                if (created.erase(outpoint) > 0) {
+                    continue;
                 }
+                TXOutput txout;
+                coins.spend(outpoint, txout);
+                spent.push_back(make_pair(outpoint, txout));
             }
         }
-        batch.Put(tx->id, txouts_to_json(tx->vout));
+        for (size_t idx = 0; idx < tx->vout.size(); idx++) {
+            created[OutPoint{tx->id, static_cast<int>(idx)}] = tx->vout[idx];
+        }
+    }
+    // 新交易的输出一定不在数据库中
+    for (auto& kv : created) {
+        coins.add(kv.first, kv.second, true);
+    }
+    string undo = encode_undo(spent);
+    undo_usage += undo.size();
+    pending_undo[block->hash] = undo;
+    erased_undo.erase(block->hash);
+    best_block = block->hash;
+    best_height = block->height;
+    if (coins.usage() + undo_usage > max_usage) {
+        flush();
+    }
+    return true;
+}
+
+// 回滚最新连接的区块(断开区块)
+bool UTXOSet::disconnect(Block *block) {
+    if (block->hash != best_block) {
+        std::cerr << "Failed to disconnect block " << block->hash << ": not the best block" << std::endl;
+        exit(1);
+    }
+    // 撤销记录可能还没有写回
+    vector<pair<OutPoint, TXOutput>> spent;
+    bool found;
+    auto pending = pending_undo.find(block->hash);
+    if (pending != pending_undo.end()) {
+        found = decode_undo(pending->second, spent);
+    } else {
+        string undo_bytes;
+        Status status = db->Get(ReadOptions(), undoPrefix + block->hash.raw(), &undo_bytes);
+        found = status.ok() && decode_undo(undo_bytes, spent);
+    }
+    if (!found) {
+        // 无法回滚, 只能重建
+        std::cerr << "Missing undo record of block " << block->hash << ", rebuilding the UTXO set" << std::endl;
+        reindex();
+        return false;
+    }
+    // 删除区块创建的输出, 在区块内已经被花费的输出不在 UTXO 集中
+    for (auto tx : block->transactions) {
+        for (size_t idx = 0; idx < tx->vout.size(); idx++) {
+            TXOutput txout;
+            coins.spend(OutPoint{tx->id, static_cast<int>(idx)}, txout);
+        }
+    }
+    // 恢复区块花费的输出
+    for (auto& kv : spent) {
+        coins.add(kv.first, kv.second, false);
+    }
+    if (pending != pending_undo.end()) {
+        undo_usage -= pending->second.size();
+        pending_undo.erase(pending);
     }
+    erased_undo.insert(block->hash);
+    best_block = block->height > 0 ? block->pre_block_hash : Hash256();
+    best_height = block->height - 1;
+    return true;
+}
+
+// 与区块链主链同步, 回滚分叉区块并连接新区块
+bool UTXOSet::sync() {
+    // 从链尾沿父区块回溯到最新区块的高度, 记下需要连接的区块
+    vector<Hash256> path;
+    Hash256 hash = bc->get_tip_hash();
+    long height = bc->get_last_height();
+    BlockHeader header;
+    while (height > best_height) {
+        path.push_back(hash);
+        if (!bc->get_header(hash, header)) {
+            reindex();
+            return true;
+        }
+        hash = header.pre_block_hash;
+        height--;
+    }
+    // 回滚不在链尾祖先中的区块, 直到与链尾的共同祖先
+    while (best_height >= 0 && (best_height != height || best_block != hash)) {
+        shared_ptr<Block> block = bc->get_block(best_block);
+        if (block == nullptr || !disconnect(block.get())) {
+            // 无法回滚, 已经或者只能重建
+            if (block == nullptr) {
+                reindex();
+            }
+            return true;
+        }
+        if (best_height < height) {
+            path.push_back(hash);
+            if (!bc->get_header(hash, header)) {
+                reindex();
+                return true;
+            }
+            hash = header.pre_block_hash;
+            height--;
+        }
+    }
+    // 按高度连接新区块, 遇到尚未下载的区块时停止
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+        shared_ptr<Block> block = bc->get_block(*it);
+        if (block == nullptr) {
+            break;
+        }
+        if (!update(block.get())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// UTXO 集对应的最新区块哈希
+Hash256 UTXOSet::get_best_block() {
+    return best_block;
+}
+
+// 把缓存中的修改, 撤销记录和最新区块标记写回数据库
+// 三者在同一个批次中写入, 数据库中的最新区块标记总是与其中的输出一致
+void UTXOSet::flush() {
+    WriteBatch batch;
+    coins.flush([&batch](const OutPoint& outpoint, const TXOutput& txout, bool spent) {
+        if (spent) {
+            batch.Delete(utxo_key(outpoint.txid, outpoint.vout));
+            batch.Delete(address_key(txout.pub_key_hash, outpoint.txid, outpoint.vout));
+        } else {
+            string txout_bytes = encode_txout(txout);
+            batch.Put(utxo_key(outpoint.txid, outpoint.vout), txout_bytes);
+            batch.Put(address_key(txout.pub_key_hash, outpoint.txid, outpoint.vout), txout_bytes);
+        }
+    });
+    for (auto& kv : pending_undo) {
+        batch.Put(undoPrefix + kv.first.raw(), kv.second);
+    }
+    for (auto& block_hash : erased_undo) {
+        batch.Delete(undoPrefix + block_hash.raw());
+    }
+    pending_undo.clear();
+    erased_undo.clear();
+    undo_usage = 0;
+    set_best_block(batch, best_block, best_height);
     Status status = db->Write(WriteOptions(), &batch);
     if (!status.ok()) {
         std::cerr << "Failed to write database: " << status.ToString() << std::endl; 
@@ -166,6 +409,21 @@ void UTXOSet::update(Block *block) {
     }
 }
 
+// 未花费输出缓存统计
+CoinsCacheStats UTXOSet::cache_stats() {
+    return coins.stats();
+}
+
+// 写入最新区块标记
+void UTXOSet::set_best_block(WriteBatch& batch, const Hash256& block_hash, long height) {
+    best_block = block_hash;
+    best_height = height;
+    Encoder enc;
+    block_hash.encode(enc);
+    enc.put_u64(static_cast<uint64_t>(height));
+    batch.Put(bestBlockKey, enc.data());
+}
+
 // 清空数据
 void UTXOSet::clear_data() {
     Status status = rocksdb::DestroyDB(utxoDBPath, Options());
@@ -180,41 +438,96 @@ Blockchain* UTXOSet::blockchain() {
     return bc;
 }
 
-// 将 TXOutput 转换为 JSON
-string txouts_to_json(vector<TXOutput> txouts) {
-    Json::Value root;
-    for (auto vout : txouts) {
-        Json::Value txout;
-        txout["value"] = vout.value;
-        txout["pub_key_hash"] = encode_base64(vout.pub_key_hash);
-        root.append(txout); 
+// UTXO 键, vout 按大端序编码, 同一交易的输出按索引排列
+string utxo_key(const Hash256& txid, int vout) {
+    string key = utxoPrefix + txid.raw();
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        key.push_back(static_cast<char>((static_cast<uint32_t>(vout) >> shift) & 0xff));
     }
-    Json::FastWriter writer;
-    return writer.write(root);
+    return key;
 }
 
-// 将 JSON 转换为 TXOutput
-vector<TXOutput> txouts_from_json(string json_str) {
-    Json::Reader reader;
-    Json::Value root;
-    if (!reader.parse(json_str, root)) {
-        std::cerr << "Failed to parse json string: " << json_str << std::endl;
-        exit(1);
+// 地址索引键前缀, 公钥哈希带长度, 避免不同长度的哈希互为前缀
+string address_prefix(ByteSpan pub_key_hash) {
+    string prefix = addressPrefix;
+    prefix.push_back(static_cast<char>(pub_key_hash.size()));
+    prefix.append(pub_key_hash.begin(), pub_key_hash.end());
+    return prefix;
+}
+
+// 地址索引键
+string address_key(ByteSpan pub_key_hash, const Hash256& txid, int vout) {
+    return address_prefix(pub_key_hash) + utxo_key(txid, vout).substr(utxoPrefix.size());
+}
+
+// 从键尾部解析 (txid, vout)
+OutPoint parse_outpoint(rocksdb::Slice key, size_t prefix_len) {
+    OutPoint outpoint;
+    outpoint.txid = Hash256::from_raw(key.data() + prefix_len);
+    uint32_t vout = 0;
+    for (size_t i = key.size() - 4; i < key.size(); i++) {
+        vout = (vout << 8) | static_cast<uint8_t>(key[i]);
+    }
+    outpoint.vout = static_cast<int>(vout);
+    return outpoint;
+}
+
+// 交易输出序列化
+string encode_txout(const TXOutput& txout) {
+    Encoder enc;
+    enc.put_u32(static_cast<uint32_t>(txout.value));
+    enc.put_bytes(txout.pub_key_hash);
+    return enc.data();
+}
+
+// 交易输出反序列化
+bool decode_txout(const string& bytes, TXOutput& txout) {
+    Decoder dec(bytes);
+    uint32_t value;
+    if (!dec.get_u32(value) || !dec.get_bytes(txout.pub_key_hash)) {
+        return false;
     }
-    vector<TXOutput> txouts;
-    for (auto txout : root) {
-        TXOutput vout;
-        vout.value = txout["value"].asInt();
-        decode_base64(txout["pub_key_hash"].asString(), vout.pub_key_hash);
-        txouts.push_back(vout);
+    txout.value = static_cast<int>(value);
+    return true;
+}
+
+// 撤销记录序列化
+string encode_undo(const vector<pair<OutPoint, TXOutput>>& spent) {
+    Encoder enc;
+    enc.put_varint(spent.size());
+    for (auto& kv : spent) {
+        kv.first.txid.encode(enc);
+        enc.put_u32(static_cast<uint32_t>(kv.first.vout));
+        enc.put_string(encode_txout(kv.second));
     }
-    return txouts;
+    return enc.data();
+}
+
+// 撤销记录反序列化
+bool decode_undo(const string& bytes, vector<pair<OutPoint, TXOutput>>& spent) {
+    Decoder dec(bytes);
+    uint64_t count;
+    if (!dec.get_varint(count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        OutPoint outpoint;
+        uint32_t vout;
+        string txout_bytes;
+        TXOutput txout;
+        if (!Hash256::decode(dec, outpoint.txid) || !dec.get_u32(vout) || !dec.get_string(txout_bytes) || !decode_txout(txout_bytes, txout)) {
+            return false;
+        }
+        outpoint.vout = static_cast<int>(vout);
+        spent.push_back(make_pair(outpoint, txout));
+    }
+    return true;
 }
 
 // 析构函数
 UTXOSet::~UTXOSet() {
-    // 关闭数据库
+    // 写回缓存后关闭数据库
+    flush();
     delete db;
     db = nullptr;
 }
-
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <set>
 #include "blockchain.h"
+#include "coins_cache.h"
 
 // UTXO 集
+// 连接和断开区块的修改先记录在未花费输出缓存中, 撤销记录和最新区块标记也暂存在内存里,
+// 缓存超过内存上限或关闭时在同一个批次中写回数据库. 数据库中的最新区块标记总是与其中的输出一致,
+// 进程异常退出后重新打开时从标记处重新连接之后的区块即可恢复.
+// 不是线程安全的, 节点中由 chain_mutex 保护
 class UTXOSet {
 public:
     // 构造函数
@@ -18,24 +24,58 @@ public:
     static void clear_data();
 
     // 找到未花费的输出
-    pair<int, map<string, vector<int>>> find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount); 
+    pair<int, map<Hash256, vector<int>>> find_spendable_outputs(vector<unsigned char>& pub_key_hash, int amount); 
 
     // 通过公钥哈希查找 UTXO 集
     vector<TXOutput> find_utxo(vector<unsigned char>& pub_key_hash);
 
+    // 查询未花费的输出, 不存在或已花费时返回 false
+    bool get_output(const OutPoint& outpoint, TXOutput& txout);
+
     // 统计 UTXO 集合中的交易数量
     int count_transactions();
 
     // 重建 UTXO 集
     void reindex();
 
-    // 使用来自区块的交易更新 UTXO 集
-    void update(Block *block);
+    // 区块接在最新区块之后时, 检查每个输入都引用未花费的输出(或区块内前面交易的输出)且没有重复花费.
+    // 不接在最新区块之后的区块无法检查, 返回 true, 连接时再检查
+    bool check_inputs(Block *block);
+
+    // 使用来自区块的交易更新 UTXO 集(连接区块), 同时保存撤销记录.
+    // 区块花费不存在或已花费的输出时 UTXO 集保持不变, 返回 false
+    bool update(Block *block);
+
+    // 回滚最新连接的区块(断开区块). 撤销记录缺失时重建 UTXO 集并返回 false
+    bool disconnect(Block *block);
+
+    // 与区块链主链同步: 沿链尾的父区块找到与最新区块的共同祖先, 回滚分叉区块并连接新区块.
+    // 有区块无法连接时停在它之前, 返回 false
+    bool sync();
+
+    // UTXO 集对应的最新区块哈希
+    Hash256 get_best_block();
+
+    // 把缓存中的修改, 撤销记录和最新区块标记写回数据库
+    void flush();
+
+    // 未花费输出缓存统计
+    CoinsCacheStats cache_stats();
 
     // 区块链
     Blockchain* blockchain();
 private:
     Blockchain *bc;
     DB* db; 
+    Hash256 best_block; // UTXO 集对应的最新区块
+    long best_height; // UTXO 集对应的最新区块高度
+    CoinsCache coins; // 未花费输出缓存
+    size_t max_usage; // 缓存内存上限, 包括暂存的撤销记录
+    map<Hash256, string> pending_undo; // 尚未写回的撤销记录
+    set<Hash256> erased_undo; // 已断开区块的撤销记录, 写回时删除
+    size_t undo_usage; // 暂存的撤销记录大小
+
+    // 写入最新区块标记
+    void set_best_block(WriteBatch& batch, const Hash256& block_hash, long height);
 };
 
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include "blockchain.h"
+#include "util.h"
+#include "utxo_set.h"
+#include "wallet.h"
+
+// 打开测试用的数据库, reset 为 true 时先清空
+static DB* open_db(const string& path, bool reset) {
+    if (reset) {
+        rocksdb::DestroyDB(path, rocksdb::Options());
+    }
+    EXPECT_TRUE(create_directory(path));
+    DB* db;
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    EXPECT_TRUE(DB::Open(options, path, &db).ok());
+    return db;
+}
+
+// 挖一个接在 parent 之后的区块, 除 coinbase 外包含 txs
+static Block* mine_after(Block* parent, Wallet* wallet, vector<Transaction*> txs = {}) {
+    txs.insert(txs.begin(), Transaction::new_coinbase_tx(wallet->get_address()));
+    return new_block(parent->hash, txs, parent->height + 1);
+}
+
+// 未花费输出集合与区块链主链的计算结果一致
+static void expect_matches_chain(UTXOSet* utxo, Blockchain* bc) {
+    map<OutPoint, TXOutput> expected = bc->find_utxo();
+    set<Hash256> txids;
+    for (auto& kv : expected) {
+        TXOutput txout;
+        EXPECT_TRUE(utxo->get_output(kv.first, txout));
+        EXPECT_EQ(txout.value, kv.second.value);
+        txids.insert(kv.first.txid);
+    }
+    EXPECT_EQ(utxo->count_transactions(), (int) txids.size());
+}
+
+TEST(UTXOSetTests, recover_stale_marker) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> bc(new Blockchain(open_db("./data/test_utxo_blocks", true), Hash256()));
+    bc->add_block(genesis.get());
+    string chainstate_path = "./data/test_utxo_chainstate";
+    unique_ptr<UTXOSet> utxo(new UTXOSet(bc.get(), open_db(chainstate_path, true)));
+    utxo->reindex();
+
+    // b1 花费创世区块的输出, b2 只有 coinbase
+    Transaction* spend = new Transaction();
+    spend->vin.push_back(TXInput{genesis->transactions[0]->id, 0, {}, wallet->get_public_key()});
+    spend->vout.push_back(TXOutput(10, wallet->get_address()));
+    spend->id = spend->hash();
+    unique_ptr<Block> b1(mine_after(genesis.get(), wallet.get(), {spend}));
+    unique_ptr<Block> b2(mine_after(b1.get(), wallet.get()));
+    OutPoint genesis_out{genesis->transactions[0]->id, 0};
+    OutPoint b2_out{b2->transactions[0]->id, 0};
+    TXOutput txout;
+    for (auto block : {b1.get(), b2.get()}) {
+        bc->add_block(block);
+        utxo->update(block);
+    }
+    EXPECT_FALSE(utxo->get_output(genesis_out, txout));
+    EXPECT_TRUE(utxo->get_output(b2_out, txout));
+
+    // 断开后再连接, 撤销记录尚未写回
+    utxo->disconnect(b2.get());
+    EXPECT_EQ(utxo->get_best_block(), b1->hash);
+    EXPECT_FALSE(utxo->get_output(b2_out, txout));
+    EXPECT_TRUE(utxo->get_output(OutPoint{spend->id, 0}, txout));
+    utxo->update(b2.get());
+    expect_matches_chain(utxo.get(), bc.get());
+
+    // 写回并关闭, 数据库中的标记停在 b2
+    utxo->flush();
+    utxo.reset();
+
+    // 关闭期间又连接了 b3 和 b4, 数据库中的标记已经过期
+    unique_ptr<Block> b3(mine_after(b2.get(), wallet.get()));
+    unique_ptr<Block> b4(mine_after(b3.get(), wallet.get()));
+    bc->add_block(b3.get());
+    bc->add_block(b4.get());
+
+    // 重新打开后撤销记录从数据库读取, 同步时从标记处重新连接之后的区块
+    utxo.reset(new UTXOSet(bc.get(), open_db(chainstate_path, false)));
+    EXPECT_EQ(utxo->get_best_block(), b2->hash);
+    utxo->disconnect(b2.get());
+    EXPECT_FALSE(utxo->get_output(b2_out, txout));
+    utxo->sync();
+    EXPECT_EQ(utxo->get_best_block(), b4->hash);
+    EXPECT_TRUE(utxo->get_output(b2_out, txout));
+    EXPECT_FALSE(utxo->get_output(genesis_out, txout));
+    expect_matches_chain(utxo.get(), bc.get());
+}
+
+// 花费 outpoint 的交易, 不签名(UTXO 集不检查签名)
+static Transaction* make_spend(const OutPoint& outpoint, Wallet* wallet) {
+    Transaction* tx = new Transaction();
+    tx->vin.push_back(TXInput{outpoint.txid, outpoint.vout, {}, wallet->get_public_key()});
+    tx->vout.push_back(TXOutput(10, wallet->get_address()));
+    tx->id = tx->hash();
+    return tx;
+}
+
+TEST(UTXOSetTests, reject_missing_inputs) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> bc(new Blockchain(open_db("./data/test_utxo_reject_blocks", true), Hash256()));
+    bc->add_block(genesis.get());
+    unique_ptr<UTXOSet> utxo(new UTXOSet(bc.get(), open_db("./data/test_utxo_reject_chainstate", true)));
+    utxo->reindex();
+    OutPoint genesis_out{genesis->transactions[0]->id, 0};
+    unique_ptr<Block> b1(mine_after(genesis.get(), wallet.get(), {make_spend(genesis_out, wallet.get())}));
+    bc->add_block(b1.get());
+    ASSERT_TRUE(utxo->update(b1.get()));
+
+    // 再次花费已花费的输出, 花费不存在的输出, 或者在区块内重复花费, 都不能连接, UTXO 集保持不变
+    Transaction* first = make_spend(OutPoint{b1->transactions[0]->id, 0}, wallet.get());
+    Transaction* second = make_spend(OutPoint{b1->transactions[0]->id, 0}, wallet.get());
+    second->vout[0].value = 9;
+    second->id = second->hash();
+    vector<unique_ptr<Block>> invalid;
+    invalid.emplace_back(mine_after(b1.get(), wallet.get(), {make_spend(genesis_out, wallet.get())}));
+    invalid.emplace_back(mine_after(b1.get(), wallet.get(), {make_spend(OutPoint{Hash256::sha256(string("missing")), 0}, wallet.get())}));
+    invalid.emplace_back(mine_after(b1.get(), wallet.get(), {first, second}));
+    for (auto& block : invalid) {
+        EXPECT_FALSE(utxo->check_inputs(block.get()));
+        EXPECT_FALSE(utxo->update(block.get()));
+        EXPECT_EQ(utxo->get_best_block(), b1->hash);
+    }
+    expect_matches_chain(utxo.get(), bc.get());
+
+    // 区块内花费前面交易的输出是允许的
+    Transaction* parent = make_spend(OutPoint{b1->transactions[1]->id, 0}, wallet.get());
+    Transaction* child = make_spend(OutPoint{parent->id, 0}, wallet.get());
+    unique_ptr<Block> b2(mine_after(b1.get(), wallet.get(), {parent, child}));
+    EXPECT_TRUE(utxo->check_inputs(b2.get()));
+    bc->add_block(b2.get());
+    EXPECT_TRUE(utxo->update(b2.get()));
+    expect_matches_chain(utxo.get(), bc.get());
+}
+
+TEST(UTXOSetTests, sync_after_branch_switch) {
+    unique_ptr<Wallet> wallet(Wallet::new_wallet());
+    unique_ptr<Block> genesis(new_block(Hash256(), vector<Transaction*>{Transaction::new_coinbase_tx(wallet->get_address())}, 0));
+    unique_ptr<Blockchain> bc(new Blockchain(open_db("./data/test_utxo_branch_blocks", true), Hash256()));
+    bc->add_block(genesis.get());
+    DB* db = open_db("./data/test_utxo_branch_chainstate", true);
+    unique_ptr<UTXOSet> utxo(new UTXOSet(bc.get(), db));
+    utxo->reindex();
+
+    // 主链 a1 <- a2, a1 花费创世区块的输出
+    OutPoint genesis_out{genesis->transactions[0]->id, 0};
+    unique_ptr<Block> a1(mine_after(genesis.get(), wallet.get(), {make_spend(genesis_out, wallet.get())}));
+    unique_ptr<Block> a2(mine_after(a1.get(), wallet.get()));
+    for (auto block : {a1.get(), a2.get()}) {
+        bc->add_block(block);
+        ASSERT_TRUE(utxo->update(block));
+    }
+    TXOutput txout;
+    EXPECT_FALSE(utxo->get_output(genesis_out, txout));
+
+    // 更长的分叉 b1 <- b2 <- b3 成为主链, 同步时回滚到创世区块再连接分叉
+    vector<unique_ptr<Block>> b;
+    Block* parent = genesis.get();
+    for (int i = 0; i < 3; i++) {
+        b.emplace_back(mine_after(parent, wallet.get()));
+        parent = b.back().get();
+        bc->add_block(parent);
+    }
+    ASSERT_TRUE(utxo->sync());
+    EXPECT_EQ(utxo->get_best_block(), b[2]->hash);
+    EXPECT_TRUE(utxo->get_output(genesis_out, txout));
+    EXPECT_FALSE(utxo->get_output(OutPoint{a2->transactions[0]->id, 0}, txout));
+    expect_matches_chain(utxo.get(), bc.get());
+
+    // 撤销记录缺失时无法回滚, 重建 UTXO 集
+    utxo->flush();
+    ASSERT_TRUE(db->Delete(rocksdb::WriteOptions(), "undo:" + b[2]->hash.raw()).ok());
+    unique_ptr<Block> a3(mine_after(a2.get(), wallet.get()));
+    unique_ptr<Block> a4(mine_after(a3.get(), wallet.get()));
+    bc->add_block(a3.get());
+    bc->add_block(a4.get());
+    ASSERT_EQ(bc->get_tip_hash(), a4->hash);
+    EXPECT_TRUE(utxo->sync());
+    EXPECT_EQ(utxo->get_best_block(), a4->hash);
+    EXPECT_FALSE(utxo->get_output(genesis_out, txout));
+    expect_matches_chain(utxo.get(), bc.get());
+}
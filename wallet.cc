@@ -13,7 +13,7 @@ const string WALLET_DIR = "./data/wallets/";
 const char VERSION = 0x00;
 
 // 计算公钥的哈希值
-vector<unsigned char> hash_pub_key(vector<unsigned char> public_key) {
+vector<unsigned char> hash_pub_key(ByteSpan public_key) {
     if (public_key.size() == 0) {
         return vector<unsigned char>();
     }
@@ -46,7 +46,7 @@ bool validate_address(const string& address) {
 }
 
 // 通过公钥哈希值反推钱包地址
-string pub_key_hash_to_address(vector<unsigned char> pub_key_hash) {
+string pub_key_hash_to_address(ByteSpan pub_key_hash) {
     if (pub_key_hash.size() == 0) {
         return "";
     }
@@ -32,8 +32,8 @@ vector<string> get_addresses();
 bool validate_address(const string& address);
 
 // 计算公钥的哈希值
-vector<unsigned char> hash_pub_key(vector<unsigned char> public_key);
+vector<unsigned char> hash_pub_key(ByteSpan public_key);
 
 // 通过公钥哈希值反推钱包地址
-string pub_key_hash_to_address(vector<unsigned char> pub_key_hash);
+string pub_key_hash_to_address(ByteSpan pub_key_hash);
 